@@ -126,6 +126,8 @@ void Socket::shutdownWrite()
       if (outstream->hasBufferedData())
         vlog.error(_("Failed to flush remaining socket data on close"));
     }
+    if (!outstream->stopWriter())
+      vlog.error(_("Failed to flush remaining socket data on close"));
   } catch (std::exception& e) {
     vlog.error(_("Failed to flush remaining socket data on close: %s"),
                e.what());
@@ -40,7 +40,6 @@ AESOutStream::AESOutStream(OutStream* _out, const uint8_t* key,
                            int _keySize)
   : keySize(_keySize), out(_out), counter()
 {
-  msg = new uint8_t[MaxMessageSize + 16 + 2];
   if (keySize == 128)
     EAX_SET_KEY(&eaxCtx128, aes128_set_encrypt_key, aes128_encrypt, key);
   else if (keySize == 256)
@@ -51,7 +50,6 @@ AESOutStream::AESOutStream(OutStream* _out, const uint8_t* key,
 
 AESOutStream::~AESOutStream()
 {
-    delete[] msg;
 }
 
 void AESOutStream::flush()
@@ -68,19 +66,42 @@ void AESOutStream::cork(bool enable)
 
 bool AESOutStream::flushBuffer()
 {
-  while (sentUpTo < ptr) {
-    size_t n = ptr - sentUpTo;
+  writeMessages(sentUpTo, ptr - sentUpTo);
+  sentUpTo = ptr;
+  return true;
+}
+
+size_t AESOutStream::flushDirect(const uint8_t* data, size_t length)
+{
+  // Everything is encrypted in to the underlying stream anyway, so
+  // there is no point in copying things to our buffer first
+  flushBuffer();
+  writeMessages(data, length);
+  return length;
+}
+
+void AESOutStream::writeMessages(const uint8_t* data, size_t length)
+{
+  // The messages are only queued up in the underlying stream here, so
+  // they can be sent in larger batches than a single message. It is
+  // up to flush() to actually push them out.
+  while (length > 0) {
+    size_t n = length;
     if (n > MaxMessageSize)
       n = MaxMessageSize;
-    writeMessage(sentUpTo, n);
-    sentUpTo += n;
+    writeMessage(data, n);
+    data += n;
+    length -= n;
   }
-  return true;
 }
 
-
 void AESOutStream::writeMessage(const uint8_t* data, size_t length)
 {
+  uint8_t* msg;
+
+  // Encrypt directly in to the underlying stream's buffer
+  msg = out->getptr(2 + length + EAX_DIGEST_SIZE);
+
   msg[0] = (length & 0xff00) >> 8;
   msg[1] = length & 0xff;
 
@@ -103,8 +124,7 @@ void AESOutStream::writeMessage(const uint8_t* data, size_t length)
     EAX_DIGEST(&eaxCtx256, aes256_encrypt, EAX_DIGEST_SIZE, msg + 2 + length);
 #endif
   }
-  out->writeBytes(msg, 2 + length + EAX_DIGEST_SIZE);
-  out->flush();
+  out->setptr(2 + length + EAX_DIGEST_SIZE);
 
   // Update nonce by incrementing the counter as a
   // 128bit little endian unsigned integer
@@ -36,11 +36,12 @@ namespace rdr {
 
   private:
     bool flushBuffer() override;
+    size_t flushDirect(const uint8_t* data, size_t length) override;
+    void writeMessages(const uint8_t* data, size_t length);
     void writeMessage(const uint8_t* data, size_t length);
 
     int keySize;
     OutStream* out;
-    uint8_t* msg;
     union {
       struct EAX_CTX(aes128_ctx) eaxCtx128;
       struct EAX_CTX(aes256_ctx) eaxCtx256;
@@ -99,6 +99,12 @@ void BufferedOutStream::flush()
   }
 }
 
+size_t BufferedOutStream::flushDirect(const uint8_t* /*data*/,
+                                      size_t /*length*/)
+{
+  return 0;
+}
+
 bool BufferedOutStream::hasBufferedData()
 {
   return sentUpTo != ptr;
@@ -161,3 +167,35 @@ void BufferedOutStream::overrun(size_t needed)
 
   return;
 }
+
+void BufferedOutStream::writeDirect(const uint8_t* data, size_t length)
+{
+  // Only give larger chunks if corked to minimize overhead
+  if (corked && emulateCork && ((ptr - sentUpTo) + length < 1024)) {
+    OutStream::writeDirect(data, length);
+    return;
+  }
+
+  while (length > 0) {
+    size_t buffered, n;
+
+    buffered = ptr - sentUpTo;
+
+    n = flushDirect(data, length);
+
+    offset += buffered - (ptr - sentUpTo) + n;
+
+    // No progress?
+    if ((n == 0) && ((size_t)(ptr - sentUpTo) == buffered))
+      break;
+
+    data += n;
+    length -= n;
+  }
+
+  if (sentUpTo == ptr)
+    ptr = sentUpTo = start;
+
+  // Anything we couldn't get rid of will have to be buffered
+  OutStream::writeDirect(data, length);
+}
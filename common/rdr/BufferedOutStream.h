@@ -49,7 +49,16 @@ namespace rdr {
 
     virtual bool flushBuffer() = 0;
 
+    // flushDirect() is like flushBuffer(), but once all buffered data
+    // has been flushed it continues with the given data, without first
+    // copying it to the buffer. Returns the number of bytes of that
+    // data that were written. Streams that cannot do this efficiently
+    // can leave it unimplemented and the data will then be buffered.
+
+    virtual size_t flushDirect(const uint8_t* data, size_t length);
+
     void overrun(size_t needed) override;
+    void writeDirect(const uint8_t* data, size_t length) override;
 
   private:
     size_t bufSize;
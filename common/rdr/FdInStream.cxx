@@ -42,21 +42,50 @@
 #endif
 
 #include <core/Exception.h>
+#include <core/i18n.h>
 
 #include <rdr/FdInStream.h>
 
 using namespace rdr;
 
+#ifndef _WIN32
+// Descriptors only come with the odd setup message and are picked up
+// right away, so a peer sending more than this is misbehaving
+static const size_t maxReceivedFds = 16;
+#endif
+
 FdInStream::FdInStream(int fd_, bool closeWhenDone_)
   : fd(fd_), closeWhenDone(closeWhenDone_)
+#ifndef _WIN32
+    , fdPassing(false)
+#endif
 {
 }
 
 FdInStream::~FdInStream()
 {
+#ifndef _WIN32
+  for (int receivedFd : receivedFds)
+    close(receivedFd);
+#endif
   if (closeWhenDone) close(fd);
 }
 
+#ifndef _WIN32
+int FdInStream::takeFd()
+{
+  int receivedFd;
+
+  if (receivedFds.empty())
+    return -1;
+
+  receivedFd = receivedFds.front();
+  receivedFds.pop_front();
+
+  return receivedFd;
+}
+#endif
+
 
 bool FdInStream::fillBuffer()
 {
@@ -98,6 +127,11 @@ size_t FdInStream::readFd(uint8_t* buf, size_t len)
   if (n == 0)
     return 0;
 
+#ifndef _WIN32
+  if (fdPassing)
+    return readFdWithFds(buf, len);
+#endif
+
   do {
     n = ::recv(fd, (char*)buf, len, 0);
   } while (n < 0 && errorNumber == EINTR);
@@ -109,3 +143,70 @@ size_t FdInStream::readFd(uint8_t* buf, size_t len)
 
   return n;
 }
+
+#ifndef _WIN32
+size_t FdInStream::readFdWithFds(uint8_t* buf, size_t len)
+{
+  int n;
+  struct iovec iov;
+  struct msghdr msg;
+  uint8_t control[CMSG_SPACE(sizeof(int) * maxReceivedFds)];
+  struct cmsghdr* cmsg;
+  bool tooMany;
+
+  iov.iov_base = buf;
+  iov.iov_len = len;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  do {
+#ifdef MSG_CMSG_CLOEXEC
+    n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+#else
+    n = ::recvmsg(fd, &msg, 0);
+#endif
+  } while (n < 0 && errorNumber == EINTR);
+
+  if (n < 0)
+    throw core::socket_error("read", errorNumber);
+
+  tooMany = false;
+
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    size_t count;
+    const uint8_t* data;
+
+    if ((cmsg->cmsg_level != SOL_SOCKET) ||
+        (cmsg->cmsg_type != SCM_RIGHTS))
+      continue;
+
+    count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    data = CMSG_DATA(cmsg);
+    for (size_t i = 0; i < count; i++) {
+      int receivedFd;
+      memcpy(&receivedFd, data + i * sizeof(int), sizeof(int));
+      if (receivedFds.size() >= maxReceivedFds) {
+        close(receivedFd);
+        tooMany = true;
+        continue;
+      }
+      receivedFds.push_back(receivedFd);
+    }
+  }
+
+  // Descriptors have been dropped, either by us or by the kernel if
+  // they did not fit, so they no longer match up with the data
+  if (tooMany || (msg.msg_flags & MSG_CTRUNC))
+    throw std::runtime_error(_("Too many file descriptors received"));
+
+  if (n == 0)
+    throw end_of_stream();
+
+  return n;
+}
+#endif
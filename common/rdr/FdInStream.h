@@ -23,6 +23,8 @@
 #ifndef __RDR_FDINSTREAM_H__
 #define __RDR_FDINSTREAM_H__
 
+#include <list>
+
 #include <rdr/BufferedInStream.h>
 
 namespace rdr {
@@ -36,13 +38,31 @@ namespace rdr {
 
     int getFd() { return fd; }
 
+#ifndef _WIN32
+    // enableFdPassing() makes the stream accept file descriptors sent
+    // along with the data. Only works for UNIX sockets. Receiving more
+    // than a handful without taking them is treated as an error.
+    void enableFdPassing() { fdPassing = true; }
+
+    // takeFd() returns the oldest received file descriptor, or -1 if
+    // there is none. The caller is responsible for closing it.
+    int takeFd();
+#endif
+
   private:
     bool fillBuffer() override;
 
     size_t readFd(uint8_t* buf, size_t len);
+#ifndef _WIN32
+    size_t readFdWithFds(uint8_t* buf, size_t len);
+#endif
 
     int fd;
     bool closeWhenDone;
+#ifndef _WIN32
+    bool fdPassing;
+    std::list<int> receivedFds;
+#endif
   };
 
 } // end of namespace rdr
@@ -31,9 +31,11 @@
 #include <core/winerrno.h>
 #else
 #include <sys/types.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #define errorNumber errno
@@ -44,30 +46,55 @@
 #include <sys/select.h>
 #endif
 
+#include <algorithm>
+
 #include <core/Exception.h>
+#include <core/i18n.h>
+#include <core/string.h>
 #include <core/time.h>
 
 #include <rdr/FdOutStream.h>
 
 using namespace rdr;
 
+// How long the writer thread waits for the file descriptor before
+// checking if it should stop
+static const int WRITER_TIMEOUT = 10;
+
+// How long stopWriter() gives the peer to take what is left, before
+// giving up on it
+static const int STOP_TIMEOUT = 1000;
+
+// Same limit as for the buffer, so a stuck client cannot use up all
+// our memory
+static const size_t MAX_QUEUE_SIZE = 32 * 1024 * 1024;
+
 FdOutStream::FdOutStream(int fd_)
 #ifdef TCP_CORK
   : BufferedOutStream(false),
 #else
   : BufferedOutStream(true),
 #endif
-  fd(fd_)
+  fd(fd_), writerThread(nullptr), stopRequested(false), written(0)
 {
   gettimeofday(&lastWrite, nullptr);
 }
 
 FdOutStream::~FdOutStream()
 {
+  stopWriter();
+
+#ifndef _WIN32
+  for (int pendingFd : pendingFds)
+    close(pendingFd);
+  for (int queuedFd : queuedFds)
+    close(queuedFd);
+#endif
 }
 
 unsigned FdOutStream::getIdleTime()
 {
+  const std::lock_guard<std::mutex> lock(mutex);
   return core::msSince(&lastWrite);
 }
 
@@ -81,27 +108,176 @@ void FdOutStream::cork(bool enable)
 #endif
 }
 
+#ifndef _WIN32
+void FdOutStream::attachFd(int fd_)
+{
+  int copy;
+
+  copy = fcntl(fd_, F_DUPFD_CLOEXEC, 0);
+  if (copy < 0)
+    throw core::posix_error("fcntl", errno);
+
+  if (writerThread != nullptr) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    // Goes along with whatever data is handed over next
+    queuedFds.push_back(copy);
+    return;
+  }
+
+  pendingFds.push_back(copy);
+}
+#endif
+
+void FdOutStream::startWriter()
+{
+  if (writerThread != nullptr)
+    return;
+
+  stopRequested = false;
+  writerThread = new std::thread(&FdOutStream::writer, this);
+}
+
+bool FdOutStream::stopWriter()
+{
+  bool complete;
+
+  if (writerThread == nullptr)
+    return true;
+
+  {
+    const std::lock_guard<std::mutex> lock(mutex);
+    stopRequested = true;
+    writerCond.notify_one();
+  }
+
+  writerThread->join();
+  delete writerThread;
+  writerThread = nullptr;
+
+  complete = queue.empty() && writing.empty() && !error;
+
+  queue.clear();
+  writing.clear();
+  written = 0;
+
+  return complete;
+}
+
+size_t FdOutStream::queuedData()
+{
+  const std::lock_guard<std::mutex> lock(mutex);
+
+  if (error)
+    std::rethrow_exception(error);
+
+  return queue.size() + writing.size() - written;
+}
+
+void FdOutStream::flush()
+{
+  BufferedOutStream::flush();
+
+  // Make sure errors are noticed even if there was nothing new to
+  // hand over to the writer thread
+  if (writerThread != nullptr) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (error)
+      std::rethrow_exception(error);
+  }
+}
+
 bool FdOutStream::flushBuffer()
 {
-  size_t n = writeFd(sentUpTo, ptr - sentUpTo);
+  size_t n;
+
+  if (writerThread != nullptr) {
+    queueData(sentUpTo, ptr - sentUpTo);
+    sentUpTo = ptr;
+    return true;
+  }
+
+  n = writeFd(sentUpTo, ptr - sentUpTo);
   if (n == 0)
     return false;
 
   sentUpTo += n;
 
+  gettimeofday(&lastWrite, nullptr);
+
   return true;
 }
 
+size_t FdOutStream::flushDirect(const uint8_t* data, size_t length)
+{
+  size_t buffered, n;
+
+  buffered = ptr - sentUpTo;
+
+  if (writerThread != nullptr) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (error)
+      std::rethrow_exception(error);
+
+    // If the writer thread has nothing to do, then we can write
+    // whatever the socket takes right away and only have to copy the
+    // rest over to the thread
+    n = 0;
+    if (queue.empty() && (written == writing.size())) {
+#ifndef _WIN32
+      pendingFds.insert(pendingFds.end(),
+                        queuedFds.begin(), queuedFds.end());
+      queuedFds.clear();
+#endif
+
+      try {
+        n = writeFd(sentUpTo, buffered, data, length);
+      } catch (...) {
+        error = std::current_exception();
+        throw;
+      }
+
+      if (n > 0)
+        gettimeofday(&lastWrite, nullptr);
+
+      if (n < buffered) {
+        sentUpTo += n;
+        n = 0;
+      } else {
+        sentUpTo = ptr;
+        n -= buffered;
+      }
+    }
+
+    lock.unlock();
+
+    queueData(sentUpTo, ptr - sentUpTo);
+    sentUpTo = ptr;
+    queueData(data + n, length - n);
+
+    return length;
+  }
+
+  n = writeFd(sentUpTo, buffered, data, length);
+  if (n > 0)
+    gettimeofday(&lastWrite, nullptr);
+  if (n < buffered) {
+    sentUpTo += n;
+    return 0;
+  }
+
+  sentUpTo = ptr;
+
+  return n - buffered;
+}
+
 //
-// writeFd() writes up to the given length in bytes from the given
-// buffer to the file descriptor. It returns the number of bytes written.  It
-// never attempts to send() unless select() indicates that the fd is writable
-// - this means it can be used on an fd which has been set non-blocking.  It
-// also has to cope with the annoying possibility of both select() and send()
+// isWritable() waits up to the given number of milliseconds for the
+// file descriptor to become writable. It has to cope with select()
 // returning EINTR.
 //
 
-size_t FdOutStream::writeFd(const uint8_t* data, size_t length)
+bool FdOutStream::isWritable(int timeout)
 {
   int n;
 
@@ -109,7 +285,8 @@ size_t FdOutStream::writeFd(const uint8_t* data, size_t length)
     fd_set fds;
     struct timeval tv;
 
-    tv.tv_sec = tv.tv_usec = 0;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
 
     FD_ZERO(&fds);
     FD_SET(fd, &fds);
@@ -119,24 +296,184 @@ size_t FdOutStream::writeFd(const uint8_t* data, size_t length)
   if (n < 0)
     throw core::socket_error("select", errorNumber);
 
-  if (n == 0)
+  return n > 0;
+}
+
+//
+// writeFd() writes up to the given length in bytes from the given
+// buffer to the file descriptor, optionally followed by a second
+// buffer in the same operation. It returns the number of bytes written.  It
+// never attempts to send() unless isWritable() indicates that the fd is
+// writable - this means it can be used on an fd which has been set
+// non-blocking.  It also has to cope with the annoying possibility of
+// send() returning EINTR.
+//
+
+size_t FdOutStream::writeFd(const uint8_t* data, size_t length,
+                            const uint8_t* extra, size_t extraLength)
+{
+  int n;
+#ifndef _WIN32
+  struct iovec iov[2];
+  struct msghdr msg;
+  std::vector<uint8_t> control;
+#endif
+
+  if (!isWritable(0))
     return 0;
 
+#ifdef _WIN32
+  // No scatter-gather here, so let the caller come back for the rest
+  if (length == 0) {
+    data = extra;
+    length = extraLength;
+  }
+#else
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+
+  if (length > 0) {
+    iov[msg.msg_iovlen].iov_base = (void*)data;
+    iov[msg.msg_iovlen].iov_len = length;
+    msg.msg_iovlen++;
+  }
+  if (extraLength > 0) {
+    iov[msg.msg_iovlen].iov_base = (void*)extra;
+    iov[msg.msg_iovlen].iov_len = extraLength;
+    msg.msg_iovlen++;
+  }
+
+  // Any file descriptors go along with the first byte we send
+  if (!pendingFds.empty() && (msg.msg_iovlen > 0)) {
+    struct cmsghdr* cmsg;
+    size_t fdsLen;
+
+    fdsLen = pendingFds.size() * sizeof(int);
+    control.resize(CMSG_SPACE(fdsLen));
+
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fdsLen);
+    memcpy(CMSG_DATA(cmsg), pendingFds.data(), fdsLen);
+  }
+#endif
+
   do {
     // select only guarantees that you can write SO_SNDLOWAT without
     // blocking, which is normally 1. Use MSG_DONTWAIT to avoid
     // blocking, when possible.
-#ifndef MSG_DONTWAIT
+#ifdef _WIN32
     n = ::send(fd, (const char*)data, length, 0);
+#elif !defined(MSG_DONTWAIT)
+    n = ::sendmsg(fd, &msg, 0);
 #else
-    n = ::send(fd, (const char*)data, length, MSG_DONTWAIT);
+    n = ::sendmsg(fd, &msg, MSG_DONTWAIT);
 #endif
   } while (n < 0 && (errorNumber == EINTR));
 
   if (n < 0)
     throw core::socket_error("write", errorNumber);
 
-  gettimeofday(&lastWrite, nullptr);
+#ifndef _WIN32
+  if (msg.msg_control != nullptr) {
+    for (int pendingFd : pendingFds)
+      close(pendingFd);
+    pendingFds.clear();
+  }
+#endif
 
   return n;
 }
+
+void FdOutStream::queueData(const uint8_t* data, size_t length)
+{
+  const std::lock_guard<std::mutex> lock(mutex);
+
+  if (error)
+    std::rethrow_exception(error);
+
+  if (length == 0)
+    return;
+
+  if (queue.size() + writing.size() - written + length > MAX_QUEUE_SIZE)
+    throw std::runtime_error(core::format(
+      _("Buffer size of %lu bytes exceeds maximum of %lu bytes"),
+      (long unsigned)(queue.size() + writing.size() - written + length),
+      (long unsigned)MAX_QUEUE_SIZE));
+
+  queue.insert(queue.end(), data, data + length);
+
+  writerCond.notify_one();
+}
+
+void FdOutStream::writer()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  bool stopping;
+  struct timeval stopStart;
+
+  stopping = false;
+
+  while (true) {
+    int timeout;
+    size_t n;
+
+    if (written == writing.size()) {
+      // Swapping keeps the old buffer around for the next data
+      writing.clear();
+      written = 0;
+
+      if (queue.empty()) {
+        if (stopRequested)
+          break;
+
+        writerCond.wait(lock);
+        continue;
+      }
+
+      std::swap(writing, queue);
+#ifndef _WIN32
+      pendingFds.insert(pendingFds.end(),
+                        queuedFds.begin(), queuedFds.end());
+      queuedFds.clear();
+#endif
+    }
+
+    // Once we've been asked to stop, the peer only gets a limited time
+    // to take the rest
+    timeout = WRITER_TIMEOUT;
+    if (stopRequested) {
+      if (!stopping) {
+        stopping = true;
+        gettimeofday(&stopStart, nullptr);
+      }
+      timeout = std::max(STOP_TIMEOUT - (int)core::msSince(&stopStart),
+                         0);
+    }
+
+    lock.unlock();
+
+    try {
+      n = 0;
+      if (isWritable(timeout))
+        n = writeFd(writing.data() + written, writing.size() - written);
+    } catch (...) {
+      lock.lock();
+      error = std::current_exception();
+      break;
+    }
+
+    lock.lock();
+
+    if (n > 0) {
+      written += n;
+      gettimeofday(&lastWrite, nullptr);
+    } else if (stopping && (timeout == 0)) {
+      break;
+    }
+  }
+}
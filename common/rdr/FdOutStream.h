@@ -26,6 +26,12 @@
 
 #include <sys/time.h>
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <rdr/BufferedOutStream.h>
 
 namespace rdr {
@@ -42,12 +48,57 @@ namespace rdr {
     unsigned getIdleTime();
 
     void cork(bool enable) override;
+    void flush() override;
+
+#ifndef _WIN32
+    // attachFd() sends a copy of the file descriptor along with the
+    // next data written. Only works for UNIX sockets.
+    void attachFd(int fd);
+#endif
+
+    // startWriter() moves the writing to the file descriptor to a
+    // separate thread. Flushing will then just hand over the data to
+    // that thread, and any error writing it will be thrown on a later
+    // flush.
+    void startWriter();
+
+    // stopWriter() waits a short while for the writer thread to write
+    // what it has left, and then stops the thread. Returns false if
+    // some of the data had to be discarded.
+    bool stopWriter();
+
+    // queuedData() returns the number of bytes the writer thread has
+    // yet to write. Any error writing them is thrown here.
+    size_t queuedData();
 
   private:
     bool flushBuffer() override;
-    size_t writeFd(const uint8_t* data, size_t length);
+    size_t flushDirect(const uint8_t* data, size_t length) override;
+    bool isWritable(int timeout);
+    size_t writeFd(const uint8_t* data, size_t length,
+                   const uint8_t* extra=nullptr, size_t extraLength=0);
+    void queueData(const uint8_t* data, size_t length);
+    void writer();
     int fd;
     struct timeval lastWrite;
+#ifndef _WIN32
+    std::vector<int> pendingFds;
+#endif
+
+    std::thread* writerThread;
+    bool stopRequested;
+
+    std::mutex mutex;
+    std::condition_variable writerCond;
+
+    std::vector<uint8_t> queue;
+    std::vector<uint8_t> writing;
+    size_t written;
+#ifndef _WIN32
+    std::vector<int> queuedFds;
+#endif
+
+    std::exception_ptr error;
   };
 
 }
@@ -49,6 +49,27 @@ namespace rdr {
 
     const uint8_t* data() { return start; }
 
+    // capacity() returns the size of the allocated buffer.
+
+    size_t capacity() { return end - start; }
+
+    // shrink() frees any buffer space beyond the given length that
+    // isn't needed for the current data.
+
+    void shrink(size_t len=1024) {
+      if (len < (size_t)(ptr - start))
+        len = ptr - start;
+      if (len >= (size_t)(end - start))
+        return;
+
+      uint8_t* newStart = new uint8_t[len];
+      memcpy(newStart, start, ptr - start);
+      ptr = newStart + (ptr - start);
+      delete [] start;
+      start = newStart;
+      end = newStart + len;
+    }
+
   protected:
 
     // overrun() either doubles the buffer or adds enough space for
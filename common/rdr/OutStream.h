@@ -72,16 +72,12 @@ namespace rdr {
     // writeBytes() writes an exact number of bytes.
 
     void writeBytes(const uint8_t* data, size_t length) {
-      while (length > 0) {
-        check(1);
-        size_t n = length;
-        if (length > avail())
-          n = avail();
-        memcpy(ptr, data, n);
-        ptr += n;
-        data = (uint8_t*)data + n;
-        length -= n;
+      if (length > avail()) {
+        writeDirect(data, length);
+        return;
       }
+      memcpy(ptr, data, length);
+      ptr += length;
     }
 
     // copyBytes() efficiently transfers data between streams
@@ -148,6 +144,23 @@ namespace rdr {
 
   protected:
 
+    // writeDirect() is called by writeBytes() when the data does not
+    // fit in the current buffer. A derived class can override it in
+    // order to pass on the data without first copying it to the buffer.
+
+    virtual void writeDirect(const uint8_t* data, size_t length) {
+      while (length > 0) {
+        check(1);
+        size_t n = length;
+        if (length > avail())
+          n = avail();
+        memcpy(ptr, data, n);
+        ptr += n;
+        data = (uint8_t*)data + n;
+        length -= n;
+      }
+    }
+
     uint8_t* ptr;
     uint8_t* end;
 
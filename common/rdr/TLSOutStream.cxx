@@ -53,6 +53,13 @@ void TLSOutStream::cork(bool enable)
 
 bool TLSOutStream::flushBuffer()
 {
+  // The kernel encrypts things for us, so just pass the data on
+  if (sock->kernelSend()) {
+    sock->out->writeBytes(sentUpTo, ptr - sentUpTo);
+    sentUpTo = ptr;
+    return true;
+  }
+
   while (sentUpTo < ptr) {
     size_t n = sock->writeTLS(sentUpTo, ptr - sentUpTo);
     sentUpTo += n;
@@ -61,4 +68,15 @@ bool TLSOutStream::flushBuffer()
   return true;
 }
 
+size_t TLSOutStream::flushDirect(const uint8_t* data, size_t length)
+{
+  if (!sock->kernelSend())
+    return 0;
+
+  flushBuffer();
+  sock->out->writeBytes(data, length);
+
+  return length;
+}
+
 #endif
@@ -38,6 +38,7 @@ namespace rdr {
 
   private:
     bool flushBuffer() override;
+    size_t flushDirect(const uint8_t* data, size_t length) override;
 
     TLSSocket* sock;
   };
@@ -27,12 +27,19 @@
 #include <core/LogWriter.h>
 #include <core/i18n.h>
 
-#include <rdr/InStream.h>
-#include <rdr/OutStream.h>
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
 #include <rdr/TLSException.h>
 #include <rdr/TLSSocket.h>
 
+#include <assert.h>
 #include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef HAVE_GNUTLS_KTLS
+#include <fcntl.h>
+#include <gnutls/socket.h>
+#endif
 
 #ifdef HAVE_GNUTLS
 
@@ -41,10 +48,17 @@ using namespace rdr;
 static core::LogWriter vlog("TLSSocket");
 
 TLSSocket::TLSSocket(InStream* in_, OutStream* out_,
-                     gnutls_session_t session_)
+                     gnutls_session_t session_, bool kernelTLS)
   : session(session_), established(false),
-    in(in_), out(out_), tlsin(this), tlsout(this)
+    in(in_), out(out_), tlsin(this), tlsout(this),
+    fd(-1), ktlsSend(false), ktlsRecv(false)
 {
+  if (kernelTLS) {
+    setupKernelTLS();
+    if (fd != -1)
+      return;
+  }
+
   gnutls_transport_set_pull_function(
     session, [](gnutls_transport_ptr_t sock, void* data, size_t size) {
       return ((TLSSocket*)sock)->pull(data, size);
@@ -97,11 +111,15 @@ bool TLSSocket::handshake()
 
   established = true;
 
+  if (fd != -1)
+    finishKernelTLS();
+
   return true;
 }
 
 void TLSSocket::shutdown()
 {
+  FdOutStream* fdout;
   int ret;
 
   if (!established)
@@ -119,6 +137,35 @@ void TLSSocket::shutdown()
                e.what());
   }
 
+  // The kernel would send our close ahead of anything still buffered,
+  // or still waiting with a writer thread
+  fdout = dynamic_cast<FdOutStream*>(out);
+  if (ktlsSend)
+    assert(fdout != nullptr);
+
+  if (fdout != nullptr) {
+    bool complete;
+
+    complete = true;
+    try {
+      if (ktlsSend) {
+        fdout->cork(false);
+        fdout->flush();
+      }
+      // This also gets our close written straight after the data
+      complete = fdout->stopWriter();
+    } catch (std::exception& e) {
+      vlog.error(_("Failed to flush remaining socket data on close: %s"),
+                 e.what());
+    }
+
+    if (!complete || (ktlsSend && fdout->hasBufferedData())) {
+      vlog.error(_("Failed to flush remaining socket data on close"));
+      established = false;
+      return;
+    }
+  }
+
   // FIXME: We can't currently wait for the response, so we only send
   //        our close and hope for the best
   ret = gnutls_bye(session, GNUTLS_SHUT_WR);
@@ -144,6 +191,14 @@ size_t TLSSocket::readTLS(uint8_t* buf, size_t len)
   while (true) {
     streamEmpty = false;
     n = gnutls_record_recv(session, (void *) buf, len);
+    if ((fd != -1) && (n == GNUTLS_E_AGAIN)) {
+      // GnuTLS reads the socket itself, so there is no way of telling
+      // if it is empty. Anything it has already buffered will not make
+      // the socket readable again though, so fetch that first.
+      if (gnutls_record_check_pending(session) > 0)
+        continue;
+      return 0;
+    }
     if (n == GNUTLS_E_INTERRUPTED || n == GNUTLS_E_AGAIN) {
       // GnuTLS returns GNUTLS_E_AGAIN for a bunch of other scenarios
       // other than the pull function returning EAGAIN, so we have to
@@ -244,4 +299,81 @@ ssize_t TLSSocket::push(const void* data, size_t size)
   return size;
 }
 
+void TLSSocket::setupKernelTLS()
+{
+#ifdef HAVE_GNUTLS_KTLS
+  FdInStream* fdin;
+  FdOutStream* fdout;
+  int flags;
+
+  fdin = dynamic_cast<FdInStream*>(in);
+  fdout = dynamic_cast<FdOutStream*>(out);
+  if ((fdin == nullptr) || (fdout == nullptr) ||
+      (fdin->getFd() != fdout->getFd())) {
+    vlog.debug("Kernel TLS requires a direct socket connection");
+    return;
+  }
+
+  // GnuTLS will be reading and writing the socket itself, so we
+  // can't have anything stuck in our buffers
+  if ((fdin->avail() != 0) || fdout->hasBufferedData()) {
+    vlog.debug("Cannot use kernel TLS as there is buffered data");
+    return;
+  }
+
+  // Our main loop cannot wait for GnuTLS, so it must never block.
+  // This is safe for the normal streams as they check the socket
+  // before every operation anyway.
+  flags = fcntl(fdin->getFd(), F_GETFL);
+  if ((flags == -1) ||
+      (fcntl(fdin->getFd(), F_SETFL, flags | O_NONBLOCK) == -1)) {
+    vlog.error(_("Failed to make socket non-blocking: %s"),
+               strerror(errno));
+    return;
+  }
+
+  fd = fdin->getFd();
+
+  // Note that GnuTLS will write the handshake directly to the socket,
+  // without our main loop knowing about it. This is fine as the
+  // handshake is small enough to fit in the socket buffer of a new
+  // connection.
+  gnutls_transport_set_int(session, fd);
+#endif
+}
+
+void TLSSocket::finishKernelTLS()
+{
+#ifdef HAVE_GNUTLS_KTLS
+  gnutls_transport_ktls_enable_flags_t flags;
+
+  flags = gnutls_transport_is_ktls_enabled(session);
+
+  ktlsSend = flags & GNUTLS_KTLS_SEND;
+  ktlsRecv = flags & GNUTLS_KTLS_RECV;
+
+  if (ktlsSend && ktlsRecv)
+    vlog.info(_("Using kernel TLS"));
+  else if (ktlsSend)
+    vlog.info(_("Using kernel TLS for sending"));
+  else if (ktlsRecv)
+    vlog.info(_("Using kernel TLS for receiving"));
+  else
+    vlog.info(_("Kernel TLS not available, using GnuTLS"));
+
+  // Outgoing data has to go via our stream, otherwise the main loop
+  // will not know when there is data waiting to be sent. Incoming
+  // data is fine to leave to GnuTLS though.
+  if (!ktlsSend) {
+    gnutls_transport_set_push_function(
+      session, [](gnutls_transport_ptr_t sock, const void* data, size_t size) {
+        return ((TLSSocket*)sock)->push(data, size);
+      });
+    gnutls_transport_set_ptr2(session,
+                              (gnutls_transport_ptr_t)(intptr_t)fd,
+                              this);
+  }
+#endif
+}
+
 #endif
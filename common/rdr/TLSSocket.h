@@ -40,7 +40,11 @@ namespace rdr {
 
   class TLSSocket {
   public:
-    TLSSocket(InStream* in, OutStream* out, gnutls_session_t session);
+    // If kernelTLS is set, then GnuTLS is given direct access to the
+    // underlying socket (if possible) so that it can hand over the
+    // record layer to the kernel once the handshake is completed
+    TLSSocket(InStream* in, OutStream* out, gnutls_session_t session,
+              bool kernelTLS=false);
     virtual ~TLSSocket();
 
     TLSInStream& inStream() { return tlsin; }
@@ -49,6 +53,11 @@ namespace rdr {
     bool handshake();
     void shutdown();
 
+    // kernelSend() returns true if the kernel is encrypting outgoing
+    // data, in which case it can be written to the underlying stream
+    // directly instead of via outStream()
+    bool kernelSend() { return ktlsSend; }
+
   protected:
     /* Used by the stream classes */
     size_t readTLS(uint8_t* buf, size_t len);
@@ -61,6 +70,9 @@ namespace rdr {
     ssize_t pull(void* data, size_t size);
     ssize_t push(const void* data, size_t size);
 
+    void setupKernelTLS();
+    void finishKernelTLS();
+
     gnutls_session_t session;
     bool established;
 
@@ -72,6 +84,10 @@ namespace rdr {
 
     bool streamEmpty;
 
+    // Set if GnuTLS is using the socket directly
+    int fd;
+    bool ktlsSend, ktlsRecv;
+
     std::exception_ptr saved_exception;
   };
 
@@ -99,15 +99,24 @@ bool ZlibInStream::fillBuffer()
   zs->next_out = (uint8_t*)end;
   zs->avail_out = availSpace();
 
-  if (!underlying->hasData(1))
-    return false;
-  size_t length = underlying->avail();
-  if (length > bytesIn)
-    length = bytesIn;
-  zs->next_in = (uint8_t*)underlying->getptr(length);
+  // Once all input has been consumed there might still be output
+  // pending in zlib that didn't fit in the buffer
+  size_t length = 0;
+  if (bytesIn > 0) {
+    if (!underlying->hasData(1))
+      return false;
+    length = underlying->avail();
+    if (length > bytesIn)
+      length = bytesIn;
+    zs->next_in = (uint8_t*)underlying->getptr(length);
+  } else {
+    zs->next_in = nullptr;
+  }
   zs->avail_in = length;
 
   int rc = inflate(zs, Z_SYNC_FLUSH);
+  if ((rc == Z_BUF_ERROR) && (length == 0))
+    return false;
   if (rc < 0) {
     throw std::runtime_error(_("Failed to decompress data"));
   }
@@ -37,18 +37,9 @@ static core::LogWriter vlog("ZlibOutStream");
 using namespace rdr;
 
 ZlibOutStream::ZlibOutStream(OutStream* os, int compressLevel)
-  : underlying(os), compressionLevel(compressLevel), newLevel(compressLevel)
+  : underlying(os), compressionLevel(compressLevel), newLevel(compressLevel),
+    zs(nullptr)
 {
-  zs = new z_stream;
-  zs->zalloc    = nullptr;
-  zs->zfree     = nullptr;
-  zs->opaque    = nullptr;
-  zs->next_in   = nullptr;
-  zs->avail_in  = 0;
-  if (deflateInit(zs, compressLevel) != Z_OK) {
-    delete zs;
-    throw std::runtime_error(_("Failed to initialize zlib"));
-  }
 }
 
 ZlibOutStream::~ZlibOutStream()
@@ -57,8 +48,10 @@ ZlibOutStream::~ZlibOutStream()
     flush();
   } catch (std::exception&) {
   }
-  deflateEnd(zs);
-  delete zs;
+  if (zs != nullptr) {
+    deflateEnd(zs);
+    delete zs;
+  }
 }
 
 void ZlibOutStream::setUnderlying(OutStream* os)
@@ -76,6 +69,29 @@ void ZlibOutStream::setCompressionLevel(int level)
   newLevel = level;
 }
 
+void ZlibOutStream::reset()
+{
+  if (hasBufferedData())
+    throw std::logic_error("ZlibOutStream: Cannot reset with data still in the buffer");
+
+  if (zs == nullptr)
+    return;
+
+  deflateEnd(zs);
+  delete zs;
+  zs = nullptr;
+}
+
+size_t ZlibOutStream::getMemoryUsage()
+{
+  if (zs == nullptr)
+    return 0;
+
+  // deflateInit() uses the largest window and the default memLevel of
+  // 8, and zconf.h tells us what that means
+  return sizeof(z_stream) + (1 << (MAX_WBITS + 2)) + (1 << (8 + 9));
+}
+
 void ZlibOutStream::flush()
 {
   BufferedOutStream::flush();
@@ -92,6 +108,9 @@ void ZlibOutStream::cork(bool enable)
 
 bool ZlibOutStream::flushBuffer()
 {
+  if (zs == nullptr)
+    init();
+
   checkCompressionLevel();
 
   zs->next_in = sentUpTo;
@@ -109,6 +128,23 @@ bool ZlibOutStream::flushBuffer()
   return true;
 }
 
+void ZlibOutStream::init()
+{
+  zs = new z_stream;
+  zs->zalloc    = nullptr;
+  zs->zfree     = nullptr;
+  zs->opaque    = nullptr;
+  zs->next_in   = nullptr;
+  zs->avail_in  = 0;
+  if (deflateInit(zs, newLevel) != Z_OK) {
+    delete zs;
+    zs = nullptr;
+    throw std::runtime_error(_("Failed to initialize zlib"));
+  }
+
+  compressionLevel = newLevel;
+}
+
 void ZlibOutStream::deflate(int flush)
 {
   int rc;
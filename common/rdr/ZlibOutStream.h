@@ -43,8 +43,19 @@ namespace rdr {
     void flush() override;
     void cork(bool enable) override;
 
+    // reset() throws away the compression state, which is otherwise
+    // only set up once there is something to compress. The next data
+    // will start a new zlib stream, so whoever is decompressing it
+    // has to start over as well.
+    void reset();
+
+    // getMemoryUsage() returns roughly how many bytes the compression
+    // state currently uses
+    size_t getMemoryUsage();
+
   private:
     bool flushBuffer() override;
+    void init();
     void deflate(int flush);
     void checkCompressionLevel();
 
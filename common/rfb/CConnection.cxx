@@ -44,6 +44,7 @@
 #include <rfb/PixelBuffer.h>
 #include <rfb/Security.h>
 #include <rfb/SecurityClient.h>
+#include <rfb/SharedMemoryPixelBuffer.h>
 #include <rfb/CConnection.h>
 
 #define XK_MISCELLANY
@@ -65,15 +66,16 @@ CConnection::CConnection()
   : csecurity(nullptr),
     supportsLocalCursor(false), supportsCursorPosition(false),
     supportsDesktopResize(false), supportsLEDState(false),
+    supportsSharedMemory(false),
     is(nullptr), os(nullptr), reader_(nullptr), writer_(nullptr),
     shared(false),
     state_(RFBSTATE_UNINITIALISED),
     pendingPFChange(false), preferredEncoding(encodingTight),
-    compressLevel(2), qualityLevel(-1),
+    compressLevel(2), qualityLevel(-1), preferredScaleFactor(1),
     formatChange(false), encodingChange(false),
     firstUpdate(true), pendingUpdate(false), continuousUpdates(false),
     forceNonincremental(true),
-    framebuffer(nullptr), decoder(this),
+    framebuffer(nullptr), decoder(this), sharedFramebuffer(nullptr),
     hasRemoteClipboard(false), hasLocalClipboard(false)
 {
 }
@@ -81,6 +83,8 @@ CConnection::CConnection()
 CConnection::~CConnection()
 {
   close();
+
+  delete sharedFramebuffer;
 }
 
 void CConnection::setServerName(const char* name_)
@@ -618,6 +622,60 @@ void CConnection::setLEDState(unsigned int state)
   server.setLEDState(state);
 }
 
+void CConnection::setScaleFactor(int factor)
+{
+  vlog.debug("Server is scaling framebuffer by a factor of %d", factor);
+
+  server.scaleFactor = factor;
+}
+
+void CConnection::setSharedMemory(int width, int height, int stride,
+                                  const PixelFormat& pf)
+{
+#ifdef HAVE_MEMFD_CREATE
+  int fd;
+
+  decoder.flush();
+
+  fd = receiveFd();
+  if (fd < 0)
+    throw protocol_error(_("No shared memory received from server"));
+
+  delete sharedFramebuffer;
+  sharedFramebuffer = nullptr;
+
+  sharedFramebuffer = new SharedMemoryPixelBuffer(fd, pf, width, height,
+                                                  stride);
+
+  vlog.debug("Using shared memory framebuffer of %dx%d", width, height);
+#else
+  (void)width;
+  (void)height;
+  (void)stride;
+  (void)pf;
+  throw protocol_error(_("Unexpected shared memory from server"));
+#endif
+}
+
+void CConnection::sharedMemoryRect(const core::Rect& r)
+{
+  const uint8_t* data;
+  int stride;
+
+  if (sharedFramebuffer == nullptr)
+    throw protocol_error(_("Shared memory update without shared memory"));
+
+  if (!r.enclosed_by(sharedFramebuffer->getRect()) ||
+      !r.enclosed_by(framebuffer->getRect()))
+    throw protocol_error(_("Shared memory update outside of framebuffer"));
+
+  // Earlier rects might still be in the process of being decoded
+  decoder.flush();
+
+  data = sharedFramebuffer->getBuffer(r, &stride);
+  framebuffer->imageRect(sharedFramebuffer->getPF(), r, data, stride);
+}
+
 void CConnection::handleClipboardCaps(uint32_t flags,
                                       const uint32_t* lengths)
 {
@@ -730,6 +788,11 @@ void CConnection::resizeFramebuffer()
   assert(false);
 }
 
+int CConnection::receiveFd()
+{
+  return -1;
+}
+
 void CConnection::handleClipboardRequest()
 {
 }
@@ -936,6 +999,20 @@ int CConnection::getQualityLevel()
   return qualityLevel;
 }
 
+void CConnection::setPreferredScaleFactor(int factor)
+{
+  if (preferredScaleFactor == factor)
+    return;
+
+  preferredScaleFactor = factor;
+  encodingChange = true;
+}
+
+int CConnection::getPreferredScaleFactor()
+{
+  return preferredScaleFactor;
+}
+
 void CConnection::setPF(const PixelFormat& pf)
 {
   if (server.pf() == pf && !formatChange)
@@ -1016,15 +1093,24 @@ void CConnection::updateEncodings()
   if (supportsDesktopResize) {
     encodings.push_back(pseudoEncodingDesktopSize);
     encodings.push_back(pseudoEncodingExtendedDesktopSize);
+    // Scaling needs resize support, and the server needs to know
+    // that we can handle it even if we currently don't want it
+    if ((preferredScaleFactor >= 1) && (preferredScaleFactor <= 4))
+      encodings.push_back(pseudoEncodingScaleFactor1 + preferredScaleFactor - 1);
   }
   if (supportsLEDState) {
     encodings.push_back(pseudoEncodingLEDState);
     encodings.push_back(pseudoEncodingVMwareLEDState);
   }
+#ifdef HAVE_MEMFD_CREATE
+  if (supportsSharedMemory)
+    encodings.push_back(pseudoEncodingSharedMemory);
+#endif
 
   encodings.push_back(pseudoEncodingDesktopName);
   encodings.push_back(pseudoEncodingLastRect);
   encodings.push_back(pseudoEncodingExtendedClipboard);
+  encodings.push_back(pseudoEncodingClipboardStream);
   encodings.push_back(pseudoEncodingContinuousUpdates);
   encodings.push_back(pseudoEncodingFence);
   encodings.push_back(pseudoEncodingQEMUKeyEvent);
@@ -1045,6 +1131,11 @@ void CConnection::updateEncodings()
     }
   }
 
+  // Vendor specific encodings are outside the range above
+  if ((encodingTileCache != preferredEncoding) &&
+      Decoder::supported(encodingTileCache))
+    encodings.push_back(encodingTileCache);
+
   if (compressLevel >= 0 && compressLevel <= 9)
       encodings.push_back(pseudoEncodingCompressLevel0 + compressLevel);
   // Tight JPEG is enabled by setting a quality level
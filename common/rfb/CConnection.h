@@ -44,6 +44,7 @@ namespace rfb {
   class CMsgReader;
   class CMsgWriter;
   class CSecurity;
+  class PixelBuffer;
 
   class CConnection : public CMsgHandler {
   public:
@@ -141,6 +142,11 @@ namespace rfb {
     int getCompressLevel();
     void setQualityLevel(int level);
     int getQualityLevel();
+    // setPreferredScaleFactor() asks the server to scale down the
+    // framebuffer by the given factor. server.scaleFactor will be
+    // adjusted if the server agrees.
+    void setPreferredScaleFactor(int factor);
+    int getPreferredScaleFactor();
     // setPF() controls the pixel format requested from the server.
     // server.pf() will automatically be adjusted once the new format
     // is active.
@@ -236,6 +242,12 @@ namespace rfb {
 
     void setLEDState(unsigned int state) override;
 
+    void setScaleFactor(int factor) override;
+
+    void setSharedMemory(int width, int height, int stride,
+                         const PixelFormat& pf) override;
+    void sharedMemoryRect(const core::Rect& r) override;
+
     void handleClipboardCaps(uint32_t flags,
                              const uint32_t* lengths) override;
     void handleClipboardRequest(uint32_t flags) override;
@@ -260,6 +272,11 @@ namespace rfb {
     // sure the pixel buffer has been updated once this call returns.
     virtual void resizeFramebuffer();
 
+    // receiveFd() is called when the server has sent a file descriptor
+    // along with the data. It should return the oldest one received on
+    // the underlying socket, or -1 if there is none.
+    virtual int receiveFd();
+
     // handleClipboardRequest() is called whenever the server requests
     // the client to send over its clipboard data. It will only be
     // called after the client has first announced a clipboard change
@@ -297,6 +314,8 @@ namespace rfb {
     bool supportsCursorPosition;
     bool supportsDesktopResize;
     bool supportsLEDState;
+    // Requires receiveFd()
+    bool supportsSharedMemory;
 
   private:
     bool processVersionMsg();
@@ -327,6 +346,7 @@ namespace rfb {
     int preferredEncoding;
     int compressLevel;
     int qualityLevel;
+    int preferredScaleFactor;
 
     bool formatChange;
     rfb::PixelFormat nextPF;
@@ -341,6 +361,8 @@ namespace rfb {
     ModifiablePixelBuffer* framebuffer;
     DecodeManager decoder;
 
+    PixelBuffer* sharedFramebuffer;
+
     std::string serverClipboard;
     bool hasRemoteClipboard;
     bool hasLocalClipboard;
@@ -75,6 +75,12 @@ namespace rfb {
 
     virtual void setLEDState(unsigned int state) = 0;
 
+    virtual void setScaleFactor(int factor) = 0;
+
+    virtual void setSharedMemory(int width, int height, int stride,
+                                 const PixelFormat& pf) = 0;
+    virtual void sharedMemoryRect(const core::Rect& r) = 0;
+
     virtual void handleClipboardCaps(uint32_t flags,
                                      const uint32_t* lengths) = 0;
     virtual void handleClipboardRequest(uint32_t flags) = 0;
@@ -22,6 +22,7 @@
 #endif
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 
 #include <vector>
@@ -40,6 +41,7 @@
 #include <rfb/CMsgReader.h>
 #include <rfb/PixelBuffer.h>
 #include <rfb/ScreenSet.h>
+#include <rfb/SharedMemoryPixelBuffer.h>
 #include <rfb/encodings.h>
 
 static core::LogWriter vlog("CMsgReader");
@@ -53,12 +55,14 @@ using namespace rfb;
 
 CMsgReader::CMsgReader(CMsgHandler* handler_, rdr::InStream* is_)
   : imageBufIdealSize(0), handler(handler_), is(is_),
-    state(MSGSTATE_IDLE), cursorEncoding(-1)
+    state(MSGSTATE_IDLE), cursorEncoding(-1),
+    clipboardZis(nullptr), clipboardDiscard(false)
 {
 }
 
 CMsgReader::~CMsgReader()
 {
+  delete clipboardZis;
 }
 
 bool CMsgReader::readServerInit()
@@ -215,7 +219,16 @@ bool CMsgReader::readMsg()
       handler->supportsExtendedMouseButtons();
       ret = true;
       break;
+    case pseudoEncodingSharedMemory:
+      ret = readSharedMemory(dataRect);
+      break;
     default:
+      if ((rectEncoding >= pseudoEncodingScaleFactor1) &&
+          (rectEncoding <= pseudoEncodingScaleFactor4)) {
+        handler->setScaleFactor(rectEncoding - pseudoEncodingScaleFactor1 + 1);
+        ret = true;
+        break;
+      }
       ret = readRect(dataRect, rectEncoding);
       break;
     };
@@ -315,15 +328,23 @@ bool CMsgReader::readExtendedClipboard(int32_t len)
 
   if (len < 4)
     throw protocol_error(_("Invalid extended clipboard message"));
+
+  flags = is->readU32();
+  action = flags & clipboardActionMask;
+
+  // Part of a transfer split over several messages? The last message
+  // is an ordinary "provide" message.
+  if (((action & ~clipboardStream) == clipboardProvide) &&
+      ((action & clipboardStream) ||
+       (clipboardZis != nullptr) || clipboardDiscard))
+    return readClipboardStream(flags, len - 4);
+
   if (len > maxCutText) {
     vlog.error(_("Clipboard too large (%d bytes)"), len);
-    is->skip(len);
+    is->skip(len - 4);
     return true;
   }
 
-  flags = is->readU32();
-  action = flags & clipboardActionMask;
-
   if (action & clipboardCaps) {
     int i;
     size_t num;
@@ -428,6 +449,106 @@ bool CMsgReader::readExtendedClipboard(int32_t len)
   return true;
 }
 
+bool CMsgReader::readClipboardStream(uint32_t flags, int32_t len)
+{
+  bool last;
+
+  last = !(flags & clipboardStream);
+
+  // The server gave up on the transfer?
+  if (last && !(flags & clipboardFormatMask)) {
+    vlog.debug("Clipboard transfer aborted by server");
+    clipboardDiscard = true;
+  }
+
+  if (!clipboardDiscard && (len > maxCutText)) {
+    vlog.error(_("Clipboard too large (%d bytes)"), len);
+    clipboardDiscard = true;
+  }
+
+  if (!clipboardDiscard) {
+    if (clipboardZis == nullptr)
+      clipboardZis = new rdr::ZlibInStream();
+
+    // Each message is flushed by the server, so it can be decompressed
+    // right away and only the uncompressed result has to be kept
+    clipboardZis->setUnderlying(is, len);
+    while (clipboardZis->hasData(1)) {
+      size_t chunk;
+      const uint8_t* data;
+
+      chunk = clipboardZis->avail();
+      data = clipboardZis->getptr(chunk);
+
+      // Allow for the length fields in front of each format
+      if (!clipboardDiscard &&
+          (clipboardData.size() + chunk > (size_t)maxCutText + 16 * 4)) {
+        vlog.error(_("Clipboard too large (%u bytes)"),
+                   (unsigned)(clipboardData.size() + chunk));
+        clipboardDiscard = true;
+      }
+
+      if (!clipboardDiscard)
+        clipboardData.insert(clipboardData.end(), data, data + chunk);
+
+      clipboardZis->skip(chunk);
+    }
+    clipboardZis->flushUnderlying();
+  } else {
+    is->skip(len);
+  }
+
+  if (!last) {
+    // Nothing more will be decompressed if we've given up
+    if (clipboardDiscard) {
+      delete clipboardZis;
+      clipboardZis = nullptr;
+      std::vector<uint8_t>().swap(clipboardData);
+    }
+    return true;
+  }
+
+  if (!clipboardDiscard) {
+    int i;
+    size_t num, pos;
+    size_t lengths[16];
+    const uint8_t* buffers[16];
+
+    num = 0;
+    pos = 0;
+    for (i = 0;i < 16;i++) {
+      const uint8_t* ptr;
+
+      if (!(flags & 1 << i))
+        continue;
+
+      if (clipboardData.size() - pos < 4)
+        throw protocol_error(_("Invalid extended clipboard message"));
+
+      ptr = clipboardData.data() + pos;
+      lengths[num] = (uint32_t)ptr[0] << 24 | ptr[1] << 16 |
+                     ptr[2] << 8 | ptr[3];
+      pos += 4;
+
+      if (clipboardData.size() - pos < lengths[num])
+        throw protocol_error(_("Invalid extended clipboard message"));
+
+      buffers[num] = clipboardData.data() + pos;
+      pos += lengths[num];
+      num++;
+    }
+
+    handler->handleClipboardProvide(flags, lengths, buffers);
+  }
+
+  delete clipboardZis;
+  clipboardZis = nullptr;
+  std::vector<uint8_t>().swap(clipboardData);
+  clipboardDiscard = false;
+
+  return true;
+}
+
 bool CMsgReader::readFence()
 {
   uint32_t flags;
@@ -844,6 +965,44 @@ bool CMsgReader::readExtendedDesktopSize(int x, int y, int w, int h)
   return true;
 }
 
+bool CMsgReader::readSharedMemory(const core::Rect& r)
+{
+  uint8_t type;
+  uint32_t stride;
+  PixelFormat pf;
+
+  if (!is->hasData(1))
+    return false;
+
+  is->setRestorePoint();
+
+  type = is->readU8();
+
+  switch (type) {
+  case sharedMemorySetup:
+    if (!is->hasDataOrRestore(4 + 16))
+      return false;
+    is->clearRestorePoint();
+
+    stride = is->readU32();
+    pf.read(is);
+
+    if ((r.tl.x != 0) || (r.tl.y != 0) || (stride > INT_MAX))
+      throw protocol_error(_("Invalid shared memory layout"));
+
+    handler->setSharedMemory(r.width(), r.height(), stride, pf);
+    break;
+  case sharedMemoryDamage:
+    is->clearRestorePoint();
+    handler->sharedMemoryRect(r);
+    break;
+  default:
+    throw protocol_error(_("Invalid shared memory message"));
+  }
+
+  return true;
+}
+
 bool CMsgReader::readLEDState()
 {
   uint8_t ledState;
@@ -26,9 +26,14 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <core/Rect.h>
 
-namespace rdr { class InStream; }
+namespace rdr {
+  class InStream;
+  class ZlibInStream;
+}
 
 namespace rfb {
 
@@ -53,6 +58,7 @@ namespace rfb {
     bool readBell();
     bool readServerCutText();
     bool readExtendedClipboard(int32_t len);
+    bool readClipboardStream(uint32_t flags, int32_t len);
     bool readFence();
     bool readEndOfContinuousUpdates();
 
@@ -71,6 +77,7 @@ namespace rfb {
     bool readSetDesktopName(int x, int y, int w, int h);
     bool readExtendedDesktopSize(int x, int y, int w, int h);
     bool readLEDState();
+    bool readSharedMemory(const core::Rect& r);
     bool readVMwareLEDState();
 
   private:
@@ -93,6 +100,11 @@ namespace rfb {
 
     int cursorEncoding;
 
+    // State for clipboard transfers split over several messages
+    rdr::ZlibInStream* clipboardZis;
+    std::vector<uint8_t> clipboardData;
+    bool clipboardDiscard;
+
     static const int maxCursorSize = 256;
   };
 
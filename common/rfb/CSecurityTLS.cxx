@@ -156,7 +156,7 @@ bool CSecurityTLS::processMsg()
 
     setParam();
 
-    tlssock = new rdr::TLSSocket(is, os, session);
+    tlssock = new rdr::TLSSocket(is, os, session, Security::KernelTLS);
 
     rawis = is;
     rawos = os;
@@ -175,7 +175,11 @@ bool CSecurityTLS::processMsg()
 
   checkSession();
 
-  cc->setStreams(&tlssock->inStream(), &tlssock->outStream());
+  // No need to go via GnuTLS if the kernel is doing the work
+  if (tlssock->kernelSend())
+    cc->setStreams(&tlssock->inStream(), rawos);
+  else
+    cc->setStreams(&tlssock->inStream(), &tlssock->outStream());
 
   return true;
 }
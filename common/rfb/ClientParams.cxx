@@ -41,7 +41,7 @@ static core::LogWriter vlog("ClientParams");
 ClientParams::ClientParams()
   : majorVersion(0), minorVersion(0),
     compressLevel(2), qualityLevel(-1), fineQualityLevel(-1),
-    subsampling(subsampleUndefined),
+    subsampling(subsampleUndefined), scaleFactor(1),
     width_(0), height_(0),
     cursorPos_(0, 0), ledState_(ledUnknown)
 {
@@ -126,6 +126,7 @@ void ClientParams::setEncodings(int nEncodings, const int32_t* encodings)
   qualityLevel = -1;
   fineQualityLevel = -1;
   subsampling = subsampleUndefined;
+  scaleFactor = 1;
 
   encodings_.clear();
   encodings_.insert(encodingRaw);
@@ -164,8 +165,17 @@ void ClientParams::setEncodings(int nEncodings, const int32_t* encodings)
         encodings[i] <= pseudoEncodingFineQualityLevel100)
       fineQualityLevel = encodings[i] - pseudoEncodingFineQualityLevel0;
 
+    if (encodings[i] >= pseudoEncodingScaleFactor1 &&
+        encodings[i] <= pseudoEncodingScaleFactor4)
+      scaleFactor = encodings[i] - pseudoEncodingScaleFactor1 + 1;
+
     encodings_.insert(encodings[i]);
   }
+
+  // The framebuffer size changes when scaling, so we need a way to
+  // tell the client about that
+  if (!supportsDesktopSize())
+    scaleFactor = 1;
 }
 
 void ClientParams::setLEDState(unsigned int state)
@@ -30,6 +30,7 @@
 #include <core/string.h>
 
 #include <rfb/ComparingUpdateTracker.h>
+#include <rfb/TileCache.h>
 
 using namespace rfb;
 
@@ -37,7 +38,8 @@ static core::LogWriter vlog("ComparingUpdateTracker");
 
 ComparingUpdateTracker::ComparingUpdateTracker(PixelBuffer* buffer)
   : fb(buffer), oldFb(fb->getPF(), 0, 0), firstCompare(true),
-    enabled(true), totalPixels(0), missedPixels(0)
+    enabled(true), hashing(false), blocksWide(0),
+    totalPixels(0), missedPixels(0)
 {
     changed.assign_union(fb->getRect());
 }
@@ -57,6 +59,16 @@ bool ComparingUpdateTracker::compare()
   if (!enabled)
     return false;
 
+  if (firstCompare && hashing) {
+    // NB: We leave the change region untouched on this iteration,
+    // since in effect the entire framebuffer has changed.
+    hashBlocks();
+
+    firstCompare = false;
+
+    return false;
+  }
+
   if (firstCompare) {
     // NB: We leave the change region untouched on this iteration,
     // since in effect the entire framebuffer has changed.
@@ -74,15 +86,20 @@ bool ComparingUpdateTracker::compare()
     return false;
   }
 
-  copied.get_rects(&rects, copy_delta.x<=0, copy_delta.y<=0);
-  for (i = rects.begin(); i != rects.end(); i++)
-    oldFb.copyRect(*i, copy_delta);
+  core::Region newChanged;
 
-  changed.get_rects(&rects);
+  if (hashing) {
+    compareBlocks(&newChanged);
+  } else {
+    copied.get_rects(&rects, copy_delta.x<=0, copy_delta.y<=0);
+    for (i = rects.begin(); i != rects.end(); i++)
+      oldFb.copyRect(*i, copy_delta);
 
-  core::Region newChanged;
-  for (i = rects.begin(); i != rects.end(); i++)
-    compareRect(*i, &newChanged);
+    changed.get_rects(&rects);
+
+    for (i = rects.begin(); i != rects.end(); i++)
+      compareRect(*i, &newChanged);
+  }
 
   changed.get_rects(&rects);
   for (i = rects.begin(); i != rects.end(); i++)
@@ -112,6 +129,108 @@ void ComparingUpdateTracker::disable()
   firstCompare = true;
 }
 
+void ComparingUpdateTracker::setHashing(bool enable)
+{
+  if (hashing == enable)
+    return;
+
+  hashing = enable;
+
+  // Only one of these is kept up to date, so start over with the
+  // other one
+  firstCompare = true;
+
+  if (hashing) {
+    oldFb.releaseBuffer();
+  } else {
+    blockHashes.clear();
+    blockHashes.shrink_to_fit();
+    blockValid.clear();
+    blockValid.shrink_to_fit();
+  }
+}
+
+size_t ComparingUpdateTracker::getMemoryUsage() const
+{
+  return oldFb.getBufferSize() +
+         blockHashes.capacity() * sizeof(uint64_t) +
+         blockValid.capacity() / 8;
+}
+
+void ComparingUpdateTracker::hashBlocks()
+{
+  int blocksHigh;
+
+  blocksWide = (fb->width() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  blocksHigh = (fb->height() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  blockHashes.resize(blocksWide * blocksHigh);
+  blockValid.assign(blocksWide * blocksHigh, true);
+
+  for (int by = 0; by < blocksHigh; by++) {
+    for (int bx = 0; bx < blocksWide; bx++) {
+      core::Rect pos(bx * BLOCK_SIZE, by * BLOCK_SIZE,
+                     std::min(fb->width(), (bx + 1) * BLOCK_SIZE),
+                     std::min(fb->height(), (by + 1) * BLOCK_SIZE));
+      blockHashes[by * blocksWide + bx] = TileCache::hashRect(fb, pos);
+    }
+  }
+}
+
+void ComparingUpdateTracker::compareBlocks(core::Region* newChanged)
+{
+  std::vector<core::Rect> rects;
+  std::vector<core::Rect>::iterator i;
+  std::vector<bool> checked;
+
+  // We have no idea what the copied blocks look like now, so they
+  // will have to be sent in full the next time they change
+  copied.get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); i++) {
+    core::Rect r = i->intersect(fb->getRect());
+    if (r.is_empty())
+      continue;
+
+    for (int by = r.tl.y / BLOCK_SIZE; by <= (r.br.y - 1) / BLOCK_SIZE; by++) {
+      for (int bx = r.tl.x / BLOCK_SIZE; bx <= (r.br.x - 1) / BLOCK_SIZE; bx++)
+        blockValid[by * blocksWide + bx] = false;
+    }
+  }
+
+  // A block is either unchanged, or we report every part of it that
+  // was marked as changed
+  checked.resize(blockHashes.size(), false);
+  changed.get_rects(&rects);
+  for (i = rects.begin(); i != rects.end(); i++) {
+    core::Rect r = i->intersect(fb->getRect());
+    if (r.is_empty())
+      continue;
+
+    for (int by = r.tl.y / BLOCK_SIZE; by <= (r.br.y - 1) / BLOCK_SIZE; by++) {
+      for (int bx = r.tl.x / BLOCK_SIZE; bx <= (r.br.x - 1) / BLOCK_SIZE; bx++) {
+        size_t index = by * blocksWide + bx;
+        uint64_t hash;
+
+        if (checked[index])
+          continue;
+        checked[index] = true;
+
+        core::Rect pos(bx * BLOCK_SIZE, by * BLOCK_SIZE,
+                       std::min(fb->width(), (bx + 1) * BLOCK_SIZE),
+                       std::min(fb->height(), (by + 1) * BLOCK_SIZE));
+        hash = TileCache::hashRect(fb, pos);
+        if (blockValid[index] && (blockHashes[index] == hash))
+          continue;
+
+        blockHashes[index] = hash;
+        blockValid[index] = true;
+
+        newChanged->assign_union(changed.intersect(pos));
+      }
+    }
+  }
+}
+
 void ComparingUpdateTracker::compareRect(const core::Rect& r,
                                          core::Region* newChanged)
 {
@@ -268,6 +387,8 @@ void ComparingUpdateTracker::logStats()
              core::siPrefix(totalPixels, "pixels").c_str(),
              core::siPrefix(missedPixels, "pixels").c_str());
   vlog.debug("(1:%g ratio)", ratio);
+  vlog.debug("%s used for comparison",
+             core::iecPrefix(getMemoryUsage(), "B").c_str());
 
   totalPixels = missedPixels = 0;
 }
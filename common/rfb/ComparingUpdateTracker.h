@@ -19,6 +19,8 @@
 #ifndef __RFB_COMPARINGUPDATETRACKER_H__
 #define __RFB_COMPARINGUPDATETRACKER_H__
 
+#include <vector>
+
 #include <rfb/PixelBuffer.h>
 #include <rfb/UpdateTracker.h>
 
@@ -42,15 +44,33 @@ namespace rfb {
     virtual void enable();
     virtual void disable();
 
+    // setHashing() switches between keeping a copy of the framebuffer,
+    // and only keeping a hash of each block. The latter uses a fraction
+    // of the memory, but can only tell that something in a block has
+    // changed, not exactly what.
+
+    void setHashing(bool enable);
+
+    size_t getMemoryUsage() const;
+
     void logStats();
 
   private:
     void compareRect(const core::Rect& r, core::Region* newchanged);
+    void compareBlocks(core::Region* newChanged);
+    void hashBlocks();
     PixelBuffer* fb;
     ManagedPixelBuffer oldFb;
     bool firstCompare;
     bool enabled;
 
+    // Block hashes, row by row, for when hashing is enabled. Copies
+    // invalidate blocks as there is no telling what they end up as.
+    bool hashing;
+    int blocksWide;
+    std::vector<uint64_t> blockHashes;
+    std::vector<bool> blockValid;
+
     unsigned long long totalPixels, missedPixels;
   };
 
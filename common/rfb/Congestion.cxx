@@ -31,6 +31,13 @@
  * We use a simplistic form of slow start in order to ramp up quickly
  * from an idle state. We do not have any persistent threshold though
  * as we have too much noise for it to be reliable.
+ *
+ * Where the operating system exposes the state of its TCP stack we
+ * also make use of that. It gives us an exact figure of how much data
+ * is sitting in local buffers, and it allows us to do some congestion
+ * control for clients that cannot respond to our pings. The kernel's
+ * congestion control is loss based though, so we apply the Vegas
+ * principle on top of it using the kernel's RTT measurements.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -38,6 +45,8 @@
 #endif
 
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/time.h>
 
@@ -45,7 +54,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
-#include <netinet/tcp.h>
+#include <linux/tcp.h>
 #include <linux/sockios.h>
 #endif
 
@@ -84,7 +93,10 @@ static core::LogWriter vlog("Congestion");
 Congestion::Congestion() :
     lastPosition(0), extraBuffer(0),
     baseRTT(-1), congWindow(INITIAL_WINDOW), inSlowStart(true),
-    safeBaseRTT(-1), measurements(0), minRTT(-1), minCongestedRTT(-1)
+    safeBaseRTT(-1), measurements(0), minRTT(-1), minCongestedRTT(-1),
+    haveTCPInfo(false), tcpInfoFailed(false), tcpPosition(0),
+    tcpRTT(-1), tcpMinRTT(-1), tcpWindow(0), tcpInFlight(0),
+    tcpNotSent(0), tcpDeliveryRate(0)
 {
   gettimeofday(&lastUpdate, nullptr);
   gettimeofday(&lastSent, nullptr);
@@ -127,6 +139,7 @@ void Congestion::updatePosition(unsigned pos)
     gettimeofday(&lastAdjustment, nullptr);
     minRTT = minCongestedRTT = -1;
     inSlowStart = true;
+    tcpDeliveryRate = 0;
   }
 
   // Commonly we will be in a state of overbuffering. We need to
@@ -222,6 +235,67 @@ void Congestion::gotPong()
   updateCongestion();
 }
 
+void Congestion::updateTCPInfo(int fd)
+{
+  (void)fd;
+#ifdef __linux__
+  struct tcp_info info;
+  socklen_t len;
+  int outq;
+
+  // No point in retrying if this isn't a (modern) TCP socket
+  if (tcpInfoFailed)
+    return;
+
+  memset(&info, 0, sizeof(info));
+  len = sizeof(info);
+  if ((getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0) ||
+      (len < offsetof(struct tcp_info, tcpi_delivery_rate) +
+             sizeof(info.tcpi_delivery_rate)) ||
+      (ioctl(fd, SIOCOUTQ, &outq) != 0)) {
+    vlog.debug("No TCP information available for socket");
+    tcpInfoFailed = true;
+    haveTCPInfo = false;
+    return;
+  }
+
+  haveTCPInfo = true;
+  tcpPosition = lastPosition;
+
+  // The kernel measures time in microseconds
+  tcpRTT = info.tcpi_rtt / 1000;
+  if (tcpRTT < 1)
+    tcpRTT = 1;
+  // (the minimum is ~0 until there is a measurement)
+  tcpMinRTT = info.tcpi_min_rtt / 1000;
+  if (tcpMinRTT < 1)
+    tcpMinRTT = 1;
+  if (tcpMinRTT > tcpRTT)
+    tcpMinRTT = tcpRTT;
+
+  tcpWindow = info.tcpi_snd_cwnd * info.tcpi_snd_mss;
+  tcpInFlight = outq;
+  tcpNotSent = info.tcpi_notsent_bytes;
+
+  // Samples where we didn't give the kernel enough data only tell us
+  // the minimum available bandwidth
+  if (!info.tcpi_delivery_rate_app_limited ||
+      (info.tcpi_delivery_rate > tcpDeliveryRate))
+    tcpDeliveryRate = info.tcpi_delivery_rate;
+
+  // Data the kernel hasn't even sent yet is an exact measurement of
+  // the overbuffering we otherwise have to estimate
+  if (baseRTT != (unsigned)-1)
+    extraBuffer = tcpNotSent;
+
+  // Without any measurements of our own we have to go by the kernel
+  if ((baseRTT == (unsigned)-1) && pings.empty()) {
+    inSlowStart = info.tcpi_snd_cwnd < info.tcpi_snd_ssthresh;
+    updateTCPCongestion();
+  }
+#endif
+}
+
 bool Congestion::isCongested()
 {
   if (getInFlight() < congWindow)
@@ -232,7 +306,7 @@ bool Congestion::isCongested()
 
 int Congestion::getUncongestedETA()
 {
-  unsigned targetAcked;
+  unsigned inFlight, targetAcked;
 
   const struct RTTInfo* prevPing;
   unsigned eta, elapsed;
@@ -240,6 +314,28 @@ int Congestion::getUncongestedETA()
 
   std::list<struct RTTInfo>::const_iterator iter;
 
+  // Only the kernel's view available?
+  if ((baseRTT == (unsigned)-1) && pings.empty()) {
+    if (!haveTCPInfo)
+      return -1;
+
+    inFlight = getInFlight();
+    if (inFlight < congWindow)
+      return 0;
+
+    // Assume the excess drains at the rate the kernel has seen
+    if (tcpDeliveryRate > 0)
+      eta = (uint64_t)(inFlight - congWindow) * 1000 / tcpDeliveryRate;
+    else
+      eta = (uint64_t)(inFlight - congWindow) * tcpRTT / congWindow;
+
+    // Give the kernel some time to do something
+    if (eta < 1)
+      eta = 1;
+
+    return eta;
+  }
+
   targetAcked = lastPosition - congWindow;
 
   // Simple case?
@@ -301,11 +397,15 @@ size_t Congestion::getBandwidth()
 {
   size_t bandwidth;
 
-  // No measurements yet? Guess RTT of 60 ms
-  if (safeBaseRTT == (unsigned)-1)
-    bandwidth = congWindow * 1000 / 60;
-  else
+  // No measurements yet? Use the kernel's, or guess RTT of 60 ms
+  if (safeBaseRTT != (unsigned)-1)
     bandwidth = congWindow * 1000 / safeBaseRTT;
+  else if (haveTCPInfo) {
+    bandwidth = congWindow * 1000 / tcpRTT;
+    if (tcpDeliveryRate > bandwidth)
+      bandwidth = tcpDeliveryRate;
+  } else
+    bandwidth = congWindow * 1000 / 60;
 
   // We're still probing so guess actual bandwidth is halfway between
   // the current guess and the next one (slow start doubles each time)
@@ -374,6 +474,9 @@ unsigned Congestion::getInFlight()
   if (baseRTT == (unsigned)-1) {
     if (!pings.empty())
       return lastPosition - pings.front().pos;
+    // The kernel knows, but we might have written more since we asked
+    if (haveTCPInfo)
+      return tcpInFlight + (lastPosition - tcpPosition);
     return 0;
   }
 
@@ -501,3 +604,32 @@ void Congestion::updateCongestion()
   minRTT = minCongestedRTT = -1;
 }
 
+
+void Congestion::updateTCPCongestion()
+{
+  unsigned target;
+
+  // The kernel's window is loss based, which means it will happily
+  // fill up any oversized buffers along the path. Scale it down if
+  // the latency increases beyond the same small margin as we aim for
+  // in updateCongestion(), similar to what VEGAS would do.
+
+  target = tcpMinRTT + 5;
+  if (tcpRTT > target)
+    congWindow = (uint64_t)tcpWindow * target / tcpRTT;
+  else
+    congWindow = tcpWindow;
+
+  if (congWindow < MINIMUM_WINDOW)
+    congWindow = MINIMUM_WINDOW;
+  if (congWindow > MAXIMUM_WINDOW)
+    congWindow = MAXIMUM_WINDOW;
+
+#ifdef CONGESTION_DEBUG
+  vlog.debug("TCP RTT: %d ms (%d ms), Window: %d KiB (%d KiB), "
+             "Delivery rate: %g Mbps%s",
+             tcpRTT, tcpMinRTT, congWindow / 1024, tcpWindow / 1024,
+             tcpDeliveryRate * 8.0 / 1000000.0,
+             inSlowStart ? " (slow start)" : "");
+#endif
+}
@@ -37,6 +37,13 @@ namespace rfb {
     void sentPing();
     void gotPong();
 
+    // updateTCPInfo() samples the state of the operating system's TCP
+    // stack for the specified socket, if such information is
+    // available. It should be called right after updatePosition(). It
+    // gives a more accurate view of local buffering, and allows
+    // congestion control even when no pings can be sent.
+    void updateTCPInfo(int fd);
+
     // isCongested() determines if the transport is currently congested
     // or if more data can be sent.
     bool isCongested();
@@ -61,6 +68,7 @@ namespace rfb {
     unsigned getInFlight();
 
     void updateCongestion();
+    void updateTCPCongestion();
 
   private:
     unsigned lastPosition;
@@ -89,6 +97,13 @@ namespace rfb {
     int measurements;
     struct timeval lastAdjustment;
     unsigned minRTT, minCongestedRTT;
+
+    bool haveTCPInfo, tcpInfoFailed;
+    unsigned tcpPosition;
+    unsigned tcpRTT, tcpMinRTT;
+    unsigned tcpWindow;
+    unsigned tcpInFlight, tcpNotSent;
+    size_t tcpDeliveryRate;
   };
 }
 
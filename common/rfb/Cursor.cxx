@@ -29,6 +29,7 @@
 #include <core/LogWriter.h>
 
 #include <rfb/Cursor.h>
+#include <rfb/PixelFormatSIMD.h>
 
 using namespace rfb;
 
@@ -268,7 +269,12 @@ const uint8_t* RenderedCursor::getBuffer(const core::Rect& _r,
   return buffer.getBuffer(r, stride);
 }
 
-void RenderedCursor::update(PixelBuffer* framebuffer,
+void RenderedCursor::cursorChange()
+{
+  prepared.clear();
+}
+
+void RenderedCursor::update(const PixelBuffer* framebuffer,
                             Cursor* cursor, const core::Point& pos)
 {
   core::Point rawOffset, diff;
@@ -277,6 +283,9 @@ void RenderedCursor::update(PixelBuffer* framebuffer,
   const uint8_t* data;
   int stride;
 
+  uint8_t* out;
+  int outStride;
+
   assert(framebuffer);
   assert(cursor);
 
@@ -297,35 +306,117 @@ void RenderedCursor::update(PixelBuffer* framebuffer,
   if (clippedRect.area() == 0)
     return;
 
+  // Only the position has changed in most cases, so the converted
+  // cursor image can be reused
+  if (prepared.empty() || (preparedPF != format))
+    prepareCursor(cursor);
+
   data = framebuffer->getBuffer(buffer.getRect(offset), &stride);
   buffer.imageRect(buffer.getRect(), data, stride);
 
+  out = buffer.getBufferRW(buffer.getRect(), &outStride);
+
   diff = offset.subtract(rawOffset);
-  for (int y = 0;y < buffer.height();y++) {
-    for (int x = 0;x < buffer.width();x++) {
-      size_t idx;
-      uint8_t bg[4], fg[4];
-      uint8_t rgb[3];
-
-      idx = (y+diff.y)*cursor->width() + (x+diff.x);
-      memcpy(fg, cursor->getBuffer() + idx*4, 4);
-
-      if (fg[3] == 0x00)
-        continue;
-      else if (fg[3] == 0xff) {
-        memcpy(rgb, fg, 3);
-      } else {
-        buffer.getImage(bg, {x, y, x+1, y+1});
-        format.rgbFromBuffer(rgb, bg, 1);
-        // FIXME: Gamma aware blending
-        for (int i = 0;i < 3;i++) {
-          rgb[i] = (unsigned)rgb[i]*(255-fg[3])/255 +
-                   (unsigned)fg[i]*fg[3]/255;
+
+  if (format.is888()) {
+    uint8_t layout[4];
+
+    format.byteLayout(layout);
+
+    for (int y = 0;y < buffer.height();y++) {
+      const uint8_t* fg;
+      uint8_t* bg;
+      int x;
+
+      fg = prepared.data() +
+           ((y+diff.y)*cursor->width() + diff.x)*4;
+      bg = out + y*outStride*4;
+
+      x = simd::blend888(bg, fg, layout, buffer.width());
+
+      fg += x*4;
+      bg += x*4;
+      for (;x < buffer.width();x++) {
+        unsigned ia;
+
+        ia = 255 - fg[layout[3]];
+        if (ia != 255) {
+          for (int i = 0;i < 3;i++) {
+            bg[layout[i]] = (unsigned)bg[layout[i]]*ia/255 +
+                            fg[layout[i]];
+          }
+        }
+
+        fg += 4;
+        bg += 4;
+      }
+    }
+  } else {
+    int bpp;
+
+    bpp = format.bpp/8;
+    rgbRow.resize(buffer.width()*3);
+
+    for (int y = 0;y < buffer.height();y++) {
+      const uint8_t* fg;
+      uint8_t* rgb;
+
+      fg = prepared.data() +
+           ((y+diff.y)*cursor->width() + diff.x)*4;
+
+      format.rgbFromBuffer(rgbRow.data(), out + y*outStride*bpp,
+                           buffer.width());
+
+      rgb = rgbRow.data();
+      for (int x = 0;x < buffer.width();x++) {
+        unsigned ia;
+
+        ia = 255 - fg[3];
+        if (ia != 255) {
+          for (int i = 0;i < 3;i++)
+            rgb[i] = (unsigned)rgb[i]*ia/255 + fg[i];
         }
+
+        fg += 4;
+        rgb += 3;
       }
 
-      format.bufferFromRGB(bg, rgb, 1);
-      buffer.imageRect({x, y, x+1, y+1}, bg);
+      format.bufferFromRGB(out + y*outStride*bpp, rgbRow.data(),
+                           buffer.width());
     }
   }
+
+  buffer.commitBufferRW(buffer.getRect());
+}
+
+void RenderedCursor::prepareCursor(const Cursor* cursor)
+{
+  uint8_t layout[4];
+  const uint8_t* in;
+  uint8_t* pix;
+
+  if (format.is888())
+    format.byteLayout(layout);
+  else {
+    layout[0] = 0;
+    layout[1] = 1;
+    layout[2] = 2;
+    layout[3] = 3;
+  }
+
+  prepared.resize(cursor->width()*cursor->height()*4);
+
+  in = cursor->getBuffer();
+  pix = prepared.data();
+  for (int i = 0;i < cursor->width()*cursor->height();i++) {
+    // FIXME: Gamma aware blending
+    for (int c = 0;c < 3;c++)
+      pix[layout[c]] = (unsigned)in[c]*in[3]/255;
+    pix[layout[3]] = in[3];
+
+    in += 4;
+    pix += 4;
+  }
+
+  preparedPF = format;
 }
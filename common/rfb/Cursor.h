@@ -67,12 +67,26 @@ namespace rfb {
 
     const uint8_t* getBuffer(const core::Rect& r, int* stride) const override;
 
-    void update(PixelBuffer* framebuffer, Cursor* cursor,
+    // cursorChange() must be called whenever the cursor image has
+    // changed, as update() otherwise reuses the previous one
+    void cursorChange();
+
+    void update(const PixelBuffer* framebuffer, Cursor* cursor,
                 const core::Point& pos);
 
   protected:
+    void prepareCursor(const Cursor* cursor);
+
     ManagedPixelBuffer buffer;
     core::Point offset;
+
+    // The cursor with premultiplied alpha. It is in the same byte
+    // order as the framebuffer, with alpha in the padding, if that is
+    // a 888 format, and RGBA otherwise.
+    std::vector<uint8_t> prepared;
+    PixelFormat preparedPF;
+
+    std::vector<uint8_t> rgbRow;
   };
 
 }
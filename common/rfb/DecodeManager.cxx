@@ -44,20 +44,12 @@ DecodeManager::DecodeManager(CConnection *conn_) :
 {
   size_t cpuCount;
 
-  memset(decoders, 0, sizeof(decoders));
-
-  memset(stats, 0, sizeof(stats));
-
   cpuCount = std::thread::hardware_concurrency();
   if (cpuCount == 0) {
     vlog.error(_("Unable to determine the number of CPU cores on this system"));
     cpuCount = 1;
   } else {
     vlog.info(_("Detected %d CPU core(s)"), (int)cpuCount);
-    // No point creating more threads than this, they'll just end up
-    // wasting CPU fighting for locks
-    if (cpuCount > 4)
-      cpuCount = 4;
   }
 
   vlog.info(_("Creating %d decoder thread(s)"), (int)cpuCount);
@@ -86,9 +78,17 @@ DecodeManager::~DecodeManager()
     freeBuffers.pop_back();
   }
 
-  for (Decoder* decoder : decoders)
-    delete decoder;
+  while (!freeEntries.empty()) {
+    delete freeEntries.back()->preparedStream;
+    delete freeEntries.back();
+    freeEntries.pop_back();
+  }
+
+  for (const auto& iter : decoders)
+    delete iter.second;
 
+  if (partialEntry != nullptr)
+    delete partialEntry->preparedStream;
   delete partialEntry;
 }
 
@@ -96,6 +96,7 @@ bool DecodeManager::decodeRect(const core::Rect& r, int encoding,
                                ModifiablePixelBuffer* pb)
 {
   int equiv;
+  QueueEntry* prevPrepare;
 
   assert(pb != nullptr);
 
@@ -108,12 +109,13 @@ bool DecodeManager::decodeRect(const core::Rect& r, int encoding,
       throw protocol_error(_("Unknown encoding"));
     }
 
-    if (!decoders[encoding]) {
-      decoders[encoding] = Decoder::createDecoder(encoding);
-      if (!decoders[encoding]) {
+    if (decoders.count(encoding) == 0) {
+      decoder = Decoder::createDecoder(encoding, threads.size());
+      if (!decoder) {
         vlog.error(_("Unknown encoding %d"), encoding);
         throw protocol_error(_("Unknown encoding"));
       }
+      decoders[encoding] = decoder;
     }
 
     decoder = decoders[encoding];
@@ -130,11 +132,16 @@ bool DecodeManager::decodeRect(const core::Rect& r, int encoding,
     bufferStream = freeBuffers.front();
     bufferStream->clear();
 
+    if (!freeEntries.empty()) {
+      partialEntry = freeEntries.front();
+      freeEntries.pop_front();
+    }
+
     lock.unlock();
 
-    partialEntry = new QueueEntry();
+    if (partialEntry == nullptr)
+      partialEntry = new QueueEntry();
 
-    partialEntry->active = false;
     partialEntry->rect = r;
     partialEntry->encoding = encoding;
     partialEntry->decoder = decoder;
@@ -162,12 +169,15 @@ bool DecodeManager::decodeRect(const core::Rect& r, int encoding,
     r, partialEntry->bufferStream->data(),
     partialEntry->bufferStream->length(), conn->server,
     &partialEntry->affectedRegion);
+  partialEntry->affectedBounds =
+    partialEntry->affectedRegion.get_bounding_rect();
 
-  stats[encoding].rects++;
-  stats[encoding].bytes += 12 + conn->getInStream()->pos() - beforePos;
-  stats[encoding].pixels += r.area();
+  DecoderStats& stat = stats[encoding];
+  stat.rects++;
+  stat.bytes += 12 + conn->getInStream()->pos() - beforePos;
+  stat.pixels += r.area();
   equiv = 12 + r.area() * (conn->server.pf().bpp/8);
-  stats[encoding].equivalent += equiv;
+  stat.equivalent += equiv;
 
   // Then try to put it on the queue
 
@@ -177,12 +187,42 @@ bool DecodeManager::decodeRect(const core::Rect& r, int encoding,
   // the front is still the same buffer
   freeBuffers.pop_front();
 
-  workQueue.push_back(partialEntry);
-  partialEntry = nullptr;
+  // Figure out once which earlier rects this one has to wait for, so
+  // the workers don't have to scan the queue each time they wake up
+  partialEntry->blockers = 0;
+  partialEntry->needsPrepare =
+    partialEntry->decoder->flags & DecoderOrderedPrepare;
+  partialEntry->prepareBlocked = false;
+  partialEntry->nextPrepare = nullptr;
+
+  prevPrepare = nullptr;
+  for (QueueEntry* entry : workQueue) {
+    if (partialEntry->needsPrepare && entry->needsPrepare &&
+        (entry->encoding == partialEntry->encoding))
+      prevPrepare = entry;
+
+    if (!entriesConflict(entry, partialEntry))
+      continue;
+    entry->dependents.push_back(partialEntry);
+    partialEntry->blockers++;
+  }
+
+  if (prevPrepare != nullptr) {
+    prevPrepare->nextPrepare = partialEntry;
+    partialEntry->prepareBlocked = true;
+  }
 
-  // We only put a single entry on the queue so waking a single
-  // thread is sufficient
-  consumerCond.notify_one();
+  partialEntry->queuePos = workQueue.insert(workQueue.end(), partialEntry);
+
+  if (partialEntry->needsPrepare ? !partialEntry->prepareBlocked :
+                                   (partialEntry->blockers == 0)) {
+    readyQueue.push_back(partialEntry);
+    // We only put a single entry on the queue so waking a single
+    // thread is sufficient
+    consumerCond.notify_one();
+  }
+
+  partialEntry = nullptr;
 
   lock.unlock();
 
@@ -201,10 +241,37 @@ void DecodeManager::flush()
   throwThreadException();
 }
 
-void DecodeManager::logStats()
+bool DecodeManager::entriesConflict(const QueueEntry* earlier,
+                                    const QueueEntry* later)
 {
-  size_t i;
+  if (earlier->encoding == later->encoding) {
+    // An ordered decoder must handle its rectangles in order
+    if (later->decoder->flags & DecoderOrdered)
+      return true;
+
+    // For a partially ordered decoder we must ask the decoder
+    if (later->decoder->flags & DecoderPartiallyOrdered) {
+      if (later->decoder->doRectsConflict(later->rect,
+                                          later->bufferStream->data(),
+                                          later->bufferStream->length(),
+                                          earlier->rect,
+                                          earlier->bufferStream->data(),
+                                          earlier->bufferStream->length(),
+                                          *later->server))
+        return true;
+    }
+  }
+
+  // Check overlap, using the bounding boxes to skip most of the
+  // more expensive region checks
+  if (!earlier->affectedBounds.overlaps(later->affectedBounds))
+    return false;
+
+  return !earlier->affectedRegion.intersect(later->affectedRegion).is_empty();
+}
 
+void DecodeManager::logStats()
+{
   unsigned rects;
   unsigned long long pixels, bytes, equivalent;
 
@@ -213,27 +280,30 @@ void DecodeManager::logStats()
   rects = 0;
   pixels = bytes = equivalent = 0;
 
-  for (i = 0;i < (sizeof(stats)/sizeof(stats[0]));i++) {
+  for (const auto& iter : stats) {
+    const char* name = encodingName(iter.first);
+    const DecoderStats& stat = iter.second;
+
     // Did this class do anything at all?
-    if (stats[i].rects == 0)
+    if (stat.rects == 0)
       continue;
 
-    rects += stats[i].rects;
-    pixels += stats[i].pixels;
-    bytes += stats[i].bytes;
-    equivalent += stats[i].equivalent;
+    rects += stat.rects;
+    pixels += stat.pixels;
+    bytes += stat.bytes;
+    equivalent += stat.equivalent;
 
-    ratio = (double)stats[i].equivalent / stats[i].bytes;
+    ratio = (double)stat.equivalent / stat.bytes;
 
-    vlog.info("    %s: %s, %s", encodingName(i),
+    vlog.info("    %s: %s, %s", name,
               // TRANSLATORS: Will get a SI prefix before (k/M/G/...)
-              core::siPrefix(stats[i].rects, _("rects")).c_str(),
+              core::siPrefix(stat.rects, _("rects")).c_str(),
               // TRANSLATORS: Will get a SI prefix before (k/M/G/...)
-              core::siPrefix(stats[i].pixels, _("pixels")).c_str());
+              core::siPrefix(stat.pixels, _("pixels")).c_str());
     vlog.info("    %*s  %s (1:%g %s)",
-              (int)strlen(encodingName(i)), "",
+              (int)strlen(name), "",
               // TRANSLATORS: Short form of bytes
-              core::iecPrefix(stats[i].bytes, _("B")).c_str(),
+              core::iecPrefix(stat.bytes, _("B")).c_str(),
               ratio, _("ratio"));
   }
 
@@ -317,25 +387,43 @@ void DecodeManager::DecodeThread::worker()
 
   while (!stopRequested) {
     DecodeManager::QueueEntry *entry;
+    bool prepare, released;
 
-    // Look for an available entry in the work queue
-    entry = findEntry();
-    if (entry == nullptr) {
+    if (manager->readyQueue.empty()) {
       // Wait and try again
       manager->consumerCond.wait(lock);
       continue;
     }
 
     // This is ours now
-    entry->active = true;
+    entry = manager->readyQueue.front();
+    manager->readyQueue.pop_front();
 
     lock.unlock();
 
+    prepare = entry->needsPrepare;
+
     // Do the actual decoding
     try {
-      entry->decoder->decodeRect(entry->rect, entry->bufferStream->data(),
-                                 entry->bufferStream->length(),
-                                 *entry->server, entry->pb);
+      if (prepare) {
+        if (entry->preparedStream == nullptr)
+          entry->preparedStream = new rdr::MemOutStream();
+        entry->preparedStream->clear();
+        entry->decoder->prepareRect(entry->rect,
+                                    entry->bufferStream->data(),
+                                    entry->bufferStream->length(),
+                                    *entry->server, entry->preparedStream);
+      } else if (entry->decoder->flags & DecoderOrderedPrepare) {
+        entry->decoder->decodeRect(entry->rect,
+                                   entry->preparedStream->data(),
+                                   entry->preparedStream->length(),
+                                   *entry->server, entry->pb);
+      } else {
+        entry->decoder->decodeRect(entry->rect,
+                                   entry->bufferStream->data(),
+                                   entry->bufferStream->length(),
+                                   *entry->server, entry->pb);
+      }
     } catch (std::exception& e) {
       manager->setThreadException();
     } catch(...) {
@@ -344,74 +432,49 @@ void DecodeManager::DecodeThread::worker()
 
     lock.lock();
 
-    // Remove the entry from the queue and give back the memory buffer
-    manager->freeBuffers.push_back(entry->bufferStream);
-    manager->workQueue.remove(entry);
-    delete entry;
-
-    // Wake the main thread in case it is waiting for a memory buffer
-    manager->producerCond.notify_one();
-    // This rect might have been blocking multiple other rects, so
-    // wake up every worker thread
-    if (manager->workQueue.size() > 1)
-      manager->consumerCond.notify_all();
-  }
-}
+    if (prepare) {
+      entry->needsPrepare = false;
 
-DecodeManager::QueueEntry* DecodeManager::DecodeThread::findEntry()
-{
-  core::Region lockedRegion;
-
-  if (manager->workQueue.empty())
-    return nullptr;
-
-  if (!manager->workQueue.front()->active)
-    return manager->workQueue.front();
-
-  for (DecodeManager::QueueEntry* entry : manager->workQueue) {
-    // Another thread working on this?
-    if (entry->active)
-      goto next;
-
-    // If this is an ordered decoder then make sure this is the first
-    // rectangle in the queue for that decoder
-    if (entry->decoder->flags & DecoderOrdered) {
-      for (DecodeManager::QueueEntry* entry2 : manager->workQueue) {
-        if (entry2 == entry)
-          break;
-        if (entry->encoding == entry2->encoding)
-          goto next;
+      // The next rect can now be prepared
+      if (entry->nextPrepare != nullptr) {
+        entry->nextPrepare->prepareBlocked = false;
+        manager->readyQueue.push_back(entry->nextPrepare);
+        manager->consumerCond.notify_one();
+        entry->nextPrepare = nullptr;
       }
+
+      // Decode it right away if nothing is in the way
+      if (entry->blockers == 0)
+        manager->readyQueue.push_back(entry);
+
+      continue;
     }
 
-    // For a partially ordered decoder we must ask the decoder for each
-    // pair of rectangles.
-    if (entry->decoder->flags & DecoderPartiallyOrdered) {
-      for (DecodeManager::QueueEntry* entry2 : manager->workQueue) {
-        if (entry2 == entry)
-          break;
-        if (entry->encoding != entry2->encoding)
-          continue;
-        if (entry->decoder->doRectsConflict(entry->rect,
-                                            entry->bufferStream->data(),
-                                            entry->bufferStream->length(),
-                                            entry2->rect,
-                                            entry2->bufferStream->data(),
-                                            entry2->bufferStream->length(),
-                                            *entry->server))
-          goto next;
-      }
+    // Release any rects that were waiting for this one. We'll pick up
+    // the first one ourselves, so only wake other threads for the rest.
+    released = false;
+    for (DecodeManager::QueueEntry* dependent : entry->dependents) {
+      assert(dependent->blockers > 0);
+      if (--dependent->blockers != 0)
+        continue;
+      // Will be queued once it has been prepared
+      if (dependent->needsPrepare)
+        continue;
+
+      manager->readyQueue.push_back(dependent);
+      if (released)
+        manager->consumerCond.notify_one();
+      released = true;
     }
 
-    // Check overlap with earlier rectangles
-    if (!lockedRegion.intersect(entry->affectedRegion).is_empty())
-      goto next;
+    // Remove the entry from the queue and give back the memory buffer
+    manager->freeBuffers.push_back(entry->bufferStream);
+    manager->workQueue.erase(entry->queuePos);
 
-    return entry;
+    entry->dependents.clear();
+    manager->freeEntries.push_back(entry);
 
-next:
-    lockedRegion.assign_union(entry->affectedRegion);
+    // Wake the main thread in case it is waiting for a memory buffer
+    manager->producerCond.notify_one();
   }
-
-  return nullptr;
 }
@@ -22,8 +22,10 @@
 #include <condition_variable>
 #include <exception>
 #include <list>
+#include <map>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include <core/Region.h>
 
@@ -61,7 +63,8 @@ namespace rfb {
 
   private:
     CConnection *conn;
-    Decoder *decoders[encodingMax+1];
+    // Not arrays, as vendor specific encodings have large numbers
+    std::map<int, Decoder*> decoders;
 
     struct DecoderStats {
       unsigned rects;
@@ -70,22 +73,44 @@ namespace rfb {
       unsigned long long equivalent;
     };
 
-    DecoderStats stats[encodingMax+1];
+    std::map<int, DecoderStats> stats;
     size_t beforePos;
 
     struct QueueEntry {
-      bool active;
       core::Rect rect;
       int encoding;
       Decoder* decoder;
       const ServerParams* server;
       ModifiablePixelBuffer* pb;
       rdr::MemOutStream* bufferStream;
+      rdr::MemOutStream* preparedStream;
       core::Region affectedRegion;
+      core::Rect affectedBounds;
+
+      // Number of earlier entries that must finish before this one
+      unsigned blockers;
+      // Later entries that are waiting for this one
+      std::vector<QueueEntry*> dependents;
+
+      // Still waiting for prepareRect() to be called
+      bool needsPrepare;
+      // An earlier entry still needs to be prepared
+      bool prepareBlocked;
+      // The next entry to prepare after this one
+      QueueEntry* nextPrepare;
+
+      std::list<QueueEntry*>::iterator queuePos;
     };
 
+    bool entriesConflict(const QueueEntry* earlier,
+                         const QueueEntry* later);
+
     std::list<rdr::MemOutStream*> freeBuffers;
+    std::list<QueueEntry*> freeEntries;
+    // All entries that haven't finished yet, in order
     std::list<QueueEntry*> workQueue;
+    // Entries that have nothing blocking them
+    std::list<QueueEntry*> readyQueue;
     QueueEntry* partialEntry;
 
     std::mutex queueMutex;
@@ -103,7 +128,6 @@ namespace rfb {
 
     protected:
       void worker();
-      DecodeManager::QueueEntry* findEntry();
 
     private:
       DecodeManager* manager;
@@ -25,6 +25,8 @@
 
 #include <core/Region.h>
 
+#include <rdr/OutStream.h>
+
 #include <rfb/encodings.h>
 #include <rfb/Decoder.h>
 #include <rfb/RawDecoder.h>
@@ -34,6 +36,7 @@
 #include <rfb/JPEGDecoder.h>
 #include <rfb/ZRLEDecoder.h>
 #include <rfb/TightDecoder.h>
+#include <rfb/TileCacheDecoder.h>
 #ifdef HAVE_H264
 #include <rfb/H264Decoder.h>
 #endif
@@ -68,6 +71,13 @@ bool Decoder::doRectsConflict(const core::Rect& /*rectA*/,
   return false;
 }
 
+void Decoder::prepareRect(const core::Rect& /*r*/, const uint8_t* buffer,
+                          size_t buflen, const ServerParams& /*server*/,
+                          rdr::OutStream* os)
+{
+  os->writeBytes(buffer, buflen);
+}
+
 bool Decoder::supported(int encoding)
 {
   switch (encoding) {
@@ -78,6 +88,7 @@ bool Decoder::supported(int encoding)
   case encodingJPEG:
   case encodingZRLE:
   case encodingTight:
+  case encodingTileCache:
 #ifdef HAVE_H264
   case encodingH264:
 #endif
@@ -87,8 +98,12 @@ bool Decoder::supported(int encoding)
   }
 }
 
-Decoder* Decoder::createDecoder(int encoding)
+Decoder* Decoder::createDecoder(int encoding, int threads)
 {
+#ifndef HAVE_H264
+  (void)threads;
+#endif
+
   switch (encoding) {
   case encodingRaw:
     return new RawDecoder();
@@ -104,9 +119,11 @@ Decoder* Decoder::createDecoder(int encoding)
     return new ZRLEDecoder();
   case encodingTight:
     return new TightDecoder();
+  case encodingTileCache:
+    return new TileCacheDecoder();
 #ifdef HAVE_H264
   case encodingH264:
-    return new H264Decoder();
+    return new H264Decoder(threads);
 #endif
   default:
     return nullptr;
@@ -45,6 +45,9 @@ namespace rfb {
     // Only some of the rects must be handled in order,
     // see doesRectsConflict()
     DecoderPartiallyOrdered = 1 << 1,
+    // All rects for this decoder must be prepared in order, but can
+    // then be decoded in any order, see prepareRect()
+    DecoderOrderedPrepare = 1 << 2,
   };
 
   class Decoder {
@@ -83,6 +86,17 @@ namespace rfb {
                                  size_t buflenB,
                                  const ServerParams& server);
 
+    // prepareRect() converts the data read by readRect() into
+    // something that can be decoded independently of other rects, e.g.
+    // by decompressing it. It will be called in the order the rects
+    // were received, but not necessarily on the same thread. This will
+    // only be called if the DecoderOrderedPrepare flag has been set, and
+    // decodeRect() will then be given the data written to the
+    // OutStream. The default implementation simply copies the data.
+    virtual void prepareRect(const core::Rect& r, const uint8_t* buffer,
+                             size_t buflen, const ServerParams& server,
+                             rdr::OutStream* os);
+
     // decodeRect() decodes the given rectangle with data from the
     // given buffer, onto the ModifiablePixelBuffer. The PixelFormat of
     // the PixelBuffer might not match the ConnParams and it is up to
@@ -93,7 +107,10 @@ namespace rfb {
 
   public:
     static bool supported(int encoding);
-    static Decoder* createDecoder(int encoding);
+    // threads is the number of worker threads that rects are decoded
+    // on. Decoders that can also split a single rect over several
+    // threads keep their total below this.
+    static Decoder* createDecoder(int encoding, int threads);
 
   public:
     const enum DecoderFlags flags;
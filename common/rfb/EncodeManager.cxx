@@ -23,18 +23,22 @@
 #include <config.h>
 #endif
 
+#include <assert.h>
 #include <stdlib.h>
 
 #include <core/LogWriter.h>
 #include <core/i18n.h>
 #include <core/string.h>
+#include <core/time.h>
 
+#include <rfb/ShadowPixelBuffer.h>
 #include <rfb/Cursor.h>
 #include <rfb/EncodeManager.h>
 #include <rfb/Encoder.h>
 #include <rfb/Palette.h>
 #include <rfb/SConnection.h>
 #include <rfb/SMsgWriter.h>
+#include <rfb/ServerCore.h>
 #include <rfb/UpdateTracker.h>
 #include <rfb/encodings.h>
 
@@ -141,12 +145,17 @@ static const char *encoderTypeName(EncoderType type)
 }
 
 EncodeManager::EncodeManager(SConnection* conn_)
-  : conn(conn_), recentChangeTimer(this)
+  : conn(conn_), recentChangeTimer(this), trimTimer(this),
+    convertedUsed(false),
+    encodingUpdate(false), recentChangeTimedOut(false),
+    shadowPixelBuffer(nullptr),
+    useTileCache(false), allowLossyTiles(false)
 {
   StatsVector::iterator iter;
 
   encoders.resize(encoderClassMax, nullptr);
   activeEncoders.resize(encoderTypeMax, encoderRaw);
+  encoderUsed.resize(encoderClassMax, false);
 
   encoders[encoderRaw] = new RawEncoder(conn);
   encoders[encoderRRE] = new RREEncoder(conn);
@@ -158,6 +167,7 @@ EncodeManager::EncodeManager(SConnection* conn_)
 
   updates = 0;
   memset(&copyStats, 0, sizeof(copyStats));
+  memset(&cacheStats, 0, sizeof(cacheStats));
   stats.resize(encoderClassMax);
   for (iter = stats.begin();iter != stats.end();++iter) {
     StatsVector::value_type::iterator iter2;
@@ -211,6 +221,28 @@ void EncodeManager::logStats()
               ratio, _("ratio"));
   }
 
+  if (cacheStats.rects != 0) {
+    vlog.info("  %s:", "TileCache");
+
+    rects += cacheStats.rects;
+    pixels += cacheStats.pixels;
+    bytes += cacheStats.bytes;
+    equivalent += cacheStats.equivalent;
+
+    ratio = (double)cacheStats.equivalent / cacheStats.bytes;
+
+    vlog.info("    %s: %s, %s", _("Cached"),
+              // TRANSLATORS: Will get a SI prefix before (k/M/G/...)
+              core::siPrefix(cacheStats.rects, _("rects")).c_str(),
+              // TRANSLATORS: Will get a SI prefix before (k/M/G/...)
+              core::siPrefix(cacheStats.pixels, _("pixels")).c_str());
+    vlog.info("    %*s  %s (1:%g %s)",
+              (int)strlen(_("Cached")), "",
+              // TRANSLATORS: Short form of bytes
+              core::iecPrefix(cacheStats.bytes, _("B")).c_str(),
+              ratio, _("ratio"));
+  }
+
   for (i = 0;i < stats.size();i++) {
     // Did this class do anything at all?
     for (j = 0;j < stats[i].size();j++) {
@@ -258,6 +290,31 @@ void EncodeManager::logStats()
             // TRANSLATORS: Short form of bytes
             core::iecPrefix(bytes, _("B")).c_str(),
             ratio, _("ratio"));
+
+  vlog.info("  %s: %s", _("Memory"),
+            // TRANSLATORS: Short form of bytes
+            core::iecPrefix(getMemoryUsage(), _("B")).c_str());
+  logMemoryUsage(core::LogWriter::LEVEL_INFO);
+}
+
+void EncodeManager::logMemoryUsage(int level)
+{
+  for (size_t i = 0;i < encoders.size();i++) {
+    size_t usage;
+
+    usage = encoders[i]->getMemoryUsage();
+    if (usage == 0)
+      continue;
+
+    vlog.write(level, "    %s: %s", encoderClassName((EncoderClass)i),
+               // TRANSLATORS: Short form of bytes
+               core::iecPrefix(usage, _("B")).c_str());
+  }
+  if (convertedPixelBuffer.getBufferSize() != 0)
+    vlog.write(level, "    %s: %s", _("Converted pixels"),
+               // TRANSLATORS: Short form of bytes
+               core::iecPrefix(convertedPixelBuffer.getBufferSize(),
+                               _("B")).c_str());
 }
 
 bool EncodeManager::supported(int encoding)
@@ -277,13 +334,13 @@ bool EncodeManager::supported(int encoding)
 
 bool EncodeManager::needsLosslessRefresh(const core::Region& req)
 {
-  return !lossyRegion.intersect(req).is_empty();
+  return !lossyRegion.intersect(scaleRegion(req)).is_empty();
 }
 
 int EncodeManager::getNextLosslessRefresh(const core::Region& req)
 {
   // Do we have something we can send right away?
-  if (!pendingRefreshRegion.intersect(req).is_empty())
+  if (!pendingRefreshRegion.intersect(scaleRegion(req)).is_empty())
     return 0;
 
   assert(needsLosslessRefresh(req));
@@ -294,26 +351,74 @@ int EncodeManager::getNextLosslessRefresh(const core::Region& req)
 
 void EncodeManager::pruneLosslessRefresh(const core::Region& limits)
 {
-  lossyRegion.assign_intersect(limits);
-  pendingRefreshRegion.assign_intersect(limits);
+  lossyRegion.assign_intersect(scaleRegion(limits));
+  pendingRefreshRegion.assign_intersect(scaleRegion(limits));
 }
 
 void EncodeManager::forceRefresh(const core::Region& req)
 {
-  lossyRegion.assign_union(req);
+  lossyRegion.assign_union(scaleRegion(req));
   if (!recentChangeTimer.isStarted())
-    pendingRefreshRegion.assign_union(req);
+    pendingRefreshRegion.assign_union(scaleRegion(req));
+}
+
+void EncodeManager::setShadowPixelBuffer(ShadowPixelBuffer* spb)
+{
+  shadowPixelBuffer = spb;
 }
 
 void EncodeManager::writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
                                 const RenderedCursor* renderedCursor)
 {
-  doUpdate(true, ui.changed, ui.copied, ui.copy_delta, pb, renderedCursor);
+  startUpdate();
+  encodeUpdate(ui, pb, renderedCursor);
+  finishUpdate();
+}
+
+void EncodeManager::startUpdate()
+{
+  assert(!encodingUpdate);
+  encodingUpdate = true;
+}
+
+void EncodeManager::encodeUpdate(const UpdateInfo& ui,
+                                 const PixelBuffer* pb,
+                                 const RenderedCursor* renderedCursor)
+{
+  assert(encodingUpdate);
+
+  if (conn->client.scaleFactor > 1) {
+    core::Region changed;
+
+    // Scaled copies rarely line up, so just send everything as
+    // changed pixels
+    changed = updateScaledPixelBuffer(ui.changed.union_(ui.copied),
+                                      pb, renderedCursor);
+    doUpdate(true, changed, {}, {}, &scaledPixelBuffer, nullptr);
+
+    recentlyChangedRegion.assign_union(changed);
+  } else {
+    doUpdate(true, ui.changed, ui.copied, ui.copy_delta, pb, renderedCursor);
+
+    recentlyChangedRegion.assign_union(ui.changed);
+    recentlyChangedRegion.assign_union(ui.copied);
+  }
+}
+
+void EncodeManager::finishUpdate()
+{
+  assert(encodingUpdate);
+  encodingUpdate = false;
+
+  if (recentChangeTimedOut) {
+    recentChangeTimedOut = false;
+    schedulePendingRefresh();
+  }
 
-  recentlyChangedRegion.assign_union(ui.changed);
-  recentlyChangedRegion.assign_union(ui.copied);
   if (!recentChangeTimer.isStarted())
     recentChangeTimer.start(RecentChangeTimeout);
+
+  startTrimTimer();
 }
 
 void EncodeManager::writeLosslessRefresh(const core::Region& req,
@@ -321,24 +426,116 @@ void EncodeManager::writeLosslessRefresh(const core::Region& req,
                                          const RenderedCursor* renderedCursor,
                                          size_t maxUpdateSize)
 {
+  if (conn->client.scaleFactor > 1) {
+    // The scaled pixels are still valid for anything not pending an
+    // update, which is all that can be refreshed
+    if (!scaledPixelBuffer.matchesSource(pb, conn->client.scaleFactor))
+      return;
+    doUpdate(false, getLosslessRefresh(scaleRegion(req), maxUpdateSize),
+             {}, {}, &scaledPixelBuffer, nullptr);
+    startTrimTimer();
+    return;
+  }
+
   doUpdate(false, getLosslessRefresh(req, maxUpdateSize),
            {}, {}, pb, renderedCursor);
+
+  startTrimTimer();
 }
 
 void EncodeManager::handleTimeout(core::Timer* t)
 {
   if (t == &recentChangeTimer) {
-    // Any lossy region that wasn't recently updated can
-    // now be scheduled for a refresh
-    pendingRefreshRegion.assign_union(lossyRegion.subtract(recentlyChangedRegion));
-    recentlyChangedRegion.clear();
+    // finishUpdate() will take care of things, and restart the timer
+    if (encodingUpdate) {
+      recentChangeTimedOut = true;
+      return;
+    }
+
+    schedulePendingRefresh();
 
     // Will there be more to do? (i.e. do we need another round)
     if (!lossyRegion.subtract(pendingRefreshRegion).is_empty())
       t->repeat();
+  } else if (t == &trimTimer) {
+    // Can't touch the encoders whilst they are busy, so check again
+    // later
+    if (encodingUpdate) {
+      t->repeat();
+      return;
+    }
+
+    // Keep going as long as something is still in use
+    if (trimMemory())
+      t->repeat();
   }
 }
 
+void EncodeManager::schedulePendingRefresh()
+{
+  // Any lossy region that wasn't recently updated can
+  // now be scheduled for a refresh
+  pendingRefreshRegion.assign_union(lossyRegion.subtract(recentlyChangedRegion));
+  recentlyChangedRegion.clear();
+}
+
+void EncodeManager::startTrimTimer()
+{
+  if (trimTimer.isStarted())
+    return;
+  if (!Server::encoderIdleTimeout)
+    return;
+
+  trimTimer.start(core::secsToMillis(Server::encoderIdleTimeout));
+}
+
+bool EncodeManager::trimMemory()
+{
+  size_t before, after;
+  bool inUse;
+
+  before = getMemoryUsage();
+  inUse = false;
+
+  for (size_t i = 0;i < encoders.size();i++) {
+    if (encoderUsed[i]) {
+      encoderUsed[i] = false;
+      inUse = true;
+      continue;
+    }
+
+    encoders[i]->releaseMemory();
+  }
+
+  if (convertedUsed) {
+    convertedUsed = false;
+    inUse = true;
+  } else {
+    convertedPixelBuffer.releaseBuffer();
+  }
+
+  // Also serves as a periodic report of what each client costs, for
+  // as long as it is active
+  after = getMemoryUsage();
+  vlog.debug("Encoder memory: %s (%s released)",
+             core::iecPrefix(after, "B").c_str(),
+             core::iecPrefix(before - after, "B").c_str());
+  logMemoryUsage(core::LogWriter::LEVEL_DEBUG);
+
+  return inUse;
+}
+
+size_t EncodeManager::getMemoryUsage()
+{
+  size_t usage;
+
+  usage = convertedPixelBuffer.getBufferSize();
+  for (Encoder* encoder : encoders)
+    usage += encoder->getMemoryUsage();
+
+  return usage;
+}
+
 void EncodeManager::doUpdate(bool allowLossy, const
                              core::Region& changed_,
                              const core::Region& copied,
@@ -353,6 +550,12 @@ void EncodeManager::doUpdate(bool allowLossy, const
 
     prepareEncoders(allowLossy);
 
+    // The cache changes the number of rects, so we can't use it
+    // unless the client can handle us not knowing that up front
+    useTileCache = conn->client.supportsEncoding(encodingTileCache) &&
+                   conn->client.supportsEncoding(pseudoEncodingLastRect);
+    allowLossyTiles = allowLossy;
+
     changed = changed_;
 
     if (!conn->client.supportsEncoding(encodingCopyRect))
@@ -379,6 +582,16 @@ void EncodeManager::doUpdate(bool allowLossy, const
 
     conn->writer()->writeFramebufferUpdateStart(nRects);
 
+    // The client stores tiles after converting them to its pixel
+    // format, so they can't be reused once that changes
+    if (useTileCache && (conn->client.pf() != tileCachePF)) {
+      if (tileCache.numTiles() != 0) {
+        tileCache.clear();
+        conn->writer()->writeTileCacheRect({}, tileCacheClear, 0);
+      }
+      tileCachePF = conn->client.pf();
+    }
+
     if (conn->client.supportsEncoding(encodingCopyRect))
       writeCopyRects(copied, copyDelta);
 
@@ -389,12 +602,63 @@ void EncodeManager::doUpdate(bool allowLossy, const
     if (conn->client.supportsEncoding(pseudoEncodingLastRect))
       writeSolidRects(&changed, pb);
 
-    writeRects(changed, pb);
-    writeRects(cursorRegion, renderedCursor);
+    writeRects(changed, pb, useTileCache);
+    writeRects(cursorRegion, renderedCursor, false);
 
     conn->writer()->writeFramebufferUpdateEnd();
 }
 
+core::Region EncodeManager::scaleRegion(const core::Region& region)
+{
+  return ScaledPixelBuffer::scaleRegion(region, conn->client.scaleFactor);
+}
+
+core::Region EncodeManager::updateScaledPixelBuffer(const core::Region& changed_,
+                                                    const PixelBuffer* pb,
+                                                    const RenderedCursor* renderedCursor)
+{
+  int scale;
+  core::Region changed;
+  std::vector<core::Rect> rects;
+
+  scale = conn->client.scaleFactor;
+
+  if (!scaledPixelBuffer.matchesSource(pb, scale)) {
+    scaledPixelBuffer.setSource(pb->getPF(), pb->width(), pb->height(),
+                                scale);
+    changed = scaledPixelBuffer.getRect();
+  } else {
+    changed = ScaledPixelBuffer::scaleRegion(changed_, scale);
+  }
+
+  changed.get_rects(&rects);
+  for (const core::Rect& rect : rects)
+    scaledPixelBuffer.update(rect, pb, pb->getRect());
+
+  // The cursor is blended in to the pixels fully covered by it. The
+  // ones along the edges would need a mix of the cursor and the
+  // framebuffer, so we leave those without the cursor.
+  if (renderedCursor != nullptr) {
+    core::Rect cursorRect, scaledRect;
+
+    cursorRect = renderedCursor->getEffectiveRect();
+    scaledRect.tl.x = (cursorRect.tl.x + scale - 1) / scale;
+    scaledRect.tl.y = (cursorRect.tl.y + scale - 1) / scale;
+    scaledRect.br.x = cursorRect.br.x / scale;
+    scaledRect.br.y = cursorRect.br.y / scale;
+    if (cursorRect.br.x == pb->width())
+      scaledRect.br.x = scaledPixelBuffer.width();
+    if (cursorRect.br.y == pb->height())
+      scaledRect.br.y = scaledPixelBuffer.height();
+
+    changed.intersect(scaledRect).get_rects(&rects);
+    for (const core::Rect& rect : rects)
+      scaledPixelBuffer.update(rect, renderedCursor, cursorRect);
+  }
+
+  return changed;
+}
+
 void EncodeManager::prepareEncoders(bool allowLossy)
 {
   enum EncoderClass solid, bitmap, bitmapRLE;
@@ -651,6 +915,7 @@ Encoder* EncodeManager::startRect(const core::Rect& rect, int type)
   stats[klass][activeType].equivalent += equiv;
 
   encoder = encoders[klass];
+  encoderUsed[klass] = true;
   conn->writer()->startRect(rect, encoder->encoding);
 
   if ((encoder->flags & EncoderLossy) &&
@@ -832,7 +1097,8 @@ void EncodeManager::findSolidRect(const core::Rect& rect,
 }
 
 void EncodeManager::writeRects(const core::Region& changed,
-                               const PixelBuffer* pb)
+                               const PixelBuffer* pb,
+                               bool allowCache)
 {
   std::vector<core::Rect> rects;
   std::vector<core::Rect>::const_iterator rect;
@@ -847,7 +1113,7 @@ void EncodeManager::writeRects(const core::Region& changed,
 
     // No split necessary?
     if (((w*h) < SubRectMaxArea) && (w < SubRectMaxWidth)) {
-      writeSubRect(*rect, pb);
+      writeSubRect(*rect, pb, allowCache);
       continue;
     }
 
@@ -868,17 +1134,21 @@ void EncodeManager::writeRects(const core::Region& changed,
         if (sr.br.x > rect->br.x)
           sr.br.x = rect->br.x;
 
-        writeSubRect(sr, pb);
+        writeSubRect(sr, pb, allowCache);
       }
     }
   }
 }
 
 void EncodeManager::writeSubRect(const core::Rect& rect,
-                                 const PixelBuffer* pb)
+                                 const PixelBuffer* pb,
+                                 bool allowCache)
 {
   PixelBuffer *ppb;
 
+  bool cacheable;
+  uint64_t hash;
+
   Encoder *encoder;
 
   struct RectInfo info;
@@ -887,6 +1157,16 @@ void EncodeManager::writeSubRect(const core::Rect& rect,
   bool useRLE;
   EncoderType type;
 
+  // Small rects are cheap enough to encode that it isn't worth the
+  // overhead of a cache reference
+  hash = 0;
+  cacheable = allowCache && (rect.area() >= TileCache::minArea);
+  if (cacheable) {
+    hash = TileCache::hashRect(pb, rect);
+    if (writeCachedTile(rect, hash))
+      return;
+  }
+
   // FIXME: This is roughly the algorithm previously used by the Tight
   //        encoder. It seems a bit backwards though, that higher
   //        compression setting means spending less effort in building
@@ -958,6 +1238,55 @@ void EncodeManager::writeSubRect(const core::Rect& rect,
   encoder->writeRect(ppb, info.palette);
 
   endRect();
+
+  // Solid rects are already about as small as a cache reference
+  if (cacheable && (type != encoderSolid))
+    storeTile(rect, hash);
+}
+
+bool EncodeManager::writeCachedTile(const core::Rect& rect, uint64_t hash)
+{
+  const TileCache::Tile* tile;
+
+  tile = tileCache.peek(hash);
+  if (tile == nullptr)
+    return false;
+  if (tile->lossy && !allowLossyTiles)
+    return false;
+
+  tileCache.lookup(hash);
+
+  beforeLength = conn->getOutStream()->length();
+
+  cacheStats.rects++;
+  cacheStats.pixels += rect.area();
+  cacheStats.equivalent += 12 + rect.area() * (conn->client.pf().bpp/8);
+
+  conn->writer()->writeTileCacheRect(rect, tileCacheLoad, hash);
+
+  cacheStats.bytes += conn->getOutStream()->length() - beforeLength;
+
+  // Same bookkeeping as startRect()
+  if (tile->lossy)
+    lossyRegion.assign_union(rect);
+  else
+    lossyRegion.assign_subtract(rect);
+
+  pendingRefreshRegion.assign_subtract(rect);
+
+  return true;
+}
+
+void EncodeManager::storeTile(const core::Rect& rect, uint64_t hash)
+{
+  TileCache::Tile* tile;
+
+  tile = tileCache.insert(hash, rect.width(), rect.height());
+  tile->lossy = !lossyRegion.intersect(rect).is_empty();
+
+  beforeLength = conn->getOutStream()->length();
+  conn->writer()->writeTileCacheRect(rect, tileCacheStore, hash);
+  cacheStats.bytes += conn->getOutStream()->length() - beforeLength;
 }
 
 bool EncodeManager::checkSolidTile(const core::Rect& r,
@@ -1093,8 +1422,24 @@ PixelBuffer* EncodeManager::preparePixelBuffer(const core::Rect& rect,
 
   // Do wo need to convert the data?
   if (convert && conn->client.pf() != pb->getPF()) {
+    ShadowPixelBuffer* spb;
+
+    // Someone might already have converted these pixels for us
+    spb = shadowPixelBuffer;
+    if ((spb != nullptr) && (spb->getSource() == pb) &&
+        (spb->getPF() == conn->client.pf())) {
+      spb->update(rect);
+
+      buffer = spb->getBuffer(rect, &stride);
+      offsetPixelBuffer.update(spb->getPF(), rect.width(), rect.height(),
+                               buffer, stride);
+
+      return &offsetPixelBuffer;
+    }
+
     convertedPixelBuffer.setPF(conn->client.pf());
     convertedPixelBuffer.setSize(rect.width(), rect.height());
+    convertedUsed = true;
 
     buffer = pb->getBuffer(rect, &stride);
     convertedPixelBuffer.imageRect(pb->getPF(),
@@ -28,10 +28,13 @@
 #include <core/Timer.h>
 
 #include <rfb/PixelBuffer.h>
+#include <rfb/ScaledPixelBuffer.h>
+#include <rfb/TileCache.h>
 
 namespace rfb {
 
   class SConnection;
+  class ShadowPixelBuffer;
   class Encoder;
   class UpdateInfo;
   class PixelBuffer;
@@ -56,9 +59,23 @@ namespace rfb {
 
     void forceRefresh(const core::Region& req);
 
+    // setShadowPixelBuffer() provides a copy of the framebuffer that
+    // is already in the client's pixel format, which will be used
+    // instead of converting the pixels for every rect
+    void setShadowPixelBuffer(ShadowPixelBuffer* spb);
+
     void writeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
                      const RenderedCursor* renderedCursor);
 
+    // startUpdate(), encodeUpdate() and finishUpdate() together do the
+    // same thing as writeUpdate(), but encodeUpdate() may be called on
+    // a different thread. Nothing else may be done with this object,
+    // or the connection, until finishUpdate() has been called.
+    void startUpdate();
+    void encodeUpdate(const UpdateInfo& ui, const PixelBuffer* pb,
+                      const RenderedCursor* renderedCursor);
+    void finishUpdate();
+
     void writeLosslessRefresh(const core::Region& req,
                               const PixelBuffer* pb,
                               const RenderedCursor* renderedCursor,
@@ -67,6 +84,13 @@ namespace rfb {
   protected:
     void handleTimeout(core::Timer* t) override;
 
+    void schedulePendingRefresh();
+
+    void startTrimTimer();
+    bool trimMemory();
+    size_t getMemoryUsage();
+    void logMemoryUsage(int level);
+
     void doUpdate(bool allowLossy, const core::Region& changed,
                   const core::Region& copied,
                   const core::Point& copy_delta,
@@ -74,6 +98,11 @@ namespace rfb {
                   const RenderedCursor* renderedCursor);
     void prepareEncoders(bool allowLossy);
 
+    core::Region scaleRegion(const core::Region& region);
+    core::Region updateScaledPixelBuffer(const core::Region& changed,
+                                         const PixelBuffer* pb,
+                                         const RenderedCursor* renderedCursor);
+
     core::Region getLosslessRefresh(const core::Region& req,
                                     size_t maxUpdateSize);
 
@@ -87,9 +116,13 @@ namespace rfb {
     void writeSolidRects(core::Region* changed, const PixelBuffer* pb);
     void findSolidRect(const core::Rect& rect, core::Region* changed,
                        const PixelBuffer* pb);
-    void writeRects(const core::Region& changed, const PixelBuffer* pb);
+    void writeRects(const core::Region& changed, const PixelBuffer* pb,
+                    bool allowCache);
 
-    void writeSubRect(const core::Rect& rect, const PixelBuffer* pb);
+    void writeSubRect(const core::Rect& rect, const PixelBuffer* pb,
+                      bool allowCache);
+    bool writeCachedTile(const core::Rect& rect, uint64_t hash);
+    void storeTile(const core::Rect& rect, uint64_t hash);
 
     bool checkSolidTile(const core::Rect& r, const uint8_t* colourValue,
                         const PixelBuffer *pb);
@@ -130,6 +163,17 @@ namespace rfb {
 
     core::Timer recentChangeTimer;
 
+    // Encoders that have been used since the last time the trim timer
+    // fired, and hence get to keep their memory
+    core::Timer trimTimer;
+    std::vector<bool> encoderUsed;
+    bool convertedUsed;
+
+    // An update is being encoded on another thread, so the timer has
+    // to leave the regions alone until it is done
+    bool encodingUpdate;
+    bool recentChangeTimedOut;
+
     struct EncoderStats {
       unsigned rects;
       unsigned long long bytes;
@@ -140,6 +184,7 @@ namespace rfb {
 
     unsigned updates;
     EncoderStats copyStats;
+    EncoderStats cacheStats;
     StatsVector stats;
     int activeType;
     int beforeLength;
@@ -158,6 +203,14 @@ namespace rfb {
 
     OffsetPixelBuffer offsetPixelBuffer;
     ManagedPixelBuffer convertedPixelBuffer;
+    ShadowPixelBuffer* shadowPixelBuffer;
+    ScaledPixelBuffer scaledPixelBuffer;
+
+    // Mirror of the client's tile cache
+    TileCache tileCache;
+    PixelFormat tileCachePF;
+    bool useTileCache;
+    bool allowLossyTiles;
   };
 
 }
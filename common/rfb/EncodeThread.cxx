@@ -0,0 +1,170 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdexcept>
+
+#include <core/Exception.h>
+
+#include <rfb/EncodeManager.h>
+#include <rfb/EncodeThread.h>
+
+using namespace rfb;
+
+EncodeThread::EncodeThread()
+  : thread(nullptr), stopRequested(false), manager(nullptr),
+    pb(nullptr), cursor(nullptr), pending(false), exception(nullptr)
+{
+#ifndef WIN32
+  if (pipe(notifyFds) < 0)
+    throw core::posix_error("pipe", errno);
+
+  for (int fd : notifyFds) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#else
+  throw std::logic_error("Threaded encoding is not supported on this platform");
+#endif
+
+  thread = new std::thread(&EncodeThread::worker, this);
+}
+
+EncodeThread::~EncodeThread()
+{
+  {
+    const std::lock_guard<std::mutex> lock(mutex);
+    stopRequested = true;
+    consumerCond.notify_all();
+  }
+
+  thread->join();
+  delete thread;
+
+#ifndef WIN32
+  close(notifyFds[0]);
+  close(notifyFds[1]);
+#endif
+}
+
+void EncodeThread::start(EncodeManager* manager_, const UpdateInfo& ui_,
+                         const PixelBuffer* pb_,
+                         const RenderedCursor* cursor_)
+{
+  assert(!isBusy());
+
+  manager_->startUpdate();
+
+  const std::lock_guard<std::mutex> lock(mutex);
+
+  manager = manager_;
+  ui = ui_;
+  pb = pb_;
+  cursor = cursor_;
+
+  pending = true;
+  consumerCond.notify_one();
+}
+
+bool EncodeThread::isDone()
+{
+  const std::lock_guard<std::mutex> lock(mutex);
+
+  assert(isBusy());
+
+  return !pending;
+}
+
+void EncodeThread::finish()
+{
+  EncodeManager* finished;
+  std::exception_ptr e;
+
+  assert(isBusy());
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (pending)
+      producerCond.wait(lock);
+
+    finished = manager;
+    manager = nullptr;
+
+    e = exception;
+    exception = nullptr;
+
+#ifndef WIN32
+    char dummy;
+    while (read(notifyFds[0], &dummy, 1) > 0)
+      ;
+#endif
+  }
+
+  finished->finishUpdate();
+
+  if (e)
+    std::rethrow_exception(e);
+}
+
+void EncodeThread::worker()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (!stopRequested) {
+    std::exception_ptr e;
+
+    if (!pending) {
+      // Wait and try again
+      consumerCond.wait(lock);
+      continue;
+    }
+
+    lock.unlock();
+
+    try {
+      manager->encodeUpdate(ui, pb, cursor);
+    } catch (...) {
+      e = std::current_exception();
+    }
+
+    lock.lock();
+
+    exception = e;
+    pending = false;
+
+    producerCond.notify_one();
+
+    // Wake up the main loop as well. This is done with the lock held,
+    // so that finish() is guaranteed to find this byte and clear it.
+#ifndef WIN32
+    if (write(notifyFds[1], "", 1) < 0)
+      assert(errno == EAGAIN);
+#endif
+  }
+}
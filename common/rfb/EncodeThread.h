@@ -0,0 +1,92 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// EncodeThread encodes framebuffer updates on a separate thread, so
+// that the main loop can keep running whilst an update is compressed.
+// Only one update can be in progress at a time.
+//
+
+#ifndef __RFB_ENCODETHREAD_H__
+#define __RFB_ENCODETHREAD_H__
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include <rfb/UpdateTracker.h>
+
+namespace rfb {
+
+  class EncodeManager;
+  class PixelBuffer;
+  class RenderedCursor;
+
+  class EncodeThread {
+  public:
+    EncodeThread();
+    ~EncodeThread();
+
+    // start() hands over an update to the thread. The EncodeManager,
+    // the connection it writes to and the buffers must be left alone
+    // until finish() has been called.
+    void start(EncodeManager* manager, const UpdateInfo& ui,
+               const PixelBuffer* pb, const RenderedCursor* cursor);
+
+    // isBusy() returns true from start() until finish()
+    bool isBusy() const { return manager != nullptr; }
+
+    // isDone() returns true if finish() can be called without waiting
+    bool isDone();
+
+    // finish() waits for the update to be encoded and completes it on
+    // the calling thread. Any error from the encoding is thrown here.
+    void finish();
+
+    // getNotifyFd() returns a file descriptor that becomes readable
+    // once the update is done, and stays so until finish() is called.
+    // This allows the main loop to wait for the update along with its
+    // sockets.
+    int getNotifyFd() const { return notifyFds[0]; }
+
+  protected:
+    void worker();
+
+  private:
+    std::thread* thread;
+    bool stopRequested;
+
+    int notifyFds[2];
+
+    std::mutex mutex;
+    std::condition_variable producerCond;
+    std::condition_variable consumerCond;
+
+    EncodeManager* manager;
+    UpdateInfo ui;
+    const PixelBuffer* pb;
+    const RenderedCursor* cursor;
+
+    bool pending;
+    std::exception_ptr exception;
+  };
+
+}
+
+#endif
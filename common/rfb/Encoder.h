@@ -20,6 +20,7 @@
 #ifndef __RFB_ENCODER_H__
 #define __RFB_ENCODER_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace rfb {
@@ -84,6 +85,14 @@ namespace rfb {
                                 const PixelFormat& pf,
                                 const uint8_t* colour)=0;
 
+    // getMemoryUsage() returns roughly how many bytes of buffers and
+    // compression state the encoder currently holds on to.
+    virtual size_t getMemoryUsage() { return 0; };
+
+    // releaseMemory() frees whatever can be recreated the next time the
+    // encoder is used, without confusing the client.
+    virtual void releaseMemory() {};
+
   protected:
     // Helper method for redirecting a single colour palette to the
     // short cut method.
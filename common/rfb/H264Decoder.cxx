@@ -24,6 +24,8 @@
 
 #define MAX_H264_INSTANCES 64
 
+#include <assert.h>
+
 #include <deque>
 
 #include <core/i18n.h>
@@ -42,7 +44,9 @@ enum rectFlags {
   resetAllContexts   = 0x2,
 };
 
-H264Decoder::H264Decoder() : Decoder(DecoderOrdered)
+H264Decoder::H264Decoder(int threads)
+  : Decoder(DecoderPartiallyOrdered), threadBudget(threads),
+    threadsUsed(0)
 {
 }
 
@@ -54,7 +58,7 @@ H264Decoder::~H264Decoder()
 void H264Decoder::resetContexts()
 {
   for (H264DecoderContext* context : contexts)
-    delete context;
+    deleteContext(context);
   contexts.clear();
 }
 
@@ -66,6 +70,33 @@ H264DecoderContext* H264Decoder::findContext(const core::Rect& r)
   return nullptr;
 }
 
+H264DecoderContext* H264Decoder::createContext(const core::Rect& r)
+{
+  H264DecoderContext* ctx;
+  int threads;
+
+  // The first context gets the whole budget, as that is the common
+  // case of a single video rect. Later ones get what is left, which is
+  // usually just the thread that decodes the rect.
+  threads = threadBudget - threadsUsed;
+  if (threads < 1)
+    threads = 1;
+
+  ctx = H264DecoderContext::createContext(r, threads);
+  if (!ctx)
+    throw std::runtime_error(_("Failed to create H.264 context"));
+
+  threadsUsed += ctx->getThreads();
+
+  return ctx;
+}
+
+void H264Decoder::deleteContext(H264DecoderContext* ctx)
+{
+  threadsUsed -= ctx->getThreads();
+  delete ctx;
+}
+
 bool H264Decoder::readRect(const core::Rect& /*r*/,
                            rdr::InStream* is,
                            const ServerParams& /*server*/,
@@ -93,6 +124,26 @@ bool H264Decoder::readRect(const core::Rect& /*r*/,
   return true;
 }
 
+bool H264Decoder::doRectsConflict(const core::Rect& /*rectA*/,
+                                  const uint8_t* bufferA,
+                                  size_t buflenA,
+                                  const core::Rect& /*rectB*/,
+                                  const uint8_t* bufferB,
+                                  size_t buflenB,
+                                  const ServerParams& /*server*/)
+{
+  assert(buflenA >= 8);
+  assert(buflenB >= 8);
+
+  // Rects using the same context always overlap, so they are already
+  // kept in order. Only a reset of everything has to be done on its
+  // own.
+  if ((bufferA[7] & resetAllContexts) || (bufferB[7] & resetAllContexts))
+    return true;
+
+  return false;
+}
+
 void H264Decoder::decodeRect(const core::Rect& r, const uint8_t* buffer,
                              size_t buflen,
                              const ServerParams& /*server*/,
@@ -102,6 +153,8 @@ void H264Decoder::decodeRect(const core::Rect& r, const uint8_t* buffer,
   uint32_t len = is.readU32();
   uint32_t reset = is.readU32();
 
+  std::unique_lock<std::mutex> lock(mutex);
+
   H264DecoderContext* ctx = nullptr;
   if (reset & resetAllContexts)
   {
@@ -115,7 +168,7 @@ void H264Decoder::decodeRect(const core::Rect& r, const uint8_t* buffer,
 
   if (ctx && (reset & resetContext)) {
     contexts.remove(ctx);
-    delete ctx;
+    deleteContext(ctx);
     ctx = nullptr;
   }
 
@@ -124,17 +177,31 @@ void H264Decoder::decodeRect(const core::Rect& r, const uint8_t* buffer,
     if (contexts.size() >= MAX_H264_INSTANCES)
     {
       H264DecoderContext* excess_ctx = contexts.front();
-      delete excess_ctx;
+      deleteContext(excess_ctx);
       contexts.pop_front();
     }
-    ctx = H264DecoderContext::createContext(r);
-    if (!ctx)
-      throw std::runtime_error(_("Failed to create H.264 context"));
-    contexts.push_back(ctx);
+    ctx = createContext(r);
+  } else {
+    contexts.remove(ctx);
   }
 
-  if (!len)
+  if (!len) {
+    contexts.push_back(ctx);
     return;
+  }
+
+  // Keep the context out of the list whilst decoding so that other
+  // threads can safely add and evict contexts for other rects
+  lock.unlock();
+
+  try {
+    ctx->decode(is.getptr(len), len, pb);
+  } catch (...) {
+    lock.lock();
+    contexts.push_back(ctx);
+    throw;
+  }
 
-  ctx->decode(is.getptr(len), len, pb);
+  lock.lock();
+  contexts.push_back(ctx);
 }
@@ -22,6 +22,7 @@
 #define __RFB_H264DECODER_H__
 
 #include <list>
+#include <mutex>
 
 #include <rfb/Decoder.h>
 
@@ -30,11 +31,18 @@ namespace rfb {
 
   class H264Decoder : public Decoder {
   public:
-    H264Decoder();
+    H264Decoder(int threads);
     virtual ~H264Decoder();
     bool readRect(const core::Rect& r, rdr::InStream* is,
                   const ServerParams& server,
                   rdr::OutStream* os) override;
+    bool doRectsConflict(const core::Rect& rectA,
+                         const uint8_t* bufferA,
+                         size_t buflenA,
+                         const core::Rect& rectB,
+                         const uint8_t* bufferB,
+                         size_t buflenB,
+                         const ServerParams& server) override;
     void decodeRect(const core::Rect& r, const uint8_t* buffer,
                     size_t buflen, const ServerParams& server,
                     ModifiablePixelBuffer* pb) override;
@@ -42,8 +50,17 @@ namespace rfb {
   private:
     void resetContexts();
     H264DecoderContext* findContext(const core::Rect& r);
+    H264DecoderContext* createContext(const core::Rect& r);
+    void deleteContext(H264DecoderContext* ctx);
 
+    // Contexts that are currently decoding are not in the list
+    std::mutex mutex;
     std::list<H264DecoderContext*> contexts;
+
+    // Slice threads are handed out to contexts from a shared budget,
+    // as each context otherwise starts one thread per core
+    const int threadBudget;
+    int threadsUsed;
   };
 }
 
@@ -33,12 +33,14 @@
 
 using namespace rfb;
 
-H264DecoderContext *H264DecoderContext::createContext(const core::Rect &r)
+H264DecoderContext *H264DecoderContext::createContext(const core::Rect &r,
+                                                      int threads)
 {
 #ifdef HAVE_LIBAV
-  return new H264LibavDecoderContext(r);
+  return new H264LibavDecoderContext(r, threads);
 #endif
 #ifdef WIN32
+  (void)threads;
   return new H264WinDecoderContext(r);
 #endif
 }
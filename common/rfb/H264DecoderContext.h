@@ -31,7 +31,10 @@ namespace rfb {
 
   class H264DecoderContext {
     public:
-      static H264DecoderContext* createContext(const core::Rect& r);
+      // threads is how many threads the context may use to decode a
+      // single frame
+      static H264DecoderContext* createContext(const core::Rect& r,
+                                               int threads);
 
       virtual ~H264DecoderContext() = 0;
 
@@ -40,11 +43,14 @@ namespace rfb {
                           ModifiablePixelBuffer* /*pb*/) {}
 
       inline bool isEqualRect(const core::Rect &r) const { return r == rect; }
+      int getThreads() const { return threads; }
 
     protected:
       core::Rect rect;
+      int threads;
 
-      H264DecoderContext(const core::Rect &r) : rect(r) {}
+      H264DecoderContext(const core::Rect &r, int threads_=1)
+        : rect(r), threads(threads_) {}
   };
 
 }
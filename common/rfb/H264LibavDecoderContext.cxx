@@ -43,8 +43,24 @@ extern "C" {
 
 using namespace rfb;
 
-H264LibavDecoderContext::H264LibavDecoderContext(const core::Rect& r)
-  : H264DecoderContext(r)
+// Frame buffer formats that swscale can write to directly
+static const struct {
+  PixelFormat pf;
+  AVPixelFormat format;
+} directFormats[] = {
+  { PixelFormat(32, 24, false, true, 255, 255, 255, 16, 8, 0), AV_PIX_FMT_BGR0 },
+  { PixelFormat(32, 24, false, true, 255, 255, 255, 0, 8, 16), AV_PIX_FMT_RGB0 },
+  { PixelFormat(32, 24, false, true, 255, 255, 255, 24, 16, 8), AV_PIX_FMT_0BGR },
+  { PixelFormat(32, 24, false, true, 255, 255, 255, 8, 16, 24), AV_PIX_FMT_0RGB },
+  { PixelFormat(16, 16, false, true, 31, 63, 31, 11, 5, 0), AV_PIX_FMT_RGB565LE },
+  { PixelFormat(16, 16, true, true, 31, 63, 31, 11, 5, 0), AV_PIX_FMT_RGB565BE },
+  { PixelFormat(16, 16, false, true, 31, 63, 31, 0, 5, 11), AV_PIX_FMT_BGR565LE },
+  { PixelFormat(16, 16, true, true, 31, 63, 31, 0, 5, 11), AV_PIX_FMT_BGR565BE },
+};
+
+H264LibavDecoderContext::H264LibavDecoderContext(const core::Rect& r,
+                                                 int threads_)
+  : H264DecoderContext(r, threads_)
 {
   sws = nullptr;
   h264WorkBuffer = nullptr;
@@ -73,6 +89,11 @@ H264LibavDecoderContext::H264LibavDecoderContext(const core::Rect& r)
     throw std::runtime_error(_("Could not allocate video frame"));
   }
 
+  // Frame threading would delay every frame we get, so only split the
+  // work over slices. Other rects are already decoded in parallel.
+  avctx->thread_type = FF_THREAD_SLICE;
+  avctx->thread_count = threads;
+
   if (avcodec_open2(avctx, codec, nullptr) < 0)
   {
     av_parser_close(parser);
@@ -188,8 +209,24 @@ void H264LibavDecoderContext::decode(const uint8_t* h264_in_buffer,
   if (!frame->height)
     return;
 
+  // Try to have swscale write directly in to the frame buffer, and
+  // otherwise use an intermediate frame that is converted afterwards
+  AVPixelFormat dstFormat = AV_PIX_FMT_NONE;
+  if ((frame->width == rect.width()) && (frame->height == rect.height())) {
+    for (const auto& entry : directFormats) {
+      if (entry.pf == pb->getPF()) {
+        dstFormat = entry.format;
+        break;
+      }
+    }
+  }
+
+  bool direct = dstFormat != AV_PIX_FMT_NONE;
+  if (!direct)
+    dstFormat = directFormats[0].format;
+
   sws = sws_getCachedContext(sws, frame->width, frame->height, avctx->pix_fmt,
-                             frame->width, frame->height, AV_PIX_FMT_RGB32,
+                             frame->width, frame->height, dstFormat,
                              SWS_POINT, nullptr, nullptr, nullptr);
 
   int inFull, outFull, brightness, contrast, saturation;
@@ -207,6 +244,22 @@ void H264LibavDecoderContext::decode(const uint8_t* h264_in_buffer,
   sws_setColorspaceDetails(sws, inTable, inFull, outTable, outFull, brightness,
       contrast, saturation);
 
+  if (direct) {
+    uint8_t* dstData[4] = {};
+    int dstLinesize[4] = {};
+    int stride;
+
+    dstData[0] = pb->getBufferRW(rect, &stride);
+    dstLinesize[0] = stride * pb->getPF().bpp/8;
+
+    sws_scale(sws, frame->data, frame->linesize, 0, frame->height,
+              dstData, dstLinesize);
+
+    pb->commitBufferRW(rect);
+
+    return;
+  }
+
   if (rgbFrame && (rgbFrame->width != frame->width || rgbFrame->height != frame->height)) {
     av_frame_free(&rgbFrame);
 
@@ -214,8 +267,7 @@ void H264LibavDecoderContext::decode(const uint8_t* h264_in_buffer,
 
   if (!rgbFrame) {
     rgbFrame = av_frame_alloc();
-    // TODO: Can we really assume that the pixel format will always be RGB32?
-    rgbFrame->format = AV_PIX_FMT_RGB32;
+    rgbFrame->format = dstFormat;
     rgbFrame->width = frame->width;
     rgbFrame->height = frame->height;
     av_frame_get_buffer(rgbFrame, 0);
@@ -224,5 +276,6 @@ void H264LibavDecoderContext::decode(const uint8_t* h264_in_buffer,
   sws_scale(sws, frame->data, frame->linesize, 0, frame->height, rgbFrame->data,
             rgbFrame->linesize);
 
-  pb->imageRect(rect, rgbFrame->data[0], rgbFrame->linesize[0] / 4);
+  pb->imageRect(directFormats[0].pf, rect, rgbFrame->data[0],
+                rgbFrame->linesize[0] / 4);
 }
@@ -62,6 +62,16 @@ int JPEGEncoder::getQualityLevel()
   return jc.getQualityLevel();
 }
 
+size_t JPEGEncoder::getMemoryUsage()
+{
+  return jc.capacity();
+}
+
+void JPEGEncoder::releaseMemory()
+{
+  jc.shrink();
+}
+
 void JPEGEncoder::writeRect(const PixelBuffer* pb,
                             const Palette& /*palette*/)
 {
@@ -39,6 +39,9 @@ namespace rfb {
 
     int getQualityLevel() override;
 
+    size_t getMemoryUsage() override;
+    void releaseMemory() override;
+
     void writeRect(const PixelBuffer* pb,
                    const Palette& palette) override;
     void writeSolidRect(int width, int height, const PixelFormat& pf,
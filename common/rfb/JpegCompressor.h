@@ -43,7 +43,7 @@ namespace rfb {
 
   public:
 
-    JpegCompressor(int bufferLen = 128*1024);
+    JpegCompressor(int bufferLen = 1024);
     virtual ~JpegCompressor();
 
     void setQualityLevel(int level);
@@ -31,6 +31,9 @@
 #include <rfb/PixelFormat.h>
 
 #include <stdio.h>
+
+#include <algorithm>
+
 extern "C" {
 #include <jpeglib.h>
 }
@@ -162,6 +165,7 @@ void JpegDecompressor::decompress(const uint8_t *jpegBuf,
   int h = r.height();
   int pixelsize;
   int dstBufStride;
+  int stripHeight;
   uint8_t * volatile dstBuf = nullptr;
   volatile bool dstBufIsTemp = false;
   JSAMPROW * volatile rowPointer = nullptr;
@@ -202,14 +206,18 @@ void JpegDecompressor::decompress(const uint8_t *jpegBuf,
   }
 #endif
 
+  // Otherwise decode a strip at a time and convert it whilst it is
+  // still in the cache
+  stripHeight = h;
   if (dinfo->out_color_space == JCS_RGB) {
-    dstBuf = new uint8_t[w * h * pixelsize];
+    stripHeight = std::min(h, 16);
+    dstBuf = new uint8_t[w * stripHeight * pixelsize];
     dstBufIsTemp = true;
     dstBufStride = w;
   }
 
-  rowPointer = new JSAMPROW[h];
-  for (int dy = 0; dy < h; dy++)
+  rowPointer = new JSAMPROW[stripHeight];
+  for (int dy = 0; dy < stripHeight; dy++)
     rowPointer[dy] = (JSAMPROW)(&dstBuf[dy * dstBufStride * pixelsize]);
 
   jpeg_start_decompress(dinfo);
@@ -224,13 +232,19 @@ void JpegDecompressor::decompress(const uint8_t *jpegBuf,
   }
 
   while (dinfo->output_scanline < dinfo->output_height) {
-    jpeg_read_scanlines(dinfo, &rowPointer[dinfo->output_scanline],
-			dinfo->output_height - dinfo->output_scanline);
+    if (dstBufIsTemp) {
+      int y, rows;
+
+      y = dinfo->output_scanline;
+      rows = jpeg_read_scanlines(dinfo, rowPointer, stripHeight);
+      pf.bufferFromRGB(&buf[y * stride * pf.bpp/8], dstBuf,
+                       w, stride, rows);
+    } else {
+      jpeg_read_scanlines(dinfo, &rowPointer[dinfo->output_scanline],
+                          dinfo->output_height - dinfo->output_scanline);
+    }
   }
 
-  if (dinfo->out_color_space == JCS_RGB)
-    pf.bufferFromRGB((uint8_t*)buf, dstBuf, w, stride, h);
-
   jpeg_finish_decompress(dinfo);
 
   if (dstBufIsTemp) delete [] dstBuf;
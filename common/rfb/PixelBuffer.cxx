@@ -442,3 +442,12 @@ void ManagedPixelBuffer::setSize(int w, int h)
 
   setBuffer(w, h, data_, w);
 }
+
+void ManagedPixelBuffer::releaseBuffer()
+{
+  setBuffer(0, 0, nullptr, 0);
+
+  delete [] data_;
+  data_ = nullptr;
+  datasize = 0;
+}
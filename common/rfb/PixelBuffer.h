@@ -187,6 +187,10 @@ namespace rfb {
     virtual void setPF(const PixelFormat &pf);
     void setSize(int w, int h) override;
 
+    // Frees the pixel data, leaving an empty buffer behind
+    void releaseBuffer();
+    size_t getBufferSize() const { return datasize; }
+
   private:
     uint8_t* data_; // Mirrors FullFramePixelBuffer::data
     unsigned long datasize;
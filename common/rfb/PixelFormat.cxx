@@ -34,6 +34,7 @@
 
 #include <rfb/Exception.h>
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 #ifdef _WIN32
 #define strcasecmp _stricmp
@@ -80,6 +81,8 @@ PixelFormat::Init::Init()
     for (i = 0;i <= 255;i++)
       subDownTable[i] = (i * maxVal + 128) / 255;
   }
+
+  simd::init();
 }
 
 
@@ -252,37 +255,35 @@ void PixelFormat::bufferFromRGB(uint8_t *dst, const uint8_t* src,
 {
   if (is888()) {
     // Optimised common case
-    uint8_t *r, *g, *b, *x;
+    uint8_t layout[4];
+    int i;
 
-    if (bigEndian) {
-      r = dst + (24 - redShift)/8;
-      g = dst + (24 - greenShift)/8;
-      b = dst + (24 - blueShift)/8;
-      x = dst + (24 - (48 - redShift - greenShift - blueShift))/8;
-    } else {
-      r = dst + redShift/8;
-      g = dst + greenShift/8;
-      b = dst + blueShift/8;
-      x = dst + (48 - redShift - greenShift - blueShift)/8;
-    }
+    byteLayout(layout);
 
-    int dstPad = (stride - w) * 4;
     while (h--) {
-      int w_ = w;
-      while (w_--) {
-        *r = *(src++);
-        *g = *(src++);
-        *b = *(src++);
+      uint8_t *r, *g, *b, *x;
+      const uint8_t *s;
+
+      i = simd::rgbTo888(dst, src, layout, w);
+
+      r = dst + i*4 + layout[0];
+      g = dst + i*4 + layout[1];
+      b = dst + i*4 + layout[2];
+      x = dst + i*4 + layout[3];
+      s = src + i*3;
+      for (;i < w;i++) {
+        *r = *(s++);
+        *g = *(s++);
+        *b = *(s++);
         *x = 0;
         r += 4;
         g += 4;
         b += 4;
         x += 4;
       }
-      r += dstPad;
-      g += dstPad;
-      b += dstPad;
-      x += dstPad;
+
+      dst += stride * 4;
+      src += w * 3;
     }
   } else {
     // Generic code
@@ -319,32 +320,32 @@ void PixelFormat::rgbFromBuffer(uint8_t* dst, const uint8_t* src,
 {
   if (is888()) {
     // Optimised common case
-    const uint8_t *r, *g, *b;
+    uint8_t layout[4];
+    int i;
 
-    if (bigEndian) {
-      r = src + (24 - redShift)/8;
-      g = src + (24 - greenShift)/8;
-      b = src + (24 - blueShift)/8;
-    } else {
-      r = src + redShift/8;
-      g = src + greenShift/8;
-      b = src + blueShift/8;
-    }
+    byteLayout(layout);
 
-    int srcPad = (stride - w) * 4;
     while (h--) {
-      int w_ = w;
-      while (w_--) {
-        *(dst++) = *r;
-        *(dst++) = *g;
-        *(dst++) = *b;
+      const uint8_t *r, *g, *b;
+      uint8_t *d;
+
+      i = simd::rgbFrom888(dst, src, layout, w);
+
+      r = src + i*4 + layout[0];
+      g = src + i*4 + layout[1];
+      b = src + i*4 + layout[2];
+      d = dst + i*3;
+      for (;i < w;i++) {
+        *(d++) = *r;
+        *(d++) = *g;
+        *(d++) = *b;
         r += 4;
         g += 4;
         b += 4;
       }
-      r += srcPad;
-      g += srcPad;
-      b += srcPad;
+
+      dst += w * 3;
+      src += stride * 4;
     }
   } else {
     // Generic code
@@ -399,52 +400,39 @@ void PixelFormat::bufferFromBuffer(uint8_t* dst, const PixelFormat &srcPF,
     }
   } else if (is888() && srcPF.is888()) {
     // Optimised common case A: byte shuffling (e.g. endian conversion)
-    uint8_t *d[4], *s[4];
-    int dstPad, srcPad;
-
-    if (bigEndian) {
-      s[0] = dst + (24 - redShift)/8;
-      s[1] = dst + (24 - greenShift)/8;
-      s[2] = dst + (24 - blueShift)/8;
-      s[3] = dst + (24 - (48 - redShift - greenShift - blueShift))/8;
-    } else {
-      s[0] = dst + redShift/8;
-      s[1] = dst + greenShift/8;
-      s[2] = dst + blueShift/8;
-      s[3] = dst + (48 - redShift - greenShift - blueShift)/8;
-    }
+    uint8_t dstLayout[4], srcLayout[4], map[4];
+    int i;
 
-    if (srcPF.bigEndian) {
-      d[(24 - srcPF.redShift)/8] = s[0];
-      d[(24 - srcPF.greenShift)/8] = s[1];
-      d[(24 - srcPF.blueShift)/8] = s[2];
-      d[(24 - (48 - srcPF.redShift - srcPF.greenShift - srcPF.blueShift))/8] = s[3];
-    } else {
-      d[srcPF.redShift/8] = s[0];
-      d[srcPF.greenShift/8] = s[1];
-      d[srcPF.blueShift/8] = s[2];
-      d[(48 - srcPF.redShift - srcPF.greenShift - srcPF.blueShift)/8] = s[3];
-    }
+    byteLayout(dstLayout);
+    srcPF.byteLayout(srcLayout);
+
+    for (i = 0;i < 4;i++)
+      map[dstLayout[i]] = srcLayout[i];
 
-    dstPad = (dstStride - w) * 4;
-    srcPad = (srcStride - w) * 4;
     while (h--) {
-      int w_ = w;
-      while (w_--) {
-        *d[0] = *(src++);
-        *d[1] = *(src++);
-        *d[2] = *(src++);
-        *d[3] = *(src++);
-        d[0] += 4;
-        d[1] += 4;
-        d[2] += 4;
-        d[3] += 4;
+      const uint8_t *s[4];
+      uint8_t *d;
+
+      i = simd::shuffle888(dst, src, map, w);
+
+      s[0] = src + i*4 + map[0];
+      s[1] = src + i*4 + map[1];
+      s[2] = src + i*4 + map[2];
+      s[3] = src + i*4 + map[3];
+      d = dst + i*4;
+      for (;i < w;i++) {
+        *(d++) = *s[0];
+        *(d++) = *s[1];
+        *(d++) = *s[2];
+        *(d++) = *s[3];
+        s[0] += 4;
+        s[1] += 4;
+        s[2] += 4;
+        s[3] += 4;
       }
-      d[0] += dstPad;
-      d[1] += dstPad;
-      d[2] += dstPad;
-      d[3] += dstPad;
-      src += srcPad;
+
+      dst += dstStride * 4;
+      src += srcStride * 4;
     }
   } else if (IS_ALIGNED(dst, bpp/8) && srcPF.is888()) {
     // Optimised common case B: 888 source
@@ -503,6 +491,26 @@ void PixelFormat::bufferFromBuffer(uint8_t* dst, const PixelFormat &srcPF,
 }
 
 
+void PixelFormat::byteLayout(uint8_t bytes[4]) const
+{
+  int paddingShift;
+
+  paddingShift = 48 - redShift - greenShift - blueShift;
+
+  if (bigEndian) {
+    bytes[0] = (24 - redShift)/8;
+    bytes[1] = (24 - greenShift)/8;
+    bytes[2] = (24 - blueShift)/8;
+    bytes[3] = (24 - paddingShift)/8;
+  } else {
+    bytes[0] = redShift/8;
+    bytes[1] = greenShift/8;
+    bytes[2] = blueShift/8;
+    bytes[3] = paddingShift/8;
+  }
+}
+
+
 void PixelFormat::print(char* str, int len) const
 {
   // Unfortunately snprintf is not widely available so we build the string up
@@ -742,8 +750,9 @@ void PixelFormat::directBufferFromBufferFrom888(T* dst,
                                                 int dstStride,
                                                 int srcStride) const
 {
-  const uint8_t *r, *g, *b;
-  int dstPad, srcPad;
+  uint8_t srcLayout[4];
+  simd::Layout16 dstLayout;
+  bool accelerated;
 
   const uint8_t *redDownTable, *greenDownTable, *blueDownTable;
 
@@ -751,21 +760,25 @@ void PixelFormat::directBufferFromBufferFrom888(T* dst,
   greenDownTable = &downconvTable[(greenBits-1)*256];
   blueDownTable = &downconvTable[(blueBits-1)*256];
 
-  if (srcPF.bigEndian) {
-    r = src + (24 - srcPF.redShift)/8;
-    g = src + (24 - srcPF.greenShift)/8;
-    b = src + (24 - srcPF.blueShift)/8;
-  } else {
-    r = src + srcPF.redShift/8;
-    g = src + srcPF.greenShift/8;
-    b = src + srcPF.blueShift/8;
-  }
+  srcPF.byteLayout(srcLayout);
+
+  // The vectorised code only deals with native 16 bpp formats
+  accelerated = (sizeof(T) == 2) && !endianMismatch;
+  dstLayout = { {redShift, greenShift, blueShift},
+                {redBits, greenBits, blueBits} };
 
-  dstPad = (dstStride - w);
-  srcPad = (srcStride - w) * 4;
   while (h--) {
-    int w_ = w;
-    while (w_--) {
+    const uint8_t *r, *g, *b;
+    int i;
+
+    i = 0;
+    if (accelerated)
+      i = simd::from888To16((uint16_t*)dst, src, srcLayout, dstLayout, w);
+
+    r = src + i*4 + srcLayout[0];
+    g = src + i*4 + srcLayout[1];
+    b = src + i*4 + srcLayout[2];
+    for (;i < w;i++) {
       T d;
 
       d = redDownTable[*r] << redShift;
@@ -775,17 +788,15 @@ void PixelFormat::directBufferFromBufferFrom888(T* dst,
       if (endianMismatch)
         d = swap(d);
 
-      *dst = d;
+      dst[i] = d;
 
-      dst++;
       r += 4;
       g += 4;
       b += 4;
     }
-    dst += dstPad;
-    r += srcPad;
-    g += srcPad;
-    b += srcPad;
+
+    dst += dstStride;
+    src += srcStride * 4;
   }
 }
 
@@ -797,8 +808,9 @@ void PixelFormat::directBufferFromBufferTo888(uint8_t* dst,
                                               int dstStride,
                                               int srcStride) const
 {
-  uint8_t *r, *g, *b, *x;
-  int dstPad, srcPad;
+  uint8_t dstLayout[4];
+  simd::Layout16 srcLayout;
+  bool accelerated;
 
   const uint8_t *redUpTable, *greenUpTable, *blueUpTable;
 
@@ -806,26 +818,30 @@ void PixelFormat::directBufferFromBufferTo888(uint8_t* dst,
   greenUpTable = &upconvTable[(srcPF.greenBits-1)*256];
   blueUpTable = &upconvTable[(srcPF.blueBits-1)*256];
 
-  if (bigEndian) {
-    r = dst + (24 - redShift)/8;
-    g = dst + (24 - greenShift)/8;
-    b = dst + (24 - blueShift)/8;
-    x = dst + (24 - (48 - redShift - greenShift - blueShift))/8;
-  } else {
-    r = dst + redShift/8;
-    g = dst + greenShift/8;
-    b = dst + blueShift/8;
-    x = dst + (48 - redShift - greenShift - blueShift)/8;
-  }
+  byteLayout(dstLayout);
+
+  // The vectorised code only deals with native 16 bpp formats
+  accelerated = (sizeof(T) == 2) && !srcPF.endianMismatch;
+  srcLayout = { {srcPF.redShift, srcPF.greenShift, srcPF.blueShift},
+                {srcPF.redBits, srcPF.greenBits, srcPF.blueBits} };
 
-  dstPad = (dstStride - w) * 4;
-  srcPad = (srcStride - w);
   while (h--) {
-    int w_ = w;
-    while (w_--) {
+    uint8_t *r, *g, *b, *x;
+    int i;
+
+    i = 0;
+    if (accelerated)
+      i = simd::to888From16(dst, (const uint16_t*)src,
+                            dstLayout, srcLayout, w);
+
+    r = dst + i*4 + dstLayout[0];
+    g = dst + i*4 + dstLayout[1];
+    b = dst + i*4 + dstLayout[2];
+    x = dst + i*4 + dstLayout[3];
+    for (;i < w;i++) {
       T s;
 
-      s = *src;
+      s = src[i];
 
       if (srcPF.endianMismatch)
         s = swap(s);
@@ -839,12 +855,9 @@ void PixelFormat::directBufferFromBufferTo888(uint8_t* dst,
       g += 4;
       b += 4;
       x += 4;
-      src++;
     }
-    r += dstPad;
-    g += dstPad;
-    b += dstPad;
-    x += dstPad;
-    src += srcPad;
+
+    dst += dstStride * 4;
+    src += srcStride;
   }
 }
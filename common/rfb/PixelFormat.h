@@ -61,6 +61,10 @@ namespace rfb {
     bool isBigEndian(void) const;
     bool isLittleEndian(void) const;
 
+    // byteLayout() gives the byte positions of red, green, blue and
+    // padding in a 888 format
+    void byteLayout(uint8_t bytes[4]) const;
+
     inline Pixel pixelFromBuffer(const uint8_t* buffer) const;
     inline void bufferFromPixel(uint8_t* buffer, Pixel pixel) const;
 
@@ -0,0 +1,681 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <rfb/PixelFormatSIMD.h>
+
+// The x86 kernels are built for their specific instruction set using
+// function attributes, so that the rest of the code can still run on
+// any CPU
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_SIMD_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace rfb;
+
+static int noShuffle888(uint8_t*, const uint8_t*, const uint8_t[4], int)
+{
+  return 0;
+}
+
+static int noRGB888(uint8_t*, const uint8_t*, const simd::Layout888&, int)
+{
+  return 0;
+}
+
+static int noFrom888To16(uint16_t*, const uint8_t*,
+                         const simd::Layout888&, const simd::Layout16&,
+                         int)
+{
+  return 0;
+}
+
+static int noTo888From16(uint8_t*, const uint16_t*,
+                         const simd::Layout888&, const simd::Layout16&,
+                         int)
+{
+  return 0;
+}
+
+static int noBlend888(uint8_t*, const uint8_t*, const simd::Layout888&,
+                      int)
+{
+  return 0;
+}
+
+static int noGradientRGB(uint8_t*, const uint8_t*, const uint8_t*, int,
+                         int)
+{
+  return 0;
+}
+
+int (*simd::shuffle888)(uint8_t*, const uint8_t*,
+                        const uint8_t[4], int) = noShuffle888;
+int (*simd::rgbFrom888)(uint8_t*, const uint8_t*,
+                        const Layout888&, int) = noRGB888;
+int (*simd::rgbTo888)(uint8_t*, const uint8_t*,
+                      const Layout888&, int) = noRGB888;
+int (*simd::from888To16)(uint16_t*, const uint8_t*,
+                         const Layout888&, const Layout16&,
+                         int) = noFrom888To16;
+int (*simd::to888From16)(uint8_t*, const uint16_t*,
+                         const Layout888&, const Layout16&,
+                         int) = noTo888From16;
+int (*simd::blend888)(uint8_t*, const uint8_t*,
+                      const Layout888&, int) = noBlend888;
+int (*simd::gradientRGB)(uint8_t*, const uint8_t*, const uint8_t*,
+                         int, int) = noGradientRGB;
+
+static const char* kernelName = "none";
+
+#ifdef HAVE_SIMD_X86
+
+// Scaling up a channel is i * 255 / max, which we do as a multiply
+// with a reciprocal and a shift. There is no exact reciprocal for
+// every size, in which case the magic is zero.
+static uint16_t upconvMagic[8];
+static int upconvShift[8];
+
+static void initUpconvMagic()
+{
+  for (int bits = 1;bits <= 8;bits++) {
+    int maxVal;
+
+    maxVal = (1 << bits) - 1;
+
+    upconvMagic[bits-1] = 0;
+    for (int shift = 0;shift < 8;shift++) {
+      uint32_t magic;
+      bool exact;
+
+      magic = ((1 << (16 + shift)) + maxVal - 1) / maxVal;
+      if (magic > 0xffff)
+        continue;
+
+      exact = true;
+      for (int i = 0;i <= maxVal;i++) {
+        if (((i * 255 * magic) >> (16 + shift)) !=
+            (uint32_t)(i * 255 / maxVal)) {
+          exact = false;
+          break;
+        }
+      }
+
+      if (exact) {
+        upconvMagic[bits-1] = magic;
+        upconvShift[bits-1] = shift;
+        break;
+      }
+    }
+  }
+}
+
+__attribute__((target("sse2")))
+static int from888To16SSE2(uint16_t* dst, const uint8_t* src,
+                           const simd::Layout888& srcLayout,
+                           const simd::Layout16& dstLayout, int pixels)
+{
+  __m128i byteMask, bias, one;
+  __m128i maxVal[3], srcShift[3], dstShift[3];
+  int i;
+
+  byteMask = _mm_set1_epi32(0xff);
+  bias = _mm_set1_epi16(128);
+  one = _mm_set1_epi16(1);
+
+  for (int c = 0;c < 3;c++) {
+    maxVal[c] = _mm_set1_epi16((1 << dstLayout.bits[c]) - 1);
+    srcShift[c] = _mm_cvtsi32_si128(srcLayout[c] * 8);
+    dstShift[c] = _mm_cvtsi32_si128(dstLayout.shift[c]);
+  }
+
+  for (i = 0;i + 8 <= pixels;i += 8) {
+    __m128i lo, hi, out;
+
+    lo = _mm_loadu_si128((const __m128i*)(src + i * 4));
+    hi = _mm_loadu_si128((const __m128i*)(src + i * 4 + 16));
+
+    out = _mm_setzero_si128();
+    for (int c = 0;c < 3;c++) {
+      __m128i v;
+
+      v = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(lo, srcShift[c]),
+                                        byteMask),
+                          _mm_and_si128(_mm_srl_epi32(hi, srcShift[c]),
+                                        byteMask));
+
+      // (v * max + 128) / 255, but without the division
+      v = _mm_add_epi16(_mm_mullo_epi16(v, maxVal[c]), bias);
+      v = _mm_add_epi16(_mm_add_epi16(v, one), _mm_srli_epi16(v, 8));
+      v = _mm_srli_epi16(v, 8);
+
+      out = _mm_or_si128(out, _mm_sll_epi16(v, dstShift[c]));
+    }
+
+    _mm_storeu_si128((__m128i*)(dst + i), out);
+  }
+
+  return i;
+}
+
+__attribute__((target("sse2")))
+static int to888From16SSE2(uint8_t* dst, const uint16_t* src,
+                           const simd::Layout888& dstLayout,
+                           const simd::Layout16& srcLayout, int pixels)
+{
+  __m128i zero, k255;
+  __m128i maxVal[3], srcShift[3], magic[3], magicShift[3], dstShift[3];
+  int i;
+
+  for (int c = 0;c < 3;c++) {
+    if (upconvMagic[srcLayout.bits[c]-1] == 0)
+      return 0;
+  }
+
+  zero = _mm_setzero_si128();
+  k255 = _mm_set1_epi16(255);
+
+  for (int c = 0;c < 3;c++) {
+    maxVal[c] = _mm_set1_epi16((1 << srcLayout.bits[c]) - 1);
+    srcShift[c] = _mm_cvtsi32_si128(srcLayout.shift[c]);
+    magic[c] = _mm_set1_epi16(upconvMagic[srcLayout.bits[c]-1]);
+    magicShift[c] = _mm_cvtsi32_si128(upconvShift[srcLayout.bits[c]-1]);
+    dstShift[c] = _mm_cvtsi32_si128(dstLayout[c] * 8);
+  }
+
+  for (i = 0;i + 8 <= pixels;i += 8) {
+    __m128i in, lo, hi;
+
+    in = _mm_loadu_si128((const __m128i*)(src + i));
+
+    lo = hi = zero;
+    for (int c = 0;c < 3;c++) {
+      __m128i v;
+
+      v = _mm_and_si128(_mm_srl_epi16(in, srcShift[c]), maxVal[c]);
+
+      v = _mm_mullo_epi16(v, k255);
+      v = _mm_srl_epi16(_mm_mulhi_epu16(v, magic[c]), magicShift[c]);
+
+      lo = _mm_or_si128(lo, _mm_sll_epi32(_mm_unpacklo_epi16(v, zero),
+                                          dstShift[c]));
+      hi = _mm_or_si128(hi, _mm_sll_epi32(_mm_unpackhi_epi16(v, zero),
+                                          dstShift[c]));
+    }
+
+    _mm_storeu_si128((__m128i*)(dst + i * 4), lo);
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 16), hi);
+  }
+
+  return i;
+}
+
+__attribute__((target("sse2")))
+static int blend888SSE2(uint8_t* dst, const uint8_t* src,
+                        const simd::Layout888& layout, int pixels)
+{
+  __m128i zero, one, byteMask, padMask, alphaShift;
+  int i;
+
+  zero = _mm_setzero_si128();
+  one = _mm_set1_epi16(1);
+  byteMask = _mm_set1_epi32(0xff);
+  padMask = _mm_set1_epi32((int)(0xffu << (layout[3] * 8)));
+  alphaShift = _mm_cvtsi32_si128(layout[3] * 8);
+
+  for (i = 0;i + 4 <= pixels;i += 4) {
+    __m128i s, d, ia, lo, hi, out;
+
+    s = _mm_loadu_si128((const __m128i*)(src + i * 4));
+    d = _mm_loadu_si128((const __m128i*)(dst + i * 4));
+
+    // 255 - alpha, in every 16 bit lane of its pixel
+    ia = _mm_and_si128(_mm_srl_epi32(s, alphaShift), byteMask);
+    ia = _mm_sub_epi32(byteMask, ia);
+    ia = _mm_or_si128(ia, _mm_slli_epi32(ia, 16));
+
+    lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+                         _mm_unpacklo_epi32(ia, ia));
+    hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+                         _mm_unpackhi_epi32(ia, ia));
+
+    // v / 255, rounded down like the scalar code
+    lo = _mm_add_epi16(_mm_add_epi16(lo, one), _mm_srli_epi16(lo, 8));
+    hi = _mm_add_epi16(_mm_add_epi16(hi, one), _mm_srli_epi16(hi, 8));
+    lo = _mm_srli_epi16(lo, 8);
+    hi = _mm_srli_epi16(hi, 8);
+
+    out = _mm_add_epi8(_mm_packus_epi16(lo, hi), s);
+    out = _mm_or_si128(_mm_andnot_si128(padMask, out),
+                       _mm_and_si128(padMask, d));
+
+    _mm_storeu_si128((__m128i*)(dst + i * 4), out);
+  }
+
+  return i;
+}
+
+// The gradient filter predicts each pixel from the ones to the left,
+// above and above left of it, so a row cannot be done in parallel.
+// Four rows can though, if each row lags one pixel behind the one
+// above it. Every step then works on a diagonal of four pixels, one
+// per lane, and the pixel above is what the lane before it produced
+// in the previous step.
+
+__attribute__((target("sse2")))
+static inline __m128i gradientStepSSE2(__m128i left, __m128i up,
+                                       __m128i upleft, __m128i diff)
+{
+  __m128i est;
+
+  // left + up - upleft, clamped to 0-255
+  est = _mm_adds_epu8(left, _mm_subs_epu8(up, upleft));
+  est = _mm_subs_epu8(est, _mm_subs_epu8(upleft, up));
+
+  return _mm_add_epi8(est, diff);
+}
+
+// The steps at the start and end of a block, where some of the lanes
+// are outside of the rect. Those have to stay zero, as they are the
+// left and upper edges for the other lanes, and must not be stored.
+__attribute__((target("sse2")))
+static inline __m128i gradientEdgeSSE2(uint8_t* dst, const uint8_t* src,
+                                       const uint8_t* prev,
+                                       size_t rowSize, int width, int t,
+                                       __m128i left, __m128i* upleft)
+{
+  __m128i up, diff;
+  uint32_t d[4], out[4], p;
+
+  p = 0;
+  if (t < width)
+    memcpy(&p, prev + t * 3, 3);
+  for (int k = 0;k < 4;k++) {
+    d[k] = 0;
+    if ((t - k >= 0) && (t - k < width))
+      memcpy(&d[k], src + k * rowSize + (t - k) * 3, 3);
+  }
+
+  up = _mm_or_si128(_mm_slli_si128(left, 4), _mm_cvtsi32_si128(p));
+  diff = _mm_set_epi32(d[3], d[2], d[1], d[0]);
+  left = gradientStepSSE2(left, up, *upleft, diff);
+  *upleft = up;
+
+  _mm_storeu_si128((__m128i*)out, left);
+  for (int k = 0;k < 4;k++) {
+    if ((t - k >= 0) && (t - k < width))
+      memcpy(dst + k * rowSize + (t - k) * 3, &out[k], 3);
+  }
+
+  return left;
+}
+
+__attribute__((target("sse2")))
+static int gradientRGBSSE2(uint8_t* dst, const uint8_t* src,
+                           const uint8_t* prev, int width, int rows)
+{
+  size_t rowSize;
+  int y;
+
+  rowSize = width * 3;
+
+  for (y = 0;y + 4 <= rows;y += 4) {
+    __m128i left, up, upleft, diff;
+    uint8_t* out[4];
+    const uint8_t* in[4];
+    int t;
+
+    // Pixel t of the diagonal is at t - k in row k
+    for (int k = 0;k < 4;k++) {
+      in[k] = src + k * rowSize - k * 3;
+      out[k] = dst + k * rowSize - k * 3;
+    }
+
+    left = _mm_setzero_si128();
+    upleft = _mm_setzero_si128();
+
+    for (t = 0;t < std::min(3, width - 1);t++)
+      left = gradientEdgeSSE2(dst, src, prev, rowSize, width, t,
+                              left, &upleft);
+
+    // Every lane is inside the rect, and every row has at least one
+    // more pixel after this one, so whole words can be loaded and
+    // stored. The extra byte stored is overwritten in the next step.
+    for (;t < width - 1;t++) {
+      int32_t d0, d1, d2, d3, p;
+
+      memcpy(&p, prev + t * 3, 4);
+      memcpy(&d0, in[0] + t * 3, 4);
+      memcpy(&d1, in[1] + t * 3, 4);
+      memcpy(&d2, in[2] + t * 3, 4);
+      memcpy(&d3, in[3] + t * 3, 4);
+
+      up = _mm_or_si128(_mm_slli_si128(left, 4), _mm_cvtsi32_si128(p));
+      diff = _mm_set_epi32(d3, d2, d1, d0);
+      left = gradientStepSSE2(left, up, upleft, diff);
+      upleft = up;
+
+      d0 = _mm_cvtsi128_si32(left);
+      d1 = _mm_cvtsi128_si32(_mm_srli_si128(left, 4));
+      d2 = _mm_cvtsi128_si32(_mm_srli_si128(left, 8));
+      d3 = _mm_cvtsi128_si32(_mm_srli_si128(left, 12));
+      memcpy(out[0] + t * 3, &d0, 4);
+      memcpy(out[1] + t * 3, &d1, 4);
+      memcpy(out[2] + t * 3, &d2, 4);
+      memcpy(out[3] + t * 3, &d3, 4);
+    }
+
+    for (;t < width + 3;t++)
+      left = gradientEdgeSSE2(dst, src, prev, rowSize, width, t,
+                              left, &upleft);
+
+    prev = dst + 3 * rowSize;
+    src += 4 * rowSize;
+    dst += 4 * rowSize;
+  }
+
+  return y;
+}
+
+__attribute__((target("ssse3")))
+static int shuffle888SSSE3(uint8_t* dst, const uint8_t* src,
+                           const uint8_t map[4], int pixels)
+{
+  uint8_t pattern[16];
+  __m128i mask;
+  int i;
+
+  for (i = 0;i < 16;i++)
+    pattern[i] = (i & ~3) + map[i & 3];
+  mask = _mm_loadu_si128((const __m128i*)pattern);
+
+  for (i = 0;i + 4 <= pixels;i += 4) {
+    __m128i v;
+    v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+    v = _mm_shuffle_epi8(v, mask);
+    _mm_storeu_si128((__m128i*)(dst + i * 4), v);
+  }
+
+  return i;
+}
+
+__attribute__((target("ssse3")))
+static int rgbFrom888SSSE3(uint8_t* dst, const uint8_t* src,
+                           const simd::Layout888& layout, int pixels)
+{
+  uint8_t pattern[16];
+  __m128i mask;
+  int i;
+
+  // Four pixels become 12 bytes of RGB, with the top bytes cleared
+  for (i = 0;i < 12;i++)
+    pattern[i] = (i / 3) * 4 + layout[i % 3];
+  for (;i < 16;i++)
+    pattern[i] = 0x80;
+  mask = _mm_loadu_si128((const __m128i*)pattern);
+
+  for (i = 0;i + 16 <= pixels;i += 16) {
+    __m128i a, b, c, d;
+
+    a = _mm_loadu_si128((const __m128i*)(src + i * 4));
+    b = _mm_loadu_si128((const __m128i*)(src + i * 4 + 16));
+    c = _mm_loadu_si128((const __m128i*)(src + i * 4 + 32));
+    d = _mm_loadu_si128((const __m128i*)(src + i * 4 + 48));
+
+    a = _mm_shuffle_epi8(a, mask);
+    b = _mm_shuffle_epi8(b, mask);
+    c = _mm_shuffle_epi8(c, mask);
+    d = _mm_shuffle_epi8(d, mask);
+
+    // Pack the four 12 byte groups in to three full vectors
+    a = _mm_or_si128(a, _mm_slli_si128(b, 12));
+    b = _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8));
+    c = _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4));
+
+    _mm_storeu_si128((__m128i*)(dst + i * 3), a);
+    _mm_storeu_si128((__m128i*)(dst + i * 3 + 16), b);
+    _mm_storeu_si128((__m128i*)(dst + i * 3 + 32), c);
+  }
+
+  return i;
+}
+
+__attribute__((target("ssse3")))
+static int rgbTo888SSSE3(uint8_t* dst, const uint8_t* src,
+                         const simd::Layout888& layout, int pixels)
+{
+  uint8_t pattern[16];
+  __m128i mask;
+  int i;
+
+  // 12 bytes of RGB become four pixels, with the padding cleared
+  for (i = 0;i < 4;i++) {
+    pattern[i * 4 + layout[0]] = i * 3 + 0;
+    pattern[i * 4 + layout[1]] = i * 3 + 1;
+    pattern[i * 4 + layout[2]] = i * 3 + 2;
+    pattern[i * 4 + layout[3]] = 0x80;
+  }
+  mask = _mm_loadu_si128((const __m128i*)pattern);
+
+  for (i = 0;i + 16 <= pixels;i += 16) {
+    __m128i in0, in1, in2;
+    __m128i a, b, c, d;
+
+    in0 = _mm_loadu_si128((const __m128i*)(src + i * 3));
+    in1 = _mm_loadu_si128((const __m128i*)(src + i * 3 + 16));
+    in2 = _mm_loadu_si128((const __m128i*)(src + i * 3 + 32));
+
+    // Split the three vectors in to four 12 byte groups
+    a = in0;
+    b = _mm_alignr_epi8(in1, in0, 12);
+    c = _mm_alignr_epi8(in2, in1, 8);
+    d = _mm_srli_si128(in2, 4);
+
+    _mm_storeu_si128((__m128i*)(dst + i * 4),
+                     _mm_shuffle_epi8(a, mask));
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 16),
+                     _mm_shuffle_epi8(b, mask));
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 32),
+                     _mm_shuffle_epi8(c, mask));
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 48),
+                     _mm_shuffle_epi8(d, mask));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2")))
+static int shuffle888AVX2(uint8_t* dst, const uint8_t* src,
+                          const uint8_t map[4], int pixels)
+{
+  uint8_t pattern[16];
+  __m256i mask;
+  int i;
+
+  // The shuffle works within each 128 bit lane, which is fine as
+  // pixels never cross those
+  for (i = 0;i < 16;i++)
+    pattern[i] = (i & ~3) + map[i & 3];
+  mask = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128((const __m128i*)pattern));
+
+  for (i = 0;i + 8 <= pixels;i += 8) {
+    __m256i v;
+    v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+    v = _mm256_shuffle_epi8(v, mask);
+    _mm256_storeu_si256((__m256i*)(dst + i * 4), v);
+  }
+
+  return i;
+}
+
+#endif // HAVE_SIMD_X86
+
+#ifdef HAVE_SIMD_NEON
+
+static int shuffle888NEON(uint8_t* dst, const uint8_t* src,
+                          const uint8_t map[4], int pixels)
+{
+  int i;
+
+  for (i = 0;i + 16 <= pixels;i += 16) {
+    uint8x16x4_t in, out;
+
+    in = vld4q_u8(src + i * 4);
+    for (int c = 0;c < 4;c++)
+      out.val[c] = in.val[map[c]];
+    vst4q_u8(dst + i * 4, out);
+  }
+
+  return i;
+}
+
+static int rgbFrom888NEON(uint8_t* dst, const uint8_t* src,
+                          const simd::Layout888& layout, int pixels)
+{
+  int i;
+
+  for (i = 0;i + 16 <= pixels;i += 16) {
+    uint8x16x4_t in;
+    uint8x16x3_t out;
+
+    in = vld4q_u8(src + i * 4);
+    for (int c = 0;c < 3;c++)
+      out.val[c] = in.val[layout[c]];
+    vst3q_u8(dst + i * 3, out);
+  }
+
+  return i;
+}
+
+static int rgbTo888NEON(uint8_t* dst, const uint8_t* src,
+                        const simd::Layout888& layout, int pixels)
+{
+  int i;
+
+  for (i = 0;i + 16 <= pixels;i += 16) {
+    uint8x16x3_t in;
+    uint8x16x4_t out;
+
+    in = vld3q_u8(src + i * 3);
+    for (int c = 0;c < 3;c++)
+      out.val[layout[c]] = in.val[c];
+    out.val[layout[3]] = vdupq_n_u8(0);
+    vst4q_u8(dst + i * 4, out);
+  }
+
+  return i;
+}
+
+static int blend888NEON(uint8_t* dst, const uint8_t* src,
+                        const simd::Layout888& layout, int pixels)
+{
+  int i;
+
+  for (i = 0;i + 8 <= pixels;i += 8) {
+    uint8x8x4_t s, d;
+    uint8x8_t ia;
+
+    s = vld4_u8(src + i * 4);
+    d = vld4_u8(dst + i * 4);
+
+    ia = vmvn_u8(s.val[layout[3]]);
+    for (int c = 0;c < 3;c++) {
+      uint16x8_t v;
+
+      // v / 255, rounded down like the scalar code
+      v = vmull_u8(d.val[layout[c]], ia);
+      v = vaddq_u16(vaddq_u16(v, vdupq_n_u16(1)), vshrq_n_u16(v, 8));
+      d.val[layout[c]] = vadd_u8(vshrn_n_u16(v, 8), s.val[layout[c]]);
+    }
+
+    vst4_u8(dst + i * 4, d);
+  }
+
+  return i;
+}
+
+#endif // HAVE_SIMD_NEON
+
+void simd::init(bool enable)
+{
+  shuffle888 = noShuffle888;
+  rgbFrom888 = noRGB888;
+  rgbTo888 = noRGB888;
+  from888To16 = noFrom888To16;
+  to888From16 = noTo888From16;
+  blend888 = noBlend888;
+  gradientRGB = noGradientRGB;
+  kernelName = "none";
+
+  if (!enable)
+    return;
+
+#ifdef HAVE_SIMD_X86
+  __builtin_cpu_init();
+
+  if (!__builtin_cpu_supports("sse2"))
+    return;
+
+  initUpconvMagic();
+
+  from888To16 = from888To16SSE2;
+  to888From16 = to888From16SSE2;
+  blend888 = blend888SSE2;
+  gradientRGB = gradientRGBSSE2;
+  kernelName = "SSE2";
+
+  if (!__builtin_cpu_supports("ssse3"))
+    return;
+
+  shuffle888 = shuffle888SSSE3;
+  rgbFrom888 = rgbFrom888SSSE3;
+  rgbTo888 = rgbTo888SSSE3;
+  kernelName = "SSSE3";
+
+  if (!__builtin_cpu_supports("avx2"))
+    return;
+
+  shuffle888 = shuffle888AVX2;
+  kernelName = "AVX2";
+#endif
+
+#ifdef HAVE_SIMD_NEON
+  shuffle888 = shuffle888NEON;
+  rgbFrom888 = rgbFrom888NEON;
+  rgbTo888 = rgbTo888NEON;
+  blend888 = blend888NEON;
+  kernelName = "NEON";
+#endif
+}
+
+const char* simd::name()
+{
+  return kernelName;
+}
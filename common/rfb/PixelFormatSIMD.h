@@ -0,0 +1,94 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// Vectorised kernels for the most common pixel format conversions.
+// The best kernels for the current CPU are picked at start up and
+// PixelFormat falls back to its generic code for anything they
+// cannot handle.
+//
+// Each kernel converts as many pixels as it efficiently can from the
+// start of a single row and returns how many that was. The caller is
+// responsible for converting the remaining pixels.
+//
+
+#ifndef __RFB_PIXELFORMATSIMD_H__
+#define __RFB_PIXELFORMATSIMD_H__
+
+#include <stdint.h>
+
+namespace rfb {
+
+  namespace simd {
+
+    // Position of the red, green, blue and padding bytes in a pixel of
+    // a 888 format
+    typedef uint8_t Layout888[4];
+
+    // Bit position and size of the red, green and blue channels in a
+    // native endian 16 bpp format
+    struct Layout16 {
+      int shift[3];
+      int bits[3];
+    };
+
+    // Reorders the bytes of 888 pixels, so that each destination byte
+    // comes from the source byte given by map
+    extern int (*shuffle888)(uint8_t* dst, const uint8_t* src,
+                             const uint8_t map[4], int pixels);
+
+    // Converts between 888 pixels and packed RGB
+    extern int (*rgbFrom888)(uint8_t* dst, const uint8_t* src,
+                             const Layout888& layout, int pixels);
+    extern int (*rgbTo888)(uint8_t* dst, const uint8_t* src,
+                           const Layout888& layout, int pixels);
+
+    // Converts between 888 pixels and 16 bpp pixels, with the same
+    // rounding as the lookup tables in PixelFormat
+    extern int (*from888To16)(uint16_t* dst, const uint8_t* src,
+                              const Layout888& srcLayout,
+                              const Layout16& dstLayout, int pixels);
+    extern int (*to888From16)(uint8_t* dst, const uint16_t* src,
+                              const Layout888& dstLayout,
+                              const Layout16& srcLayout, int pixels);
+
+    // Blends premultiplied 888 pixels, with the alpha in the padding
+    // byte, on to 888 pixels of the same layout. The padding of the
+    // destination is left untouched.
+    extern int (*blend888)(uint8_t* dst, const uint8_t* src,
+                           const Layout888& layout, int pixels);
+
+    // Reverses the Tight gradient filter on rows of packed RGB, with
+    // prev being the already decoded row above the first one. Unlike
+    // the other kernels this works on whole rows, and it returns how
+    // many of them it decoded.
+    extern int (*gradientRGB)(uint8_t* dst, const uint8_t* src,
+                              const uint8_t* prev, int width, int rows);
+
+    // init() picks the kernels for the current CPU, or disables all of
+    // them if enable is false. It is called automatically on start up.
+    void init(bool enable=true);
+
+    // name() returns a description of the kernels currently in use
+    const char* name();
+
+  }
+
+}
+
+#endif
@@ -45,6 +45,17 @@ bool RREEncoder::isSupported()
   return conn->client.supportsEncoding(encodingRRE);
 }
 
+size_t RREEncoder::getMemoryUsage()
+{
+  return mos.capacity() + bufferCopy.getBufferSize();
+}
+
+void RREEncoder::releaseMemory()
+{
+  mos.shrink();
+  bufferCopy.releaseBuffer();
+}
+
 void RREEncoder::writeRect(const PixelBuffer* pb, const Palette& palette)
 {
   uint8_t* imageBuf;
@@ -30,6 +30,9 @@ namespace rfb {
     RREEncoder(SConnection* conn);
     virtual ~RREEncoder();
     bool isSupported() override;
+
+    size_t getMemoryUsage() override;
+    void releaseMemory() override;
     void writeRect(const PixelBuffer* pb,
                    const Palette& palette) override;
     void writeSolidRect(int width, int height, const PixelFormat& pf,
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include <algorithm>
+#include <vector>
 
 #include <core/LogWriter.h>
 #include <core/i18n.h>
@@ -49,6 +50,28 @@ using namespace rfb;
 
 static core::LogWriter vlog("SConnection");
 
+// Clipboard data larger than this is sent in pieces to clients that
+// support it
+static const size_t clipboardChunkSize = 64 * 1024;
+
+// Length of the data after conversion by core::convertCRLF()
+static size_t crlfLength(const char* data)
+{
+  const char* in;
+  size_t len;
+
+  len = 0;
+  for (in = data; *in != '\0'; in++) {
+    len++;
+    if ((*in == '\r') && (*(in+1) != '\n'))
+      len++;
+    else if ((*in == '\n') && ((in == data) || (*(in-1) != '\r')))
+      len++;
+  }
+
+  return len;
+}
+
 SConnection::SConnection(AccessRights accessRights_)
   : readyForSetColourMapEntries(false), is(nullptr), os(nullptr),
     reader_(nullptr), writer_(nullptr), ssecurity(nullptr),
@@ -56,7 +79,8 @@ SConnection::SConnection(AccessRights accessRights_)
     state_(RFBSTATE_UNINITIALISED), preferredEncoding(encodingRaw),
     accessRights(accessRights_), hasRemoteClipboard(false),
     hasLocalClipboard(false),
-    unsolicitedClipboardAttempt(false)
+    unsolicitedClipboardAttempt(false), pendingClipboard(nullptr),
+    pendingClipboardPos(0)
 {
   defaultMajorVersion = 3;
   defaultMinorVersion = 8;
@@ -702,10 +726,12 @@ void SConnection::sendClipboardData(const char* data)
 
   if (client.supportsEncoding(pseudoEncodingExtendedClipboard) &&
       (client.clipboardFlags() & rfb::clipboardProvide)) {
-    // FIXME: This conversion magic should be in SMsgWriter
-    std::string filtered(core::convertCRLF(data));
-    size_t sizes[1] = { filtered.size() + 1 };
-    const uint8_t* datas[1] = { (const uint8_t*)filtered.c_str() };
+    // The client cannot handle overlapping transfers, and whatever is
+    // still being sent is out of date by now
+    abortClipboardData();
+
+    // Include the terminating null character
+    size_t sizes[1] = { crlfLength(data) + 1 };
 
     if (unsolicitedClipboardAttempt) {
       unsolicitedClipboardAttempt = false;
@@ -717,12 +743,80 @@ void SConnection::sendClipboardData(const char* data)
       }
     }
 
+    if (client.supportsEncoding(pseudoEncodingClipboardStream) &&
+        (sizes[0] > clipboardChunkSize)) {
+      vlog.debug("Streaming clipboard data (%u bytes)", (unsigned)sizes[0]);
+      writer()->writeClipboardStreamStart(rfb::clipboardUTF8, sizes);
+      pendingClipboard = data;
+      pendingClipboardPos = 0;
+      return;
+    }
+
+    // FIXME: This conversion magic should be in SMsgWriter
+    std::string filtered(core::convertCRLF(data));
+    const uint8_t* datas[1] = { (const uint8_t*)filtered.c_str() };
+
     writer()->writeClipboardProvide(rfb::clipboardUTF8, sizes, datas);
   } else {
     writer()->writeServerCutText(data);
   }
 }
 
+bool SConnection::clipboardDataPending() const
+{
+  return writer_ && writer_->clipboardStreamActive();
+}
+
+void SConnection::writeClipboardData()
+{
+  std::vector<uint8_t> buffer;
+  const char* in;
+
+  if (!clipboardDataPending())
+    return;
+
+  // Same conversion as core::convertCRLF(), but only of the next
+  // piece, so there is never a full converted copy of the data
+  buffer.reserve(clipboardChunkSize + 1);
+  in = pendingClipboard + pendingClipboardPos;
+  while (buffer.size() < clipboardChunkSize) {
+    if (*in == '\0') {
+      // Include the terminating null character
+      buffer.push_back('\0');
+      break;
+    }
+
+    if ((*in == '\n') && ((in == pendingClipboard) || (*(in-1) != '\r')))
+      buffer.push_back('\r');
+    buffer.push_back(*in);
+    if ((*in == '\r') && (*(in+1) != '\n'))
+      buffer.push_back('\n');
+
+    in++;
+  }
+  pendingClipboardPos = in - pendingClipboard;
+
+  writer()->writeClipboardStreamData(buffer.data(), buffer.size());
+
+  if (!clipboardDataPending()) {
+    pendingClipboard = nullptr;
+    pendingClipboardPos = 0;
+  }
+}
+
+void SConnection::abortClipboardData()
+{
+  if (!clipboardDataPending())
+    return;
+
+  vlog.debug("Aborting clipboard transfer");
+
+  pendingClipboard = nullptr;
+  pendingClipboardPos = 0;
+
+  writer()->writeClipboardStreamAbort();
+}
+
 void SConnection::cleanup()
 {
   delete ssecurity;
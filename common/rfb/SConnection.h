@@ -106,6 +106,16 @@ namespace rfb {
     // clipboard via handleClipboardRequest().
     void sendClipboardData(const char* data);
 
+    // Large clipboard transfers are split up for clients that support
+    // it. sendClipboardData() then only starts the transfer, and
+    // writeClipboardData() must be called to send each following piece
+    // for as long as clipboardDataPending() returns true. The data
+    // given to sendClipboardData() must remain valid until then, or
+    // until abortClipboardData() has been called.
+    bool clipboardDataPending() const;
+    void writeClipboardData();
+    void abortClipboardData();
+
     // getAccessRights() returns the access rights of a SConnection to the server.
     AccessRights getAccessRights() { return accessRights; }
 
@@ -293,6 +303,9 @@ namespace rfb {
     bool hasRemoteClipboard;
     bool hasLocalClipboard;
     bool unsolicitedClipboardAttempt;
+
+    const char* pendingClipboard;
+    size_t pendingClipboardPos;
   };
 }
 #endif
@@ -95,8 +95,9 @@ namespace rfb {
       return resultProhibited;
     }
 
-    // frameTick() is called whenever a frame update has been processed,
-    // signalling that a good time to render new data
+    // frameTick() is called at the start of every frame, just before
+    // the frame update is processed. Anything drawn here will be part
+    // of that update, and it is also a good time to render new data.
     virtual void frameTick(uint64_t msc) { (void)msc; }
 
     // keyEvent() is called whenever a client sends an event that a
@@ -39,6 +39,7 @@
 #include <rfb/UpdateTracker.h>
 #include <rfb/Encoder.h>
 #include <rfb/ScreenSet.h>
+#include <rfb/SharedMemoryPixelBuffer.h>
 #include <rfb/SMsgWriter.h>
 #include <rfb/encodings.h>
 #include <rfb/ledStates.h>
@@ -52,12 +53,17 @@ SMsgWriter::SMsgWriter(ClientParams* client_, rdr::OutStream* os_)
     nRectsInUpdate(0), nRectsInHeader(0),
     needSetDesktopName(false), needCursor(false),
     needCursorPos(false), needLEDState(false),
-    needQEMUKeyEvent(false), needExtMouseButtonsEvent(false)
+    needQEMUKeyEvent(false), needExtMouseButtonsEvent(false),
+    needScaleFactor(false), clipboardMos(nullptr), clipboardZos(nullptr),
+    clipboardStreamFlags(0), clipboardStreamCount(0),
+    clipboardStreamIndex(0), clipboardStreamLeft(0)
 {
 }
 
 SMsgWriter::~SMsgWriter()
 {
+  delete clipboardZos;
+  delete clipboardMos;
 }
 
 void SMsgWriter::writeServerInit(uint16_t width, uint16_t height,
@@ -192,6 +198,8 @@ void SMsgWriter::writeClipboardProvide(uint32_t flags,
     throw std::logic_error("Client does not support extended clipboard");
   if (!(client->clipboardFlags() & clipboardProvide))
     throw std::logic_error("Client does not support clipboard \"provide\" action");
+  if (clipboardStreamActive())
+    throw std::logic_error("Clipboard transfer already in progress");
 
   zos.setUnderlying(&mos);
 
@@ -214,6 +222,116 @@ void SMsgWriter::writeClipboardProvide(uint32_t flags,
   endMsg();
 }
 
+void SMsgWriter::writeClipboardStreamStart(uint32_t flags,
+                                           const size_t* lengths)
+{
+  int i;
+
+  if (!client->supportsEncoding(pseudoEncodingExtendedClipboard))
+    throw std::logic_error("Client does not support extended clipboard");
+  if (!(client->clipboardFlags() & clipboardProvide))
+    throw std::logic_error("Client does not support clipboard \"provide\" action");
+  if (!client->supportsEncoding(pseudoEncodingClipboardStream))
+    throw std::logic_error("Client does not support clipboard streaming");
+  if (clipboardStreamActive())
+    throw std::logic_error("Clipboard transfer already in progress");
+
+  clipboardStreamFlags = flags & clipboardFormatMask;
+
+  clipboardStreamCount = 0;
+  for (i = 0;i < 16;i++) {
+    if (!(flags & (1 << i)))
+      continue;
+    clipboardStreamLengths[clipboardStreamCount] =
+      lengths[clipboardStreamCount];
+    clipboardStreamCount++;
+  }
+
+  clipboardStreamIndex = 0;
+  clipboardStreamLeft = 0;
+
+  // The compressed data is only buffered one message at a time
+  clipboardMos = new rdr::MemOutStream();
+  clipboardZos = new rdr::ZlibOutStream(clipboardMos);
+}
+
+void SMsgWriter::writeClipboardStreamData(const uint8_t* data,
+                                          size_t length)
+{
+  bool last;
+
+  if (!clipboardStreamActive())
+    throw std::logic_error("No clipboard transfer in progress");
+
+  while (true) {
+    size_t chunk;
+
+    // Start of the next format?
+    while ((clipboardStreamLeft == 0) &&
+           (clipboardStreamIndex < clipboardStreamCount)) {
+      clipboardStreamLeft = clipboardStreamLengths[clipboardStreamIndex++];
+      clipboardZos->writeU32(clipboardStreamLeft);
+    }
+
+    if (length == 0)
+      break;
+
+    if (clipboardStreamLeft == 0)
+      throw std::out_of_range("Too much clipboard data");
+
+    chunk = length;
+    if (chunk > clipboardStreamLeft)
+      chunk = clipboardStreamLeft;
+
+    clipboardZos->writeBytes(data, chunk);
+
+    data += chunk;
+    length -= chunk;
+    clipboardStreamLeft -= chunk;
+  }
+
+  last = (clipboardStreamLeft == 0) &&
+         (clipboardStreamIndex == clipboardStreamCount);
+
+  clipboardZos->flush();
+
+  startMsg(msgTypeServerCutText);
+  os->pad(3);
+  os->writeS32(-(4 + clipboardMos->length()));
+  os->writeU32(clipboardStreamFlags | clipboardProvide |
+               (last ? 0 : clipboardStream));
+  os->writeBytes(clipboardMos->data(), clipboardMos->length());
+  endMsg();
+
+  clipboardMos->clear();
+
+  if (last) {
+    delete clipboardZos;
+    clipboardZos = nullptr;
+    delete clipboardMos;
+    clipboardMos = nullptr;
+  }
+}
+
+void SMsgWriter::writeClipboardStreamAbort()
+{
+  if (!clipboardStreamActive())
+    throw std::logic_error("No clipboard transfer in progress");
+
+  delete clipboardZos;
+  clipboardZos = nullptr;
+  delete clipboardMos;
+  clipboardMos = nullptr;
+
+  // A final message without any formats tells the client to throw
+  // away what it has received so far
+  startMsg(msgTypeServerCutText);
+  os->pad(3);
+  os->writeS32(-4);
+  os->writeU32(clipboardProvide);
+  endMsg();
+}
+
 void SMsgWriter::writeFence(uint32_t flags, unsigned len,
                             const uint8_t data[])
 {
@@ -314,6 +432,15 @@ void SMsgWriter::writeExtendedMouseButtonsSupport()
   needExtMouseButtonsEvent = true;
 }
 
+void SMsgWriter::writeScaleFactor()
+{
+  if (!client->supportsEncoding(pseudoEncodingScaleFactor1 +
+                                client->scaleFactor - 1))
+    throw std::logic_error("Client does not support scaling");
+
+  needScaleFactor = true;
+}
+
 bool SMsgWriter::needFakeUpdate()
 {
   if (needSetDesktopName)
@@ -328,6 +455,8 @@ bool SMsgWriter::needFakeUpdate()
     return true;
   if (needExtMouseButtonsEvent)
     return true;
+  if (needScaleFactor)
+    return true;
   if (needNoDataUpdate())
     return true;
 
@@ -378,6 +507,8 @@ void SMsgWriter::writeFramebufferUpdateStart(int nRects)
       nRects++;
     if (needExtMouseButtonsEvent)
       nRects++;
+    if (needScaleFactor)
+      nRects++;
   }
 
   os->writeU16(nRects);
@@ -417,6 +548,39 @@ void SMsgWriter::writeCopyRect(const core::Rect& r, int srcX, int srcY)
   endRect();
 }
 
+void SMsgWriter::writeTileCacheRect(const core::Rect& r, int op,
+                                    uint64_t hash)
+{
+  startRect(r, encodingTileCache);
+  os->writeU8(op);
+  os->writeU32(hash >> 32);
+  os->writeU32(hash);
+  endRect();
+}
+
+void SMsgWriter::writeSharedMemorySetup(const core::Rect& r, int stride,
+                                        const PixelFormat& pf)
+{
+  if (!client->supportsEncoding(pseudoEncodingSharedMemory))
+    throw std::logic_error("Client does not support shared memory");
+
+  startRect(r, pseudoEncodingSharedMemory);
+  os->writeU8(sharedMemorySetup);
+  os->writeU32(stride);
+  pf.write(os);
+  endRect();
+}
+
+void SMsgWriter::writeSharedMemoryDamage(const core::Rect& r)
+{
+  if (!client->supportsEncoding(pseudoEncodingSharedMemory))
+    throw std::logic_error("Client does not support shared memory");
+
+  startRect(r, pseudoEncodingSharedMemory);
+  os->writeU8(sharedMemoryDamage);
+  endRect();
+}
+
 void SMsgWriter::startRect(const core::Rect& r, int encoding)
 {
   if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
@@ -522,6 +686,11 @@ void SMsgWriter::writePseudoRects()
     writeExtendedMouseButtonsRect();
     needExtMouseButtonsEvent = false;
   }
+
+  if (needScaleFactor) {
+    writeScaleFactorRect(client->scaleFactor);
+    needScaleFactor = false;
+  }
 }
 
 void SMsgWriter::writeNoDataRects()
@@ -768,3 +937,17 @@ void SMsgWriter::writeExtendedMouseButtonsRect()
   os->writeU16(0);
   os->writeU32(pseudoEncodingExtendedMouseButtons);
 }
+
+void SMsgWriter::writeScaleFactorRect(int factor)
+{
+  if (!client->supportsEncoding(pseudoEncodingScaleFactor1 + factor - 1))
+    throw std::logic_error("Client does not support scaling");
+  if (++nRectsInUpdate > nRectsInHeader && nRectsInHeader)
+    throw std::logic_error("SMsgWriter::writeScaleFactorRect: nRects out of sync");
+
+  os->writeS16(0);
+  os->writeS16(0);
+  os->writeU16(0);
+  os->writeU16(0);
+  os->writeU32(pseudoEncodingScaleFactor1 + factor - 1);
+}
@@ -27,7 +27,11 @@
 
 namespace core { struct Rect; }
 
-namespace rdr { class OutStream; }
+namespace rdr {
+  class OutStream;
+  class MemOutStream;
+  class ZlibOutStream;
+}
 
 namespace rfb {
 
@@ -66,6 +70,17 @@ namespace rfb {
     void writeClipboardProvide(uint32_t flags, const size_t* lengths,
                                const uint8_t* const* data);
 
+    // writeClipboardStreamStart() begins a clipboard transfer that is
+    // split over several messages, for clients that support the
+    // pseudoEncodingClipboardStream extension. The data is then given
+    // in order via writeClipboardStreamData(), which sends one message
+    // per call. No other clipboard data may be sent until the transfer
+    // is done, or has been given up with writeClipboardStreamAbort().
+    void writeClipboardStreamStart(uint32_t flags, const size_t* lengths);
+    void writeClipboardStreamData(const uint8_t* data, size_t length);
+    void writeClipboardStreamAbort();
+    bool clipboardStreamActive() const { return clipboardZos != nullptr; }
+
     // writeFence() sends a new fence request or response to the client.
     void writeFence(uint32_t flags, unsigned len, const uint8_t data[]);
 
@@ -95,6 +110,10 @@ namespace rfb {
     // let the client know we support extended mouse button support
     void writeExtendedMouseButtonsSupport();
 
+    // Confirms the scale factor, which must be sent together with the
+    // resulting change in framebuffer size
+    void writeScaleFactor();
+
     // needFakeUpdate() returns true when an immediate update is needed in
     // order to flush out pseudo-rectangles to the client.
     bool needFakeUpdate();
@@ -118,6 +137,15 @@ namespace rfb {
     // There is no explicit encoder for CopyRect rects.
     void writeCopyRect(const core::Rect& r, int srcX, int srcY);
 
+    // Nor for the tile cache, see TileCache for the operations
+    void writeTileCacheRect(const core::Rect& r, int op, uint64_t hash);
+
+    // Or for the shared memory framebuffer. The setup rect must be
+    // accompanied by the memory file descriptor on the socket.
+    void writeSharedMemorySetup(const core::Rect& r, int stride,
+                                const PixelFormat& pf);
+    void writeSharedMemoryDamage(const core::Rect& r);
+
     // Encoders should call these to mark the start and stop of individual
     // rects.
     void startRect(const core::Rect& r, int enc);
@@ -151,6 +179,7 @@ namespace rfb {
     void writeLEDStateRect(uint8_t state);
     void writeQEMUKeyEventRect();
     void writeExtendedMouseButtonsRect();
+    void writeScaleFactorRect(int factor);
 
     ClientParams* client;
     rdr::OutStream* os;
@@ -164,12 +193,21 @@ namespace rfb {
     bool needLEDState;
     bool needQEMUKeyEvent;
     bool needExtMouseButtonsEvent;
+    bool needScaleFactor;
 
     typedef struct {
       uint16_t reason, result;
     } ExtendedDesktopSizeMsg;
 
     std::list<ExtendedDesktopSizeMsg> extendedDesktopSizeMsgs;
+
+    rdr::MemOutStream* clipboardMos;
+    rdr::ZlibOutStream* clipboardZos;
+    uint32_t clipboardStreamFlags;
+    size_t clipboardStreamLengths[16];
+    int clipboardStreamCount;
+    int clipboardStreamIndex;
+    size_t clipboardStreamLeft;
   };
 }
 #endif
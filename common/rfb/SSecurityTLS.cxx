@@ -168,7 +168,7 @@ bool SSecurityTLS::processMsg()
     os->writeU8(1);
     os->flush();
 
-    tlssock = new rdr::TLSSocket(is, os, session);
+    tlssock = new rdr::TLSSocket(is, os, session, Security::KernelTLS);
 
     rawis = is;
     rawos = os;
@@ -185,7 +185,11 @@ bool SSecurityTLS::processMsg()
   vlog.debug("TLS handshake completed with %s",
              gnutls_session_get_desc(session));
 
-  sc->setStreams(&tlssock->inStream(), &tlssock->outStream());
+  // No need to go via GnuTLS if the kernel is doing the work
+  if (tlssock->kernelSend())
+    sc->setStreams(&tlssock->inStream(), rawos);
+  else
+    sc->setStreams(&tlssock->inStream(), &tlssock->outStream());
 
   return true;
 }
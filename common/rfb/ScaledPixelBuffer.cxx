@@ -0,0 +1,216 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+
+#include <algorithm>
+
+#include <core/Region.h>
+
+#include <rfb/ScaledPixelBuffer.h>
+
+using namespace rfb;
+
+// Calculates the average of the sums of source columns x0 to x1,
+// where recip is the reciprocal of the total number of pixels
+template<int channels>
+static inline void averageBlock(uint8_t* out, const uint16_t* sums,
+                                int x0, int x1, uint32_t count,
+                                uint32_t recip)
+{
+  uint32_t total[channels];
+
+  for (int c = 0; c < channels; c++)
+    total[c] = count / 2;
+
+  for (int x = x0; x < x1; x++) {
+    for (int c = 0; c < channels; c++)
+      total[c] += sums[x * channels + c];
+  }
+
+  for (int c = 0; c < channels; c++)
+    out[c] = (total[c] * recip) >> 22;
+}
+
+ScaledPixelBuffer::ScaledPixelBuffer()
+  : scale(1), srcWidth(0), srcHeight(0), native(false)
+{
+}
+
+ScaledPixelBuffer::~ScaledPixelBuffer()
+{
+}
+
+void ScaledPixelBuffer::setSource(const PixelFormat& pf,
+                                  int width, int height, int scale_)
+{
+  assert(scale_ >= 1);
+  assert(scale_ <= 8);
+
+  scale = scale_;
+  srcWidth = width;
+  srcHeight = height;
+
+  // Pixels with one byte per channel can be averaged byte by byte,
+  // without caring about the channel order. Anything else goes via
+  // an RGB888 intermediate.
+  native = pf.is888();
+
+  setPF(pf);
+  setSize((width + scale - 1) / scale, (height + scale - 1) / scale);
+}
+
+bool ScaledPixelBuffer::matchesSource(const PixelBuffer* src,
+                                      int scale_) const
+{
+  return (scale == scale_) &&
+         (src->width() == srcWidth) && (src->height() == srcHeight) &&
+         (src->getPF() == getPF());
+}
+
+void ScaledPixelBuffer::update(const core::Rect& rect_,
+                               const PixelBuffer* src,
+                               const core::Rect& srcRect)
+{
+  core::Rect rect, sr;
+  int pixelSize;
+
+  const uint8_t* srcBuffer;
+  int srcStride, srcBPP;
+  uint8_t* dstBuffer;
+  int dstStride, dstBPP;
+
+  rect = rect_.intersect(getRect());
+  sr = unscaleRect(rect, scale).intersect(srcRect);
+  if (sr.is_empty())
+    return;
+
+  pixelSize = native ? 4 : 3;
+
+  // The RGB row is used both for converting input and output rows
+  rgbRow.resize(std::max(sr.width(), rect.width()) * 3);
+  sums.resize(sr.width() * pixelSize);
+
+  srcBuffer = src->getBuffer(sr, &srcStride);
+  srcBPP = src->getPF().bpp / 8;
+
+  dstBuffer = getBufferRW(rect, &dstStride);
+  dstBPP = format.bpp / 8;
+
+  for (int y = rect.tl.y; y < rect.br.y; y++) {
+    int y0, y1;
+    uint32_t count, recip;
+    uint8_t* out;
+
+    y0 = std::max(y * scale, sr.tl.y);
+    y1 = std::min((y + 1) * scale, sr.br.y);
+    if (y0 >= y1)
+      continue;
+
+    // Sum up all source rows for this row of blocks. The inner loop
+    // is kept simple so that the compiler can vectorise it, and the
+    // column sums fit in 16 bits as long as the scale is at most 8.
+    std::fill(sums.begin(), sums.end(), 0);
+    for (int sy = y0; sy < y1; sy++) {
+      const uint8_t* in;
+      size_t len;
+
+      in = srcBuffer + (sy - sr.tl.y) * srcStride * srcBPP;
+      if (!native) {
+        src->getPF().rgbFromBuffer(rgbRow.data(), in, sr.width());
+        in = rgbRow.data();
+      }
+
+      len = sums.size();
+      for (size_t i = 0; i < len; i++)
+        sums[i] += in[i];
+    }
+
+    // Then each block horizontally. Division is slow, so we multiply
+    // with a reciprocal instead. The sums are small enough that this
+    // is exact for the scale factors we allow.
+    count = recip = 0;
+    out = native ? dstBuffer + (y - rect.tl.y) * dstStride * dstBPP :
+                   rgbRow.data();
+    for (int x = rect.tl.x; x < rect.br.x; x++) {
+      int x0, x1;
+
+      x0 = std::max(x * scale, sr.tl.x) - sr.tl.x;
+      x1 = std::min((x + 1) * scale, sr.br.x) - sr.tl.x;
+      if (x0 >= x1) {
+        out += pixelSize;
+        continue;
+      }
+
+      if ((uint32_t)((x1 - x0) * (y1 - y0)) != count) {
+        count = (x1 - x0) * (y1 - y0);
+        recip = ((1 << 22) + count - 1) / count;
+      }
+
+      if (native)
+        averageBlock<4>(out, sums.data(), x0, x1, count, recip);
+      else
+        averageBlock<3>(out, sums.data(), x0, x1, count, recip);
+
+      out += pixelSize;
+    }
+
+    if (!native) {
+      format.bufferFromRGB(dstBuffer + (y - rect.tl.y) * dstStride * dstBPP,
+                           rgbRow.data(), rect.width());
+    }
+  }
+
+  commitBufferRW(rect);
+}
+
+core::Rect ScaledPixelBuffer::scaleRect(const core::Rect& r, int factor)
+{
+  if (factor == 1)
+    return r;
+
+  return {r.tl.x / factor, r.tl.y / factor,
+          (r.br.x + factor - 1) / factor, (r.br.y + factor - 1) / factor};
+}
+
+core::Region ScaledPixelBuffer::scaleRegion(const core::Region& r,
+                                            int factor)
+{
+  std::vector<core::Rect> rects;
+  core::Region scaled;
+
+  if (factor == 1)
+    return r;
+
+  r.get_rects(&rects);
+  for (const core::Rect& rect : rects)
+    scaled.assign_union(scaleRect(rect, factor));
+
+  return scaled;
+}
+
+core::Rect ScaledPixelBuffer::unscaleRect(const core::Rect& r,
+                                          int factor)
+{
+  return {r.tl.x * factor, r.tl.y * factor,
+          r.br.x * factor, r.br.y * factor};
+}
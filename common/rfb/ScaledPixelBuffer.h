@@ -0,0 +1,78 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ScaledPixelBuffer is a reduced resolution copy of another pixel
+// buffer, where each pixel is the average of a square block of pixels
+// in the source.
+//
+
+#ifndef __RFB_SCALEDPIXELBUFFER_H__
+#define __RFB_SCALEDPIXELBUFFER_H__
+
+#include <vector>
+
+#include <rfb/PixelBuffer.h>
+
+namespace core { class Region; }
+
+namespace rfb {
+
+  class ScaledPixelBuffer : public ManagedPixelBuffer {
+  public:
+    ScaledPixelBuffer();
+    virtual ~ScaledPixelBuffer();
+
+    int getScale() const { return scale; }
+
+    // setSource() prepares the buffer for a source of the given format
+    // and size. The contents are undefined until updated.
+    void setSource(const PixelFormat& pf, int width, int height,
+                   int scale);
+
+    // matchesSource() checks if setSource() needs to be called for
+    // the given source
+    bool matchesSource(const PixelBuffer* src, int scale) const;
+
+    // update() recalculates the given area, which is in scaled
+    // coordinates. The source covers srcRect of the full size
+    // framebuffer and any parts of a block outside of it are ignored.
+    void update(const core::Rect& rect, const PixelBuffer* src,
+                const core::Rect& srcRect);
+
+    // scaleRect() and scaleRegion() return the smallest area in scaled
+    // coordinates that covers the given full size area
+    static core::Rect scaleRect(const core::Rect& r, int factor);
+    static core::Region scaleRegion(const core::Region& r, int factor);
+
+    // unscaleRect() returns the full size area covered by the given
+    // area in scaled coordinates
+    static core::Rect unscaleRect(const core::Rect& r, int factor);
+
+  protected:
+    int scale;
+    int srcWidth, srcHeight;
+    bool native;
+
+    std::vector<uint8_t> rgbRow;
+    std::vector<uint16_t> sums;
+  };
+
+}
+
+#endif
@@ -42,6 +42,10 @@ core::StringParameter Security::GnuTLSPriority(
   _("GnuTLS priority string that controls the TLS session's handshake "
     "algorithms"),
   "");
+core::BoolParameter Security::KernelTLS(
+  "KernelTLS",
+  _("Let the kernel handle TLS encryption if supported by the system"),
+  false);
 #endif
 
 Security::Security()
@@ -27,6 +27,7 @@
 #include <list>
 
 namespace core {
+  class BoolParameter;
   class EnumListParameter;
   class StringParameter;
 }
@@ -110,6 +111,7 @@ namespace rfb {
 
 #ifdef HAVE_GNUTLS
     static core::StringParameter GnuTLSPriority;
+    static core::BoolParameter KernelTLS;
 #endif
 
   private:
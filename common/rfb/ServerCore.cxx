@@ -54,12 +54,18 @@ core::IntParameter rfb::Server::maxIdleTime
 core::IntParameter rfb::Server::compareFB
 ("CompareFB",
  _("Perform pixel comparison on framebuffer to reduce unnecessary "
-   "updates (0: never, 1: always, 2: auto)"),
- 2, 0, 2);
+   "updates (0: never, 1: always, 2: auto, 3: always using block "
+   "hashes, 4: auto using block hashes)"),
+ 2, 0, 4);
 core::IntParameter rfb::Server::frameRate
 ("FrameRate",
  _("The maximum number of updates per second sent to each client"),
  60, 0, INT_MAX);
+core::IntParameter rfb::Server::encoderIdleTimeout
+("EncoderIdleTimeout",
+ _("Free the buffers and compression state of encoders that have not "
+   "been used for the specified number of seconds (zero means never)"),
+ 60, 0, INT_MAX);
 core::BoolParameter rfb::Server::protocol3_3
 ("Protocol3.3",
  _("Always use protocol version 3.3 for backwards compatibility with "
@@ -104,3 +110,8 @@ core::BoolParameter rfb::Server::queryConnect
 ("QueryConnect",
  _("Prompt the local user to accept or reject incoming connections"),
  false);
+core::BoolParameter rfb::Server::threadedOutput
+("ThreadedOutput",
+ _("Write to each client from a separate thread, so that slow clients "
+   "do not hold up the server"),
+ false);
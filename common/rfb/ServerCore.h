@@ -37,6 +37,7 @@ namespace rfb {
     static core::IntParameter maxIdleTime;
     static core::IntParameter compareFB;
     static core::IntParameter frameRate;
+    static core::IntParameter encoderIdleTimeout;
     static core::BoolParameter protocol3_3;
     static core::BoolParameter alwaysShared;
     static core::BoolParameter neverShared;
@@ -47,6 +48,7 @@ namespace rfb {
     static core::BoolParameter sendCutText;
     static core::BoolParameter acceptSetDesktopSize;
     static core::BoolParameter queryConnect;
+    static core::BoolParameter threadedOutput;
 
   };
 
@@ -41,7 +41,7 @@ ServerParams::ServerParams()
     supportsQEMUKeyEvent(false),
     supportsSetDesktopSize(false), supportsFence(false),
     supportsContinuousUpdates(false), supportsExtendedMouseButtons(false),
-    width_(0), height_(0),
+    scaleFactor(1), width_(0), height_(0),
     ledState_(ledUnknown)
 {
   setName("");
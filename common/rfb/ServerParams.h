@@ -81,6 +81,8 @@ namespace rfb {
     bool supportsContinuousUpdates;
     bool supportsExtendedMouseButtons;
 
+    int scaleFactor;
+
   private:
 
     int width_;
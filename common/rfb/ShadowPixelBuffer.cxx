@@ -0,0 +1,78 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <vector>
+
+#include <rfb/ShadowPixelBuffer.h>
+
+using namespace rfb;
+
+ShadowPixelBuffer::ShadowPixelBuffer(const PixelFormat& pf,
+                                     const PixelBuffer* source_)
+  : source(nullptr)
+{
+  setPF(pf);
+  setSource(source_);
+}
+
+ShadowPixelBuffer::~ShadowPixelBuffer()
+{
+}
+
+void ShadowPixelBuffer::setSource(const PixelBuffer* source_)
+{
+  source = source_;
+
+  if (source == nullptr) {
+    dirty.clear();
+    return;
+  }
+
+  setSize(source->width(), source->height());
+  dirty = getRect();
+}
+
+void ShadowPixelBuffer::damage(const core::Region& region)
+{
+  dirty.assign_union(region);
+}
+
+void ShadowPixelBuffer::update(const core::Rect& rect)
+{
+  core::Region changed;
+  std::vector<core::Rect> rects;
+
+  changed = dirty.intersect(rect);
+  if (changed.is_empty())
+    return;
+
+  changed.get_rects(&rects);
+  for (const core::Rect& r : rects) {
+    const uint8_t* buffer;
+    int srcStride;
+
+    buffer = source->getBuffer(r, &srcStride);
+    imageRect(source->getPF(), r, buffer, srcStride);
+  }
+
+  dirty.assign_subtract(changed);
+}
@@ -0,0 +1,59 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// ShadowPixelBuffer is a copy of another pixel buffer in a
+// different pixel format. Changes in the source are only converted
+// once someone asks for that area.
+//
+
+#ifndef __RFB_SHADOWPIXELBUFFER_H__
+#define __RFB_SHADOWPIXELBUFFER_H__
+
+#include <core/Region.h>
+
+#include <rfb/PixelBuffer.h>
+
+namespace rfb {
+
+  class ShadowPixelBuffer : public ManagedPixelBuffer {
+  public:
+    ShadowPixelBuffer(const PixelFormat& pf, const PixelBuffer* source);
+    virtual ~ShadowPixelBuffer();
+
+    const PixelBuffer* getSource() const { return source; }
+
+    // setSource() switches to a new source, which makes the entire
+    // buffer out of date
+    void setSource(const PixelBuffer* source);
+
+    // damage() marks an area as changed in the source
+    void damage(const core::Region& region);
+
+    // update() converts anything in the given area that has changed in
+    // the source since it was last converted
+    void update(const core::Rect& rect);
+
+  protected:
+    const PixelBuffer* source;
+    core::Region dirty;
+  };
+
+}
+
+#endif
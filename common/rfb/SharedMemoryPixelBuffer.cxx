@@ -0,0 +1,140 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <core/Exception.h>
+#include <core/i18n.h>
+
+#include <rfb/Exception.h>
+#include <rfb/SharedMemoryPixelBuffer.h>
+
+using namespace rfb;
+
+SharedMemoryPixelBuffer::SharedMemoryPixelBuffer(const PixelFormat& pf,
+                                                 int width, int height)
+  : FullFramePixelBuffer(pf, 0, 0, nullptr, 0),
+    fd(-1), stride(width), mapping(nullptr), length(0)
+{
+  length = (size_t)stride * height * (pf.bpp / 8);
+
+  fd = memfd_create("vnc-framebuffer", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    throw core::posix_error("memfd_create", errno);
+
+  if (ftruncate(fd, length) != 0) {
+    int err = errno;
+    close(fd);
+    throw core::posix_error("ftruncate", err);
+  }
+
+  // The viewer must be able to trust that the memory stays around
+  if (fcntl(fd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    int err = errno;
+    close(fd);
+    throw core::posix_error("fcntl", err);
+  }
+
+  map(width, height, true);
+}
+
+SharedMemoryPixelBuffer::SharedMemoryPixelBuffer(int fd_,
+                                                 const PixelFormat& pf,
+                                                 int width, int height,
+                                                 int stride_)
+  : FullFramePixelBuffer(pf, 0, 0, nullptr, 0),
+    fd(fd_), stride(stride_), mapping(nullptr), length(0)
+{
+  struct stat st;
+  int seals;
+  size_t bytesPerPixel;
+
+  bytesPerPixel = pf.bpp / 8;
+
+  // The server picks these, so make sure the size can't wrap around
+  // and let through a mapping smaller than what we will be reading
+  if ((width < 0) || (height < 0) || (stride < width) ||
+      (bytesPerPixel == 0) ||
+      ((size_t)stride > SIZE_MAX / bytesPerPixel) ||
+      ((height != 0) &&
+       ((size_t)stride * bytesPerPixel > SIZE_MAX / (size_t)height))) {
+    close(fd);
+    throw protocol_error(_("Invalid shared memory layout"));
+  }
+
+  length = (size_t)stride * bytesPerPixel * height;
+
+  // Make sure the server can't pull the memory from under us
+  seals = fcntl(fd, F_GET_SEALS);
+  if ((seals < 0) || !(seals & F_SEAL_SHRINK)) {
+    close(fd);
+    throw protocol_error(_("Shared memory is not sealed"));
+  }
+
+  if ((fstat(fd, &st) != 0) || (st.st_size < 0) ||
+      ((uintmax_t)st.st_size < length)) {
+    close(fd);
+    throw protocol_error(_("Shared memory is too small"));
+  }
+
+  // Only the server draws in the buffer
+  map(width, height, false);
+}
+
+SharedMemoryPixelBuffer::~SharedMemoryPixelBuffer()
+{
+  if (mapping != nullptr)
+    munmap(mapping, length);
+  close(fd);
+}
+
+void SharedMemoryPixelBuffer::map(int width, int height, bool writable)
+{
+  if (length == 0) {
+    setBuffer(width, height, nullptr, stride);
+    return;
+  }
+
+  mapping = (uint8_t*)mmap(nullptr, length,
+                           PROT_READ | (writable ? PROT_WRITE : 0),
+                           MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    int err = errno;
+    mapping = nullptr;
+    close(fd);
+    throw core::posix_error("mmap", err);
+  }
+
+  try {
+    setBuffer(width, height, mapping, stride);
+  } catch (std::exception&) {
+    munmap(mapping, length);
+    close(fd);
+    throw;
+  }
+}
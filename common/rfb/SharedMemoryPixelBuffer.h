@@ -0,0 +1,65 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// SharedMemoryPixelBuffer is a pixel buffer in memory that is shared
+// between the server and a viewer on the same machine, so that the
+// pixels don't have to be sent over the connection.
+//
+
+#ifndef __RFB_SHAREDMEMORYPIXELBUFFER_H__
+#define __RFB_SHAREDMEMORYPIXELBUFFER_H__
+
+#include <rfb/PixelBuffer.h>
+
+namespace rfb {
+
+  // Types of pseudoEncodingSharedMemory rects
+  enum SharedMemoryType {
+    // A new buffer, sent along with its file descriptor
+    sharedMemorySetup = 0,
+    // The given area has been updated in the buffer
+    sharedMemoryDamage = 1,
+  };
+
+  class SharedMemoryPixelBuffer : public FullFramePixelBuffer {
+  public:
+    // Creates a new shared memory area for the given format and size
+    SharedMemoryPixelBuffer(const PixelFormat& pf, int width, int height);
+    // Maps a shared memory area created by the other end, taking
+    // ownership of the file descriptor. The mapping is read only.
+    SharedMemoryPixelBuffer(int fd, const PixelFormat& pf,
+                            int width, int height, int stride);
+    virtual ~SharedMemoryPixelBuffer();
+
+    int getFd() const { return fd; }
+    int getStride() const { return stride; }
+
+  private:
+    void map(int width, int height, bool writable);
+
+  private:
+    int fd;
+    int stride;
+    uint8_t* mapping;
+    size_t length;
+  };
+
+}
+
+#endif
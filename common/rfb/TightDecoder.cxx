@@ -25,6 +25,7 @@
 
 #include <assert.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <core/i18n.h>
@@ -38,6 +39,7 @@
 #include <rfb/Exception.h>
 #include <rfb/JpegDecompressor.h>
 #include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormatSIMD.h>
 #include <rfb/TightConstants.h>
 #include <rfb/TightDecoder.h>
 
@@ -45,6 +47,9 @@ using namespace rfb;
 
 static const int TIGHT_MAX_WIDTH = 2048;
 static const int TIGHT_MIN_TO_COMPRESS = 12;
+// Rows of a gradient filtered rect that are decoded together, so
+// that they can be done in parallel
+static const int TIGHT_GRADIENT_ROWS = 4;
 
 TightDecoder::TightDecoder()
   : Decoder(DecoderPartiallyOrdered), readState(IDLE)
@@ -542,49 +547,77 @@ uint32_t TightDecoder::readCompact(rdr::InStream* is)
   return result;
 }
 
+// Reverses the gradient filter on rows of packed RGB, with prev being
+// the already decoded row above the first one
+static void filterGradientRows(uint8_t* dst, const uint8_t* diff,
+                               const uint8_t* prev, int width, int rows)
+{
+  int x, y, c;
+  size_t rowSize;
+
+  rowSize = width * 3;
+
+  y = simd::gradientRGB(dst, diff, prev, width, rows);
+  if (y > 0)
+    prev = dst + (y - 1) * rowSize;
+
+  for (; y < rows; y++) {
+    uint8_t* thisRow = dst + y * rowSize;
+    const uint8_t* src = diff + y * rowSize;
+
+    /* First pixel in a row */
+    for (c = 0; c < 3; c++)
+      thisRow[c] = src[c] + prev[c];
+
+    // The three channels are independent, so work on the row as
+    // bytes rather than as pixels
+    for (x = 3; x < width*3; x++) {
+      int est;
+
+      est = prev[x] + thisRow[x-3] - prev[x-3];
+      if (est > 0xff)
+        est = 0xff;
+      else if (est < 0)
+        est = 0;
+
+      thisRow[x] = src[x] + est;
+    }
+
+    prev = thisRow;
+  }
+}
+
 void
 TightDecoder::FilterGradient24(const uint8_t *inbuf,
                                const PixelFormat& pf, uint32_t* outbuf,
                                int stride, const core::Rect& r)
 {
-  int x, y, c;
-  uint8_t prevRow[TIGHT_MAX_WIDTH*3];
-  uint8_t thisRow[TIGHT_MAX_WIDTH*3];
-  uint8_t pix[3]; 
-  int est[3]; 
-
-  memset(prevRow, 0, sizeof(prevRow));
+  int y, i, rows;
+  // The previous row, followed by the block being decoded
+  uint8_t rowBuf[(TIGHT_GRADIENT_ROWS+1)*TIGHT_MAX_WIDTH*3];
+  uint8_t *prevRow, *thisRows;
 
   // Set up shortcut variables
   int rectHeight = r.height();
   int rectWidth = r.width();
+  size_t rowSize = rectWidth*3;
 
-  for (y = 0; y < rectHeight; y++) {
-    for (x = 0; x < rectWidth; x++) {
-      /* First pixel in a row */
-      if (x == 0) {
-        for (c = 0; c < 3; c++) {
-          pix[c] = inbuf[y*rectWidth*3+c] + prevRow[c];
-          thisRow[c] = pix[c];
-        }
-        pf.bufferFromRGB((uint8_t*)&outbuf[y*stride], pix, 1);
-        continue;
-      }
+  prevRow = rowBuf;
+  thisRows = rowBuf + rowSize;
 
-      for (c = 0; c < 3; c++) {
-        est[c] = prevRow[x*3+c] + pix[c] - prevRow[(x-1)*3+c];
-        if (est[c] > 0xff) {
-          est[c] = 0xff;
-        } else if (est[c] < 0) {
-          est[c] = 0;
-        }
-        pix[c] = inbuf[(y*rectWidth+x)*3+c] + est[c];
-        thisRow[x*3+c] = pix[c];
-      }
-      pf.bufferFromRGB((uint8_t*)&outbuf[y*stride+x], pix, 1);
-    }
+  memset(prevRow, 0, rowSize);
+
+  for (y = 0; y < rectHeight; y += rows) {
+    rows = std::min(rectHeight - y, TIGHT_GRADIENT_ROWS);
+
+    filterGradientRows(thisRows, &inbuf[y*rowSize], prevRow,
+                       rectWidth, rows);
+
+    for (i = 0; i < rows; i++)
+      pf.bufferFromRGB((uint8_t*)&outbuf[(y+i)*stride],
+                       &thisRows[i*rowSize], rectWidth);
 
-    memcpy(prevRow, thisRow, sizeof(prevRow));
+    memcpy(prevRow, &thisRows[(rows-1)*rowSize], rowSize);
   }
 }
 
@@ -593,52 +626,36 @@ void TightDecoder::FilterGradient(const uint8_t* inbuf,
                                   const PixelFormat& pf, T* outbuf,
                                   int stride, const core::Rect& r)
 {
-  int x, y, c;
-  static uint8_t prevRow[TIGHT_MAX_WIDTH*3];
-  static uint8_t thisRow[TIGHT_MAX_WIDTH*3];
-  uint8_t pix[3]; 
-  int est[3]; 
-
-  memset(prevRow, 0, sizeof(prevRow));
+  int y, i, rows;
+  uint8_t diffBuf[TIGHT_GRADIENT_ROWS*TIGHT_MAX_WIDTH*3];
+  // The previous row, followed by the block being decoded
+  uint8_t rowBuf[(TIGHT_GRADIENT_ROWS+1)*TIGHT_MAX_WIDTH*3];
+  uint8_t *prevRow, *thisRows;
 
   // Set up shortcut variables
   int rectHeight = r.height();
   int rectWidth = r.width();
+  size_t rowSize = rectWidth*3;
 
-  for (y = 0; y < rectHeight; y++) {
-    for (x = 0; x < rectWidth; x++) {
-      /* First pixel in a row */
-      if (x == 0) {
-        pf.rgbFromBuffer(pix, &inbuf[y*rectWidth], 1);
-        for (c = 0; c < 3; c++)
-          pix[c] += prevRow[c];
-
-        memcpy(thisRow, pix, sizeof(pix));
-
-        pf.bufferFromRGB((uint8_t*)&outbuf[y*stride], pix, 1);
+  prevRow = rowBuf;
+  thisRows = rowBuf + rowSize;
 
-        continue;
-      }
+  memset(prevRow, 0, rowSize);
 
-      for (c = 0; c < 3; c++) {
-        est[c] = prevRow[x*3+c] + pix[c] - prevRow[(x-1)*3+c];
-        if (est[c] > 255) {
-          est[c] = 255;
-        } else if (est[c] < 0) {
-          est[c] = 0;
-        }
-      }
+  for (y = 0; y < rectHeight; y += rows) {
+    rows = std::min(rectHeight - y, TIGHT_GRADIENT_ROWS);
 
-      pf.rgbFromBuffer(pix, &inbuf[y*rectWidth+x], 1);
-      for (c = 0; c < 3; c++)
-        pix[c] += est[c];
+    // Unpack the differences for the entire block first
+    pf.rgbFromBuffer(diffBuf, &inbuf[y*rectWidth*sizeof(T)],
+                     rectWidth*rows);
 
-      memcpy(&thisRow[x*3], pix, sizeof(pix));
+    filterGradientRows(thisRows, diffBuf, prevRow, rectWidth, rows);
 
-      pf.bufferFromRGB((uint8_t*)&outbuf[y*stride+x], pix, 1);
-    }
+    for (i = 0; i < rows; i++)
+      pf.bufferFromRGB((uint8_t*)&outbuf[(y+i)*stride],
+                       &thisRows[i*rowSize], rectWidth);
 
-    memcpy(prevRow, thisRow, sizeof(prevRow));
+    memcpy(prevRow, &thisRows[(rows-1)*rowSize], rowSize);
   }
 }
 
@@ -653,13 +670,20 @@ void TightDecoder::FilterPalette(const T* palette, int palSize,
   uint8_t bits;
   const uint8_t* srcPtr = inbuf;
   if (palSize <= 2) {
-    // 2-color palette
+    // 2-color palette, expanded four pixels at a time
+    T table[16][4];
+
+    for (x = 0; x < 16; x++) {
+      for (b = 0; b < 4; b++)
+        table[x][b] = palette[x >> (3 - b) & 1];
+    }
+
     while (h > 0) {
       for (x = 0; x < w / 8; x++) {
         bits = *srcPtr++;
-        for (b = 7; b >= 0; b--) {
-          *ptr++ = palette[bits >> b & 1];
-        }
+        memcpy(ptr, table[bits >> 4], sizeof(table[0]));
+        memcpy(ptr + 4, table[bits & 0xf], sizeof(table[0]));
+        ptr += 8;
       }
       if (w % 8 != 0) {
         bits = *srcPtr++;
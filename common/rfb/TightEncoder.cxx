@@ -63,7 +63,7 @@ static const TightConf conf[10] = {
 };
 
 TightEncoder::TightEncoder(SConnection* conn_) :
-  Encoder(conn_, encodingTight, EncoderPlain, 256)
+  Encoder(conn_, encodingTight, EncoderPlain, 256), pendingResets(0)
 {
   setCompressLevel(-1);
 }
@@ -87,6 +87,31 @@ void TightEncoder::setCompressLevel(int level)
   rawZlibLevel = conf[level].rawZlibLevel;
 }
 
+size_t TightEncoder::getMemoryUsage()
+{
+  size_t usage;
+
+  usage = memStream.capacity();
+  for (rdr::ZlibOutStream& zos : zlibStreams)
+    usage += zos.getMemoryUsage();
+
+  return usage;
+}
+
+void TightEncoder::releaseMemory()
+{
+  // The client has to reset its streams as well, which it will be
+  // told to with the next rect we send
+  for (int i = 0; i < 4; i++) {
+    if (zlibStreams[i].getMemoryUsage() == 0)
+      continue;
+    zlibStreams[i].reset();
+    pendingResets |= 1 << i;
+  }
+
+  memStream.shrink();
+}
+
 void TightEncoder::writeRect(const PixelBuffer* pb, const Palette& palette)
 {
   assert(pb->width() <= TIGHT_MAX_WIDTH);
@@ -116,7 +141,7 @@ void TightEncoder::writeSolidRect(int width, int /*height*/,
 
   os = conn->getOutStream();
 
-  os->writeU8(tightFill << 4);
+  writeCompressionControl(os, tightFill);
   writePixels(colour, pf, 1, os);
 }
 
@@ -177,7 +202,7 @@ void TightEncoder::writeFullColourRect(const PixelBuffer* pb)
 
   os = conn->getOutStream();
 
-  os->writeU8(streamId << 4);
+  writeCompressionControl(os, streamId);
 
   // Set up compression
   if ((pb->getPF().bpp != 32) || !pb->getPF().is888())
@@ -225,6 +250,13 @@ void TightEncoder::writePixels(const uint8_t* buffer, const PixelFormat& pf,
   }
 }
 
+void TightEncoder::writeCompressionControl(rdr::OutStream* os,
+                                           unsigned int control)
+{
+  os->writeU8((control << 4) | pendingResets);
+  pendingResets = 0;
+}
+
 void TightEncoder::writeCompact(rdr::OutStream* os, uint32_t value)
 {
   uint8_t b;
@@ -298,7 +330,7 @@ void TightEncoder::writeMonoRect(int width, int height,
 
   os = conn->getOutStream();
 
-  os->writeU8((streamId | tightExplicitFilter) << 4);
+  writeCompressionControl(os, streamId | tightExplicitFilter);
   os->writeU8(tightFilterPalette);
 
   // Write the palette
@@ -385,7 +417,7 @@ void TightEncoder::writeIndexedRect(int width, int height,
 
   os = conn->getOutStream();
 
-  os->writeU8((streamId | tightExplicitFilter) << 4);
+  writeCompressionControl(os, streamId | tightExplicitFilter);
   os->writeU8(tightFilterPalette);
 
   // Write the palette
@@ -35,6 +35,9 @@ namespace rfb {
 
     void setCompressLevel(int level) override;
 
+    size_t getMemoryUsage() override;
+    void releaseMemory() override;
+
     void writeRect(const PixelBuffer* pb,
                    const Palette& palette) override;
     void writeSolidRect(int width, int height, const PixelFormat& pf,
@@ -48,6 +51,8 @@ namespace rfb {
     void writePixels(const uint8_t* buffer, const PixelFormat& pf,
                      unsigned int count, rdr::OutStream* os);
 
+    void writeCompressionControl(rdr::OutStream* os,
+                                 unsigned int control);
     void writeCompact(rdr::OutStream* os, uint32_t value);
 
     rdr::OutStream* getZlibOutStream(int streamId, int level, size_t length);
@@ -67,6 +72,9 @@ namespace rfb {
     rdr::ZlibOutStream zlibStreams[4];
     rdr::MemOutStream memStream;
 
+    // Streams the client has to reset before they are used again
+    unsigned int pendingResets;
+
     int idxZlibLevel, monoZlibLevel, rawZlibLevel;
   };
 
@@ -78,6 +78,16 @@ int TightJPEGEncoder::getQualityLevel()
   return jc.getQualityLevel();
 }
 
+size_t TightJPEGEncoder::getMemoryUsage()
+{
+  return jc.capacity();
+}
+
+void TightJPEGEncoder::releaseMemory()
+{
+  jc.shrink();
+}
+
 void TightJPEGEncoder::writeRect(const PixelBuffer* pb,
                                  const Palette& /*palette*/)
 {
@@ -0,0 +1,170 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+
+#include <core/Rect.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/TileCache.h>
+
+using namespace rfb;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+// Mixing steps from MurmurHash3, which is fast and good enough to
+// make accidental collisions practically impossible
+static inline uint64_t mixBlock(uint64_t h, uint64_t k)
+{
+  k *= 0x87c37b91114253d5ULL;
+  k = rotl64(k, 31);
+  k *= 0x4cf5ad432745937fULL;
+
+  h ^= k;
+  h = rotl64(h, 27);
+  return h * 5 + 0x52dce729;
+}
+
+static inline uint64_t finalMix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+TileCache::TileCache() : pixels(0)
+{
+}
+
+TileCache::~TileCache()
+{
+}
+
+TileCache::Tile* TileCache::lookup(uint64_t hash)
+{
+  std::unordered_map<uint64_t, std::list<Tile>::iterator>::iterator iter;
+
+  iter = index.find(hash);
+  if (iter == index.end())
+    return nullptr;
+
+  tiles.splice(tiles.begin(), tiles, iter->second);
+
+  return &tiles.front();
+}
+
+const TileCache::Tile* TileCache::peek(uint64_t hash) const
+{
+  std::unordered_map<uint64_t, std::list<Tile>::iterator>::const_iterator iter;
+
+  iter = index.find(hash);
+  if (iter == index.end())
+    return nullptr;
+
+  return &*iter->second;
+}
+
+TileCache::Tile* TileCache::insert(uint64_t hash, int width, int height)
+{
+  std::unordered_map<uint64_t, std::list<Tile>::iterator>::iterator iter;
+  size_t area;
+
+  area = (size_t)width * height;
+  assert(area <= maxPixels);
+
+  iter = index.find(hash);
+  if (iter != index.end()) {
+    pixels -= (size_t)iter->second->width * iter->second->height;
+    tiles.erase(iter->second);
+    index.erase(iter);
+  }
+
+  while ((pixels + area) > maxPixels) {
+    Tile* oldest;
+
+    oldest = &tiles.back();
+    pixels -= (size_t)oldest->width * oldest->height;
+    index.erase(oldest->hash);
+    tiles.pop_back();
+  }
+
+  tiles.emplace_front();
+  index[hash] = tiles.begin();
+  pixels += area;
+
+  tiles.front().hash = hash;
+  tiles.front().width = width;
+  tiles.front().height = height;
+  tiles.front().lossy = false;
+
+  return &tiles.front();
+}
+
+void TileCache::clear()
+{
+  tiles.clear();
+  index.clear();
+  pixels = 0;
+}
+
+uint64_t TileCache::hashRect(const PixelBuffer* pb, const core::Rect& r)
+{
+  const uint8_t* buffer;
+  int stride;
+  size_t rowLen;
+  uint64_t h;
+
+  buffer = pb->getBuffer(r, &stride);
+  stride *= pb->getPF().bpp / 8;
+  rowLen = r.width() * (pb->getPF().bpp / 8);
+
+  h = mixBlock(0, ((uint64_t)r.width() << 32) | r.height());
+
+  for (int y = 0; y < r.height(); y++) {
+    const uint8_t* row;
+    size_t i;
+
+    row = buffer + y * stride;
+
+    for (i = 0; i + 8 <= rowLen; i += 8) {
+      uint64_t k;
+      memcpy(&k, row + i, 8);
+      h = mixBlock(h, k);
+    }
+
+    if (i < rowLen) {
+      uint64_t k;
+      k = 0;
+      memcpy(&k, row + i, rowLen - i);
+      h = mixBlock(h, k);
+    }
+  }
+
+  return finalMix(h ^ (rowLen * r.height()));
+}
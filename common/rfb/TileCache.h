@@ -0,0 +1,101 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+//
+// TileCache is a least recently used cache of rectangles, indexed by a
+// hash of their contents. The server and the viewer each keep one and
+// perform the exact same operations on them, so the server always
+// knows which tiles the viewer has.
+//
+
+#ifndef __RFB_TILECACHE_H__
+#define __RFB_TILECACHE_H__
+
+#include <stdint.h>
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <rfb/PixelFormat.h>
+
+namespace core { struct Rect; }
+
+namespace rfb {
+
+  class PixelBuffer;
+
+  // Operations in an encodingTileCache rect
+  enum TileCacheOp {
+    tileCacheStore = 0,
+    tileCacheLoad = 1,
+    tileCacheClear = 2,
+  };
+
+  class TileCache {
+  public:
+    TileCache();
+    ~TileCache();
+
+    struct Tile {
+      uint64_t hash;
+      int width, height;
+      bool lossy;
+
+      // Only used by the viewer
+      PixelFormat pf;
+      std::vector<uint8_t> data;
+    };
+
+    // lookup() returns the tile with the given hash, or nullptr if
+    // there is no such tile. The tile is marked as recently used.
+    Tile* lookup(uint64_t hash);
+
+    // peek() is like lookup(), but doesn't mark the tile as used
+    const Tile* peek(uint64_t hash) const;
+
+    // insert() adds a tile with the given hash, replacing any existing
+    // one. The least recently used tiles are evicted to make room.
+    Tile* insert(uint64_t hash, int width, int height);
+
+    void clear();
+
+    size_t numTiles() const { return tiles.size(); }
+    size_t numPixels() const { return pixels; }
+
+    // hashRect() returns the hash used for the given area of a pixel
+    // buffer
+    static uint64_t hashRect(const PixelBuffer* pb, const core::Rect& r);
+
+  public:
+    // The total size of all tiles, which both sides must agree on
+    static const size_t maxPixels = 8 * 1024 * 1024;
+
+    // Smaller areas are not worth caching
+    static const int minArea = 64 * 64;
+
+  private:
+    // Most recently used first
+    std::list<Tile> tiles;
+    std::unordered_map<uint64_t, std::list<Tile>::iterator> index;
+    size_t pixels;
+  };
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <core/i18n.h>
+
+#include <rdr/InStream.h>
+#include <rdr/MemInStream.h>
+#include <rdr/OutStream.h>
+
+#include <rfb/Exception.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/TileCacheDecoder.h>
+
+using namespace rfb;
+
+// The cache operations must be applied in the same order as the server
+// applied them, as otherwise the eviction of old tiles will differ
+TileCacheDecoder::TileCacheDecoder() : Decoder(DecoderOrdered)
+{
+}
+
+TileCacheDecoder::~TileCacheDecoder()
+{
+}
+
+bool TileCacheDecoder::readRect(const core::Rect& r, rdr::InStream* is,
+                                const ServerParams& /*server*/,
+                                rdr::OutStream* os)
+{
+  uint8_t op;
+
+  if (!is->hasData(1 + 8))
+    return false;
+
+  op = is->readU8();
+  switch (op) {
+  case tileCacheStore:
+  case tileCacheLoad:
+    if (r.is_empty() || ((size_t)r.area() > TileCache::maxPixels))
+      throw protocol_error(_("Invalid cached tile size"));
+    break;
+  case tileCacheClear:
+    break;
+  default:
+    throw protocol_error(_("Invalid tile cache operation"));
+  }
+
+  os->writeU8(op);
+  os->copyBytes(is, 8);
+
+  return true;
+}
+
+void TileCacheDecoder::decodeRect(const core::Rect& r,
+                                  const uint8_t* buffer,
+                                  size_t buflen,
+                                  const ServerParams& /*server*/,
+                                  ModifiablePixelBuffer* pb)
+{
+  rdr::MemInStream is(buffer, buflen);
+  uint8_t op;
+  uint64_t hash;
+  TileCache::Tile* tile;
+  const uint8_t* data;
+  int stride, bpp;
+
+  op = is.readU8();
+  hash = (uint64_t)is.readU32() << 32;
+  hash |= is.readU32();
+
+  switch (op) {
+  case tileCacheStore:
+    tile = cache.insert(hash, r.width(), r.height());
+
+    bpp = pb->getPF().bpp / 8;
+    tile->pf = pb->getPF();
+    tile->data.resize(r.area() * bpp);
+
+    data = pb->getBuffer(r, &stride);
+    for (int y = 0; y < r.height(); y++) {
+      memcpy(tile->data.data() + y * r.width() * bpp,
+             data + y * stride * bpp, r.width() * bpp);
+    }
+    break;
+  case tileCacheLoad:
+    tile = cache.lookup(hash);
+    if (tile == nullptr)
+      throw protocol_error(_("Unknown cached tile"));
+    if ((tile->width != r.width()) || (tile->height != r.height()))
+      throw protocol_error(_("Cached tile size mismatch"));
+
+    pb->imageRect(tile->pf, r, tile->data.data());
+    break;
+  case tileCacheClear:
+    cache.clear();
+    break;
+  }
+}
@@ -24,6 +24,8 @@
 
 #include <assert.h>
 
+#include <algorithm>
+
 #include <core/LogWriter.h>
 #include <core/i18n.h>
 #include <core/string.h>
@@ -33,14 +35,18 @@
 #include <rdr/FdOutStream.h>
 
 #include <network/TcpSocket.h>
+#include <network/UnixSocket.h>
 
 #include <rfb/ComparingUpdateTracker.h>
+#include <rfb/ShadowPixelBuffer.h>
 #include <rfb/Encoder.h>
 #include <rfb/Exception.h>
 #include <rfb/KeyRemapper.h>
 #include <rfb/KeysymStr.h>
+#include <rfb/ScaledPixelBuffer.h>
 #include <rfb/Security.h>
 #include <rfb/ServerCore.h>
+#include <rfb/SharedMemoryPixelBuffer.h>
 #include <rfb/SMsgWriter.h>
 #include <rfb/VNCServerST.h>
 #include <rfb/VNCSConnectionST.h>
@@ -71,9 +77,11 @@ VNCSConnectionST::VNCSConnectionST(VNCServerST* server_, network::Socket *s,
     inProcessMessages(false),
     pendingSyncFence(false), syncFence(false), fenceFlags(0),
     fenceDataLen(0), fenceData(nullptr), congestionTimer(this),
-    losslessTimer(this), server(server_),
+    losslessTimer(this), clipboardTimer(this), server(server_),
     updateRenderedCursor(false), removeRenderedCursor(false),
-    continuousUpdates(false), encodeManager(this), idleTimer(this),
+    continuousUpdates(false), encodeManager(this),
+    sharedFramebuffer(nullptr), sharedMemoryFailed(false),
+    shadowPixelBuffer(nullptr), idleTimer(this),
     pointerEventTime(0), clientHasCursor(false)
 {
   socketTimer.start(core::secsToMillis(LOGIN_GRACE_TIME));
@@ -104,6 +112,10 @@ VNCSConnectionST::~VNCSConnectionST()
   }
 
   delete [] fenceData;
+  delete sharedFramebuffer;
+
+  if (shadowPixelBuffer != nullptr)
+    server->releaseShadowPixelBuffer(shadowPixelBuffer);
 }
 
 
@@ -121,6 +133,8 @@ bool VNCSConnectionST::accessCheck(AccessRights ar) const
 
 void VNCSConnectionST::close(const char* reason)
 {
+  waitForEncode();
+
   SConnection::close(reason);
 
   // Log the reason for the close
@@ -153,6 +167,10 @@ bool VNCSConnectionST::init()
 
 void VNCSConnectionST::processSocketReadEvent()
 {
+  // Most messages don't write anything, so we only wait for any
+  // update on the encoding thread in the handlers that do. Until then
+  // the output stream belongs to the encoding thread.
+
   // Are we flushing remaining incoming data?
   if (state() == RFBSTATE_CLOSING) {
     assert(getSock()->isShutdownWrite());
@@ -183,7 +201,8 @@ void VNCSConnectionST::processSocketReadEvent()
 
     // Get the underlying transport to build large packets if we send
     // multiple small responses.
-    getOutStream()->cork(true);
+    if (!server->isEncoding(this))
+      getOutStream()->cork(true);
 
     while (true) {
       if (pendingSyncFence)
@@ -193,6 +212,7 @@ void VNCSConnectionST::processSocketReadEvent()
         break;
 
       if (syncFence) {
+        waitForEncode();
         writer()->writeFence(fenceFlags, fenceDataLen, fenceData);
         syncFence = false;
         pendingSyncFence = false;
@@ -200,7 +220,8 @@ void VNCSConnectionST::processSocketReadEvent()
     }
 
     // Flush out everything in case we go idle after this.
-    getOutStream()->cork(false);
+    if (!server->isEncoding(this))
+      getOutStream()->cork(false);
 
     inProcessMessages = false;
 
@@ -217,6 +238,8 @@ void VNCSConnectionST::processSocketReadEvent()
 
 void VNCSConnectionST::processSocketWriteEvent()
 {
+  waitForEncode();
+
   if (state() == RFBSTATE_CLOSING) return;
   try {
     sock->outStream().flush();
@@ -232,11 +255,16 @@ void VNCSConnectionST::processSocketWriteEvent()
 void VNCSConnectionST::pixelBufferChange()
 {
   try {
+    core::Rect clientRect;
+
     if (state() != RFBSTATE_NORMAL)
       return;
+
+    clientRect = ScaledPixelBuffer::scaleRect(server->getPixelBuffer()->getRect(),
+                                              client.scaleFactor);
     if (client.width() && client.height() &&
-        (server->getPixelBuffer()->width() != client.width() ||
-         server->getPixelBuffer()->height() != client.height()))
+        (clientRect.width() != client.width() ||
+         clientRect.height() != client.height()))
     {
       // We need to clip the next update to the new size, but also add any
       // extra bits if it's bigger.  If we wanted to do this exactly, something
@@ -255,9 +283,7 @@ void VNCSConnectionST::pixelBufferChange()
 
       damagedCursorRegion.assign_intersect(server->getPixelBuffer()->getRect());
 
-      client.setDimensions(server->getPixelBuffer()->width(),
-                           server->getPixelBuffer()->height(),
-                           server->getScreenLayout());
+      setClientDimensions();
       if (state() == RFBSTATE_NORMAL) {
         if (!client.supportsDesktopSize()) {
           close(_("Client does not support resizing the desktop"));
@@ -290,6 +316,8 @@ void VNCSConnectionST::writeFramebufferUpdateOrClose()
 
 void VNCSConnectionST::screenLayoutChangeOrClose(uint16_t reason)
 {
+  waitForEncode();
+
   try {
     screenLayoutChange(reason);
     writeFramebufferUpdate();
@@ -300,6 +328,8 @@ void VNCSConnectionST::screenLayoutChangeOrClose(uint16_t reason)
 
 void VNCSConnectionST::bellOrClose()
 {
+  waitForEncode();
+
   try {
     if (state() == RFBSTATE_NORMAL) writer()->writeBell();
   } catch(std::exception& e) {
@@ -309,6 +339,8 @@ void VNCSConnectionST::bellOrClose()
 
 void VNCSConnectionST::setDesktopNameOrClose(const char *name)
 {
+  waitForEncode();
+
   try {
     setDesktopName(name);
     writeFramebufferUpdate();
@@ -319,6 +351,8 @@ void VNCSConnectionST::setDesktopNameOrClose(const char *name)
 
 void VNCSConnectionST::setCursorOrClose()
 {
+  waitForEncode();
+
   try {
     setCursor();
     writeFramebufferUpdate();
@@ -329,6 +363,8 @@ void VNCSConnectionST::setCursorOrClose()
 
 void VNCSConnectionST::setLEDStateOrClose(unsigned int state)
 {
+  waitForEncode();
+
   try {
     setLEDState(state);
     writeFramebufferUpdate();
@@ -339,6 +375,8 @@ void VNCSConnectionST::setLEDStateOrClose(unsigned int state)
 
 void VNCSConnectionST::requestClipboardOrClose()
 {
+  waitForEncode();
+
   try {
     if (state() != RFBSTATE_NORMAL) return;
     requestClipboard();
@@ -349,6 +387,8 @@ void VNCSConnectionST::requestClipboardOrClose()
 
 void VNCSConnectionST::announceClipboardOrClose(bool available)
 {
+  waitForEncode();
+
   try {
     if (state() != RFBSTATE_NORMAL) return;
     announceClipboard(available);
@@ -359,9 +399,29 @@ void VNCSConnectionST::announceClipboardOrClose(bool available)
 
 void VNCSConnectionST::sendClipboardDataOrClose(const char* data)
 {
+  waitForEncode();
+
   try {
     if (state() != RFBSTATE_NORMAL) return;
     sendClipboardData(data);
+    if (clipboardDataPending())
+      clipboardTimer.start(0);
+  } catch(std::exception& e) {
+    close(e.what());
+  }
+}
+
+void VNCSConnectionST::abortClipboardDataOrClose()
+{
+  if (!clipboardDataPending())
+    return;
+
+  waitForEncode();
+
+  // No state check, as the transfer must be stopped before the data
+  // goes away even if we are closing
+  try {
+    abortClipboardData();
   } catch(std::exception& e) {
     close(e.what());
   }
@@ -377,6 +437,24 @@ void VNCSConnectionST::desktopReadyOrClose()
   }
 }
 
+void VNCSConnectionST::encodeDoneOrClose()
+{
+  // Everything that writeDataUpdate() and writeFramebufferUpdate()
+  // had left to do once the update was written
+  try {
+    writeRTTPing();
+
+    getOutStream()->cork(false);
+
+    congestion.updatePosition(sock->outStream().length());
+    congestion.updateTCPInfo(sock->getFd());
+
+    writeClipboardUpdate();
+  } catch(std::exception& e) {
+    close(e.what());
+  }
+}
+
 bool VNCSConnectionST::getComparerState()
 {
   // We interpret a low compression level as an indication that the client
@@ -411,6 +489,7 @@ void VNCSConnectionST::renderedCursorChange()
 
 void VNCSConnectionST::cursorPositionChange()
 {
+  waitForEncode();
   setCursorPos();
 }
 
@@ -444,9 +523,7 @@ void VNCSConnectionST::desktopReady()
     return;
 
   // - Set the connection parameters appropriately
-  client.setDimensions(server->getPixelBuffer()->width(),
-                       server->getPixelBuffer()->height(),
-                       server->getScreenLayout());
+  setClientDimensions();
   client.setName(server->getName());
   client.setLEDState(server->getLEDState());
   
@@ -481,6 +558,11 @@ void VNCSConnectionST::authSuccess()
 {
   socketTimer.stop();
 
+  // Not before now, as the security handshake might have written
+  // directly to the socket
+  if (rfb::Server::threadedOutput)
+    sock->outStream().startWriter();
+
   if (rfb::Server::idleTimeout)
     idleTimer.start(core::secsToMillis(rfb::Server::idleTimeout));
 }
@@ -506,6 +588,8 @@ void VNCSConnectionST::clientReady(bool shared)
 
 void VNCSConnectionST::setPixelFormat(const PixelFormat& pf)
 {
+  waitForEncode();
+
   SConnection::setPixelFormat(pf);
   char buffer[256];
   pf.print(buffer, 256);
@@ -514,6 +598,21 @@ void VNCSConnectionST::setPixelFormat(const PixelFormat& pf)
   encodeManager.forceRefresh(server->getPixelBuffer()->getRect());
 }
 
+void VNCSConnectionST::setEncodings(int nEncodings,
+                                    const int32_t* encodings)
+{
+  int oldScaleFactor;
+
+  waitForEncode();
+
+  oldScaleFactor = client.scaleFactor;
+
+  SConnection::setEncodings(nEncodings, encodings);
+
+  if (client.scaleFactor != oldScaleFactor)
+    scaleFactorChange();
+}
+
 void VNCSConnectionST::pointerEvent(const core::Point& pos,
                                     uint16_t buttonMask)
 {
@@ -522,6 +621,21 @@ void VNCSConnectionST::pointerEvent(const core::Point& pos,
   pointerEventTime = time(nullptr);
   if (!accessCheck(AccessPtrEvents)) return;
   pointerEventPos = pos;
+  if (client.scaleFactor > 1) {
+    const PixelBuffer* pb;
+    int scale;
+
+    pb = server->getPixelBuffer();
+    scale = client.scaleFactor;
+
+    // Aim for the middle of the pixels that the client sees
+    pointerEventPos.x = pos.x * scale + scale / 2;
+    pointerEventPos.y = pos.y * scale + scale / 2;
+    if (pointerEventPos.x >= pb->width())
+      pointerEventPos.x = pb->width() - 1;
+    if (pointerEventPos.y >= pb->height())
+      pointerEventPos.y = pb->height() - 1;
+  }
   server->pointerEvent(this, pointerEventPos, buttonMask);
 }
 
@@ -663,6 +777,10 @@ void VNCSConnectionST::framebufferUpdateRequest(const core::Rect& r,
 
   if (!accessCheck(AccessView)) return;
 
+  // Only these might write something (the layout, or a colour map)
+  if (!incremental || !client.pf().trueColour)
+    waitForEncode();
+
   SConnection::framebufferUpdateRequest(r, incremental);
 
   // Check that the client isn't sending crappy requests
@@ -678,7 +796,7 @@ void VNCSConnectionST::framebufferUpdateRequest(const core::Rect& r,
 
   // Just update the requested region.
   // Framebuffer update will be sent a bit later, see processMessages().
-  core::Region reqRgn(safeRect);
+  core::Region reqRgn(clientToServer(safeRect));
   if (!incremental || !continuousUpdates)
     requested.assign_union(reqRgn);
 
@@ -703,19 +821,34 @@ void VNCSConnectionST::setDesktopSize(int fb_width, int fb_height,
 {
   unsigned int result;
   char buffer[2048];
+  ScreenSet serverLayout;
 
   vlog.debug("Got request for framebuffer resize to %dx%d",
              fb_width, fb_height);
   layout.print(buffer, sizeof(buffer));
   vlog.debug("%s", buffer);
 
+  // The client asks for a size in its own scaled down coordinates
+  serverLayout = layout;
+  if (client.scaleFactor > 1) {
+    fb_width *= client.scaleFactor;
+    fb_height *= client.scaleFactor;
+    for (Screen& screen : serverLayout) {
+      screen.dimensions = ScaledPixelBuffer::unscaleRect(screen.dimensions,
+                                                         client.scaleFactor);
+    }
+  }
+
   if (!accessCheck(AccessSetDesktopSize)) {
     vlog.debug("Rejecting unauthorized framebuffer resize request");
     result = resultProhibited;
   } else {
-    result = server->setDesktopSize(this, fb_width, fb_height, layout);
+    result = server->setDesktopSize(this, fb_width, fb_height,
+                                    serverLayout);
   }
 
+  waitForEncode();
+
   writer()->writeDesktopSize(reasonClient, result);
 }
 
@@ -742,6 +875,8 @@ void VNCSConnectionST::fence(uint32_t flags, unsigned len, const uint8_t data[])
     // We handle everything synchronously so we trivially honor these modes
     flags = flags & (fenceFlagBlockBefore | fenceFlagBlockAfter);
 
+    waitForEncode();
+
     writer()->writeFence(flags, len, data);
     return;
   }
@@ -780,15 +915,22 @@ void VNCSConnectionST::enableContinuousUpdates(bool enable,
   continuousUpdates = enable;
 
   rect.setXYWH(x, y, w, h);
-  cuRegion.reset(rect);
+  cuRegion.reset(clientToServer(rect));
 
   if (enable) {
     requested.clear();
   } else {
+    waitForEncode();
     writer()->writeEndOfContinuousUpdates();
   }
 }
 
+void VNCSConnectionST::handleClipboardPeek()
+{
+  waitForEncode();
+  SConnection::handleClipboardPeek();
+}
+
 void VNCSConnectionST::handleClipboardRequest()
 {
   server->handleClipboardRequest(this);
@@ -852,7 +994,8 @@ void VNCSConnectionST::handleTimeout(core::Timer* t)
 
   try {
     if ((t == &congestionTimer) ||
-        (t == &losslessTimer))
+        (t == &losslessTimer) ||
+        (t == &clipboardTimer))
       writeFramebufferUpdate();
   } catch (std::exception& e) {
     close(e.what());
@@ -862,6 +1005,40 @@ void VNCSConnectionST::handleTimeout(core::Timer* t)
     close(_("Idle for too long"));
 }
 
+ScreenSet VNCSConnectionST::clientScreenLayout()
+{
+  ScreenSet layout;
+
+  layout = server->getScreenLayout();
+  if (client.scaleFactor == 1)
+    return layout;
+
+  for (Screen& screen : layout) {
+    screen.dimensions = ScaledPixelBuffer::scaleRect(screen.dimensions,
+                                                     client.scaleFactor);
+  }
+
+  return layout;
+}
+
+void VNCSConnectionST::setClientDimensions()
+{
+  core::Rect rect;
+
+  rect = ScaledPixelBuffer::scaleRect(server->getPixelBuffer()->getRect(),
+                                      client.scaleFactor);
+  client.setDimensions(rect.width(), rect.height(),
+                       clientScreenLayout());
+}
+
+core::Rect VNCSConnectionST::clientToServer(const core::Rect& r)
+{
+  core::Rect rect;
+
+  rect = ScaledPixelBuffer::unscaleRect(r, client.scaleFactor);
+  return rect.intersect(server->getPixelBuffer()->getRect());
+}
+
 bool VNCSConnectionST::isShiftPressed()
 {
     std::map<uint32_t, uint32_t>::const_iterator iter;
@@ -876,6 +1053,12 @@ bool VNCSConnectionST::isShiftPressed()
   return false;
 }
 
+void VNCSConnectionST::waitForEncode()
+{
+  if (server->isEncoding(this))
+    server->finishEncode();
+}
+
 void VNCSConnectionST::writeRTTPing()
 {
   uint8_t type;
@@ -884,6 +1067,7 @@ void VNCSConnectionST::writeRTTPing()
     return;
 
   congestion.updatePosition(sock->outStream().length());
+  congestion.updateTCPInfo(sock->getFd());
 
   // We need to make sure any old update are already processed by the
   // time we get the response back. This allows us to reliably throttle
@@ -897,6 +1081,7 @@ void VNCSConnectionST::writeRTTPing()
 
 bool VNCSConnectionST::isCongested()
 {
+  size_t queued;
   int eta;
 
   congestionTimer.stop();
@@ -907,10 +1092,20 @@ bool VNCSConnectionST::isCongested()
   if (sock->outStream().hasBufferedData())
     return true;
 
-  if (!client.supportsFence())
-    return false;
+  // Or waiting for the writer thread? It won't tell us when it is
+  // done, so make a guess based on the bandwidth.
+  queued = sock->outStream().queuedData();
+  if (queued > 0) {
+    queued = queued * 1000 / (congestion.getBandwidth() + 1);
+    eta = std::min(queued, (size_t)1000);
+    congestionTimer.start(std::max(eta, 1));
+    return true;
+  }
 
+  // Clients without fences can still be handled if the kernel can
+  // tell us what is going on with the connection
   congestion.updatePosition(sock->outStream().length());
+  congestion.updateTCPInfo(sock->getFd());
   if (!congestion.isCongested())
     return false;
 
@@ -924,7 +1119,13 @@ bool VNCSConnectionST::isCongested()
 
 void VNCSConnectionST::writeFramebufferUpdate()
 {
+  // Only one update can be encoded on the encoding thread at a time,
+  // and we'll get another chance once it is done
+  if (server->isEncoding())
+    return;
+
   congestion.updatePosition(sock->outStream().length());
+  congestion.updateTCPInfo(sock->getFd());
 
   // We're in the middle of processing a command that's supposed to be
   // synchronised. Allowing an update to slip out right now might violate
@@ -940,8 +1141,10 @@ void VNCSConnectionST::writeFramebufferUpdate()
 
   if (state() != RFBSTATE_NORMAL)
     return;
-  if (requested.is_empty() && !continuousUpdates)
+  if (requested.is_empty() && !continuousUpdates) {
+    writeClipboardUpdate();
     return;
+  }
 
   // Check that we actually have some space on the link and retry in a
   // bit if things are congested.
@@ -959,11 +1162,42 @@ void VNCSConnectionST::writeFramebufferUpdate()
   writeNoDataUpdate();
 
   // Then real data (if possible)
+  updateShadowPixelBuffer();
   writeDataUpdate();
 
+  // The rest is done by encodeDoneOrClose() if the update went to the
+  // encoding thread
+  if (server->isEncoding(this))
+    return;
+
   getOutStream()->cork(false);
 
   congestion.updatePosition(sock->outStream().length());
+  congestion.updateTCPInfo(sock->getFd());
+
+  // Any clipboard data gets whatever room is left after the update
+  writeClipboardUpdate();
+}
+
+void VNCSConnectionST::writeClipboardUpdate()
+{
+  if (!clipboardDataPending())
+    return;
+
+  if (isCongested())
+    return;
+
+  writeClipboardData();
+
+  congestion.updatePosition(sock->outStream().length());
+  congestion.updateTCPInfo(sock->getFd());
+
+  // We'll get called again if the link fills up, but otherwise we
+  // need to wake ourselves up to continue
+  if (clipboardDataPending())
+    clipboardTimer.start(0);
+  else
+    server->handleClipboardDataSent();
 }
 
 void VNCSConnectionST::writeNoDataUpdate()
@@ -1078,7 +1312,20 @@ void VNCSConnectionST::writeDataUpdate()
 
   writeRTTPing();
 
-  encodeManager.writeUpdate(ui, server->getPixelBuffer(), cursor);
+  if (useSharedMemory()) {
+    writeSharedMemoryUpdate(ui, cursor);
+  } else {
+    delete sharedFramebuffer;
+    sharedFramebuffer = nullptr;
+
+    if (server->startEncode(this, &encodeManager, ui, cursor)) {
+      updates.subtract(req);
+      requested.clear();
+      return;
+    }
+
+    encodeManager.writeUpdate(ui, server->getUpdateBuffer(), cursor);
+  }
 
   writeRTTPing();
 
@@ -1155,7 +1402,7 @@ void VNCSConnectionST::writeLosslessRefresh()
 
   writeRTTPing();
 
-  encodeManager.writeLosslessRefresh(req, server->getPixelBuffer(),
+  encodeManager.writeLosslessRefresh(req, server->getUpdateBuffer(),
                                      cursor, maxUpdateSize);
 
   writeRTTPing();
@@ -1164,17 +1411,178 @@ void VNCSConnectionST::writeLosslessRefresh()
 }
 
 
+// updateShadowPixelBuffer() makes sure we are using the server's
+// shared copy of the framebuffer in the client's pixel format, if it
+// is different from the framebuffer's.
+
+void VNCSConnectionST::updateShadowPixelBuffer()
+{
+  bool needed;
+
+  // Scaled updates have their own copy of the framebuffer
+  needed = (client.pf() != server->getPixelBuffer()->getPF()) &&
+           (client.scaleFactor == 1);
+
+  if ((shadowPixelBuffer != nullptr) &&
+      (!needed || (shadowPixelBuffer->getPF() != client.pf()))) {
+    server->releaseShadowPixelBuffer(shadowPixelBuffer);
+    shadowPixelBuffer = nullptr;
+  }
+
+  if (needed && (shadowPixelBuffer == nullptr))
+    shadowPixelBuffer = server->acquireShadowPixelBuffer(client.pf());
+
+  encodeManager.setShadowPixelBuffer(shadowPixelBuffer);
+}
+
+bool VNCSConnectionST::useSharedMemory()
+{
+#ifdef HAVE_MEMFD_CREATE
+  if (sharedMemoryFailed)
+    return false;
+  if (!client.supportsEncoding(pseudoEncodingSharedMemory))
+    return false;
+  // The viewer maps the buffer as is, so it must be full size
+  if (client.scaleFactor != 1)
+    return false;
+  // File descriptors can only be passed over UNIX sockets
+  if (dynamic_cast<network::UnixSocket*>(sock) == nullptr)
+    return false;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void VNCSConnectionST::writeSharedMemoryUpdate(const UpdateInfo& ui,
+                                               const RenderedCursor* cursor)
+{
+#ifdef HAVE_MEMFD_CREATE
+  const PixelBuffer* pb;
+  core::Region changed;
+  std::vector<core::Rect> rects;
+  bool setup;
+
+  pb = server->getUpdateBuffer();
+
+  changed = ui.changed.union_(ui.copied);
+
+  setup = false;
+  if ((sharedFramebuffer == nullptr) ||
+      (sharedFramebuffer->getRect() != pb->getRect()) ||
+      (sharedFramebuffer->getPF() != client.pf())) {
+    delete sharedFramebuffer;
+    sharedFramebuffer = nullptr;
+
+    try {
+      sharedFramebuffer = new SharedMemoryPixelBuffer(client.pf(),
+                                                      pb->width(),
+                                                      pb->height());
+    } catch (std::exception& e) {
+      vlog.error(_("Failed to set up shared memory: %s"), e.what());
+      sharedMemoryFailed = true;
+      encodeManager.writeUpdate(ui, pb, cursor);
+      return;
+    }
+
+    vlog.debug("Using shared memory framebuffer for %s",
+               peerEndpoint.c_str());
+
+    sock->outStream().attachFd(sharedFramebuffer->getFd());
+
+    // The new buffer has no content, so everything needs to be
+    // copied over
+    changed = pb->getRect();
+    setup = true;
+
+    // Nothing sent earlier needs to be refreshed any more
+    encodeManager.pruneLosslessRefresh(core::Region());
+  }
+
+  changed.get_rects(&rects);
+
+  for (const core::Rect& rect : rects) {
+    const uint8_t* data;
+    int srcStride;
+
+    data = pb->getBuffer(rect, &srcStride);
+    sharedFramebuffer->imageRect(pb->getPF(), rect, data, srcStride);
+  }
+
+  // The rendered cursor is drawn on top of what we just copied
+  if (cursor != nullptr) {
+    std::vector<core::Rect> cursorRects;
+
+    changed.intersect(cursor->getEffectiveRect()).get_rects(&cursorRects);
+    for (const core::Rect& rect : cursorRects) {
+      const uint8_t* data;
+      int srcStride;
+
+      data = cursor->getBuffer(rect, &srcStride);
+      sharedFramebuffer->imageRect(cursor->getPF(), rect, data, srcStride);
+    }
+  }
+
+  writer()->writeFramebufferUpdateStart(rects.size() + (setup ? 1 : 0));
+
+  if (setup) {
+    writer()->writeSharedMemorySetup(sharedFramebuffer->getRect(),
+                                     sharedFramebuffer->getStride(),
+                                     sharedFramebuffer->getPF());
+  }
+
+  for (const core::Rect& rect : rects)
+    writer()->writeSharedMemoryDamage(rect);
+
+  writer()->writeFramebufferUpdateEnd();
+#else
+  (void)ui;
+  (void)cursor;
+  throw std::logic_error("Shared memory is not supported");
+#endif
+}
+
 void VNCSConnectionST::screenLayoutChange(uint16_t reason)
 {
   if (state() != RFBSTATE_NORMAL)
     return;
 
   client.setDimensions(client.width(), client.height(),
-                       server->getScreenLayout());
+                       clientScreenLayout());
 
   writer()->writeDesktopSize(reason);
 }
 
+// scaleFactorChange() is called when the client has asked for a
+// different scale factor. The client sees this as the framebuffer
+// changing size.
+
+void VNCSConnectionST::scaleFactorChange()
+{
+  if (state() != RFBSTATE_NORMAL)
+    return;
+
+  vlog.info(_("Client requested scale factor %d"), client.scaleFactor);
+
+  if (!client.supportsDesktopSize()) {
+    close(_("Client does not support resizing the desktop"));
+    return;
+  }
+
+  setClientDimensions();
+
+  if (client.supportsEncoding(pseudoEncodingScaleFactor1 +
+                              client.scaleFactor - 1))
+    writer()->writeScaleFactor();
+  writer()->writeDesktopSize(reasonServer);
+
+  // Everything the client has is now at the wrong resolution
+  encodeManager.pruneLosslessRefresh({});
+  updates.clear();
+  updates.add_changed(server->getPixelBuffer()->getRect());
+}
+
 
 // setCursor() is called whenever the cursor has changed shape or pixel format.
 // If the client supports local cursor then it will arrange for the cursor to
@@ -1208,7 +1616,11 @@ void VNCSConnectionST::setCursorPos()
     return;
 
   if (client.supportsCursorPosition()) {
-    client.setCursorPos(server->getCursorPos());
+    core::Point pos;
+
+    pos = server->getCursorPos();
+    client.setCursorPos({pos.x / client.scaleFactor,
+                         pos.y / client.scaleFactor});
     writer()->writeCursorPos();
   }
 }
@@ -36,6 +36,8 @@
 #include <rfb/SConnection.h>
 
 namespace rfb {
+  class ShadowPixelBuffer;
+  class SharedMemoryPixelBuffer;
   class VNCServerST;
 
   class VNCSConnectionST : private SConnection,
@@ -51,6 +53,7 @@ namespace rfb {
     void close(const char* reason) override;
 
     using SConnection::authenticated;
+    using SConnection::clipboardDataPending;
 
     // Methods called from VNCServerST.  None of these methods ever knowingly
     // throw an exception.
@@ -84,8 +87,13 @@ namespace rfb {
     void requestClipboardOrClose();
     void announceClipboardOrClose(bool available);
     void sendClipboardDataOrClose(const char* data);
+    void abortClipboardDataOrClose();
     void desktopReadyOrClose();
 
+    // encodeDoneOrClose() completes an update that was handed over to
+    // the server's encoding thread
+    void encodeDoneOrClose();
+
     // The following methods never throw exceptions
 
     // getComparerState() returns if this client would like the framebuffer
@@ -127,6 +135,8 @@ namespace rfb {
     void queryConnection(const char* userName) override;
     void clientReady(bool shared) override;
     void setPixelFormat(const PixelFormat& pf) override;
+    void setEncodings(int nEncodings,
+                      const int32_t* encodings) override;
     void pointerEvent(const core::Point& pos,
                       uint16_t buttonMask) override;
     void keyEvent(uint32_t keysym, uint32_t keycode,
@@ -139,6 +149,7 @@ namespace rfb {
                const uint8_t data[]) override;
     void enableContinuousUpdates(bool enable,
                                  int x, int y, int w, int h) override;
+    void handleClipboardPeek() override;
     void handleClipboardRequest() override;
     void handleClipboardAnnounce(bool available) override;
     void handleClipboardData(const char* data) override;
@@ -154,6 +165,17 @@ namespace rfb {
 
     bool isShiftPressed();
 
+    // Conversion between the server's framebuffer and the possibly
+    // scaled down framebuffer seen by the client
+    ScreenSet clientScreenLayout();
+    void setClientDimensions();
+    core::Rect clientToServer(const core::Rect& r);
+
+    // waitForEncode() makes sure that this client doesn't have an
+    // update in progress on the encoding thread. Needed before anything
+    // is written to the client, or before changing its parameters.
+    void waitForEncode();
+
     // Congestion control
     void writeRTTPing();
     bool isCongested();
@@ -166,7 +188,20 @@ namespace rfb {
     void writeDataUpdate();
     void writeLosslessRefresh();
 
+    void updateShadowPixelBuffer();
+
+    // Large clipboard transfers are sent a piece at a time whenever the
+    // link has room, in between framebuffer updates
+    void writeClipboardUpdate();
+
+    // Viewers on the same machine can get the framebuffer via shared
+    // memory instead of encoded rects
+    bool useSharedMemory();
+    void writeSharedMemoryUpdate(const UpdateInfo& ui,
+                                 const RenderedCursor* cursor);
+
     void screenLayoutChange(uint16_t reason);
+    void scaleFactorChange();
     void setCursor();
     void setCursorPos();
     void setDesktopName(const char *name);
@@ -189,6 +224,7 @@ namespace rfb {
     Congestion congestion;
     core::Timer congestionTimer;
     core::Timer losslessTimer;
+    core::Timer clipboardTimer;
 
     VNCServerST* server;
     SimpleUpdateTracker updates;
@@ -199,6 +235,11 @@ namespace rfb {
     core::Region cuRegion;
     EncodeManager encodeManager;
 
+    SharedMemoryPixelBuffer* sharedFramebuffer;
+    bool sharedMemoryFailed;
+
+    ShadowPixelBuffer* shadowPixelBuffer;
+
     std::map<uint32_t, uint32_t> pressedKeys;
 
     core::Timer idleTimer;
@@ -64,6 +64,8 @@
 #include <network/Socket.h>
 
 #include <rfb/ComparingUpdateTracker.h>
+#include <rfb/ShadowPixelBuffer.h>
+#include <rfb/EncodeThread.h>
 #include <rfb/KeyRemapper.h>
 #include <rfb/KeysymStr.h>
 #include <rfb/SDesktop.h>
@@ -94,7 +96,9 @@ VNCServerST::VNCServerST(const char* name_, SDesktop* desktop_)
     renderedCursorInvalid(false),
     keyRemapper(&KeyRemapper::defInstance),
     idleTimer(this), disconnectTimer(this), connectTimer(this),
-    msc(0), queuedMsc(0), frameTimer(this)
+    msc(0), queuedMsc(0), frameTimer(this),
+    encodeThread(nullptr), encodingClient(nullptr), snapshot(nullptr),
+    encodeTimer(this)
 {
   slog.debug("Creating single-threaded server %s", name.c_str());
 
@@ -116,6 +120,7 @@ VNCServerST::~VNCServerST()
 
   // Stop trying to render things
   stopFrameClock();
+  setThreadedEncoding(false);
 
   // Delete all the clients, and their sockets, and any closing sockets
   while (!clients.empty()) {
@@ -179,6 +184,9 @@ void VNCServerST::removeSocket(network::Socket* sock) {
   std::list<VNCSConnectionST*>::iterator ci;
   for (ci = clients.begin(); ci != clients.end(); ci++) {
     if ((*ci)->getSock() == sock) {
+      if (isEncoding(*ci))
+        finishEncode();
+
       // - Remove any references to it
       if (pointerClient == *ci) {
         // Release the mouse buttons the client have pressed
@@ -196,6 +204,9 @@ void VNCServerST::removeSocket(network::Socket* sock) {
 
       clients.remove(*ci);
 
+      // It might have been the last one still receiving the clipboard
+      handleClipboardDataSent();
+
       connectionsLog.info(_("Closed: %s"), peer.c_str());
 
       // - Check that the desktop object is still required
@@ -278,6 +289,9 @@ void VNCServerST::queueMsc(uint64_t target)
 
 void VNCServerST::setPixelBuffer(PixelBuffer* pb_, const ScreenSet& layout)
 {
+  // The snapshot and converted buffers are about to change
+  finishEncode();
+
   if (comparer)
     comparer->logStats();
 
@@ -285,9 +299,15 @@ void VNCServerST::setPixelBuffer(PixelBuffer* pb_, const ScreenSet& layout)
   delete comparer;
   comparer = nullptr;
 
+  delete snapshot;
+  snapshot = nullptr;
+
   if (!pb) {
     screenLayout = ScreenSet();
 
+    for (ShadowBuffer& sb : shadowBuffers)
+      sb.pb->setSource(nullptr);
+
     if (desktopStarted)
       throw std::logic_error("setPixelBuffer: Null PixelBuffer when desktopStarted?");
 
@@ -305,6 +325,12 @@ void VNCServerST::setPixelBuffer(PixelBuffer* pb_, const ScreenSet& layout)
   renderedCursorInvalid = true;
   add_changed(pb->getRect());
 
+  if (encodeThread != nullptr)
+    updateSnapshot();
+
+  for (ShadowBuffer& sb : shadowBuffers)
+    sb.pb->setSource(getUpdateBuffer());
+
   // The desktop is considered ready after the pixelbuffer is set
   checkDesktopReady();
 
@@ -403,11 +429,22 @@ void VNCServerST::sendClipboardData(const char* data)
   if (strchr(data, '\r') != nullptr)
     throw std::invalid_argument("Invalid carriage return in clipboard data");
 
+  // Large transfers are sent a piece at a time straight from a single
+  // shared copy, so any transfer of an older clipboard has to be
+  // stopped before that copy is replaced
+  if (clipboardData != data) {
+    for (ci = clients.begin(); ci != clients.end(); ++ci)
+      (*ci)->abortClipboardDataOrClose();
+    clipboardData = data;
+  }
+
   for (ci = clipboardRequestors.begin();
        ci != clipboardRequestors.end(); ++ci)
-    (*ci)->sendClipboardDataOrClose(data);
+    (*ci)->sendClipboardDataOrClose(clipboardData.c_str());
 
   clipboardRequestors.clear();
+
+  handleClipboardDataSent();
 }
 
 void VNCServerST::checkDesktopReady()
@@ -487,6 +524,7 @@ void VNCServerST::setCursor(int width, int height,
   cursor = new Cursor(width, height, newHotspot, data);
   cursor->crop();
 
+  renderedCursor.cursorChange();
   renderedCursorInvalid = true;
 
   std::list<VNCSConnectionST*>::iterator ci;
@@ -597,6 +635,18 @@ void VNCServerST::handleClipboardAnnounce(VNCSConnectionST* client,
   desktop->handleClipboardAnnounce(available);
 }
 
+void VNCServerST::handleClipboardDataSent()
+{
+  std::list<VNCSConnectionST*>::iterator ci;
+
+  for (ci = clients.begin(); ci != clients.end(); ++ci) {
+    if ((*ci)->clipboardDataPending())
+      return;
+  }
+
+  std::string().swap(clipboardData);
+}
+
 void VNCServerST::handleClipboardData(VNCSConnectionST* client,
                                       const char* data)
 {
@@ -720,12 +770,18 @@ void VNCServerST::handleTimeout(core::Timer* t)
 
     frameTimer.repeat(timeout);
 
-    if (desktopStarted &&
-        ((comparer != nullptr) && !comparer->is_empty()))
-      writeUpdate();
-
+    // Advance the frame counter before looking for changes, so that
+    // anything waiting for this frame (e.g. Present) gets to finish
+    // drawing it first. Otherwise we would send a partial frame now
+    // and the rest of it one frame later.
     msc++;
     desktop->frameTick(msc);
+
+    // The clients might still be encoding from the snapshot, in which
+    // case the changes will have to wait for the next frame
+    if (desktopStarted && (blockCounter == 0) && !isEncoding() &&
+        ((comparer != nullptr) && !comparer->is_empty()))
+      writeUpdate();
   } else if (t == &idleTimer) {
     slog.info(_("Maximum idle time reached, exiting"));
     desktop->terminate();
@@ -735,6 +791,12 @@ void VNCServerST::handleTimeout(core::Timer* t)
   } else if (t == &connectTimer) {
     slog.info(_("Maximum connected time reached, exiting"));
     desktop->terminate();
+  } else if (t == &encodeTimer) {
+    std::list<VNCSConnectionST*>::iterator ci;
+
+    // Other clients might have been held back by the last update
+    for (ci = clients.begin(); ci != clients.end(); ++ci)
+      (*ci)->writeFramebufferUpdateOrClose();
   }
 }
 
@@ -914,6 +976,11 @@ void VNCServerST::writeUpdate()
 
   pb->grabRegion(toCheck);
 
+  if (snapshot != nullptr)
+    updateSnapshot(toCheck);
+
+  comparer->setHashing(rfb::Server::compareFB >= 3);
+
   if (getComparerState())
     comparer->enable();
   else
@@ -924,6 +991,9 @@ void VNCServerST::writeUpdate()
 
   comparer->clear();
 
+  for (ShadowBuffer& sb : shadowBuffers)
+    sb.pb->damage(ui.changed.union_(ui.copied));
+
   for (ci = clients.begin(); ci != clients.end(); ++ci) {
     (*ci)->add_copied(ui.copied, ui.copy_delta);
     (*ci)->add_changed(ui.changed);
@@ -955,19 +1025,61 @@ core::Region VNCServerST::getPendingRegion()
 
 const RenderedCursor* VNCServerST::getRenderedCursor()
 {
+  // The encoding thread might be using it
+  assert(!isEncoding());
+
   if (renderedCursorInvalid) {
-    renderedCursor.update(pb, cursor, cursorPos);
+    renderedCursor.update(getUpdateBuffer(), cursor, cursorPos);
     renderedCursorInvalid = false;
   }
 
   return &renderedCursor;
 }
 
+ShadowPixelBuffer*
+VNCServerST::acquireShadowPixelBuffer(const PixelFormat& pf)
+{
+  ShadowBuffer sb;
+
+  for (ShadowBuffer& iter : shadowBuffers) {
+    if (iter.pb->getPF() == pf) {
+      iter.users++;
+      return iter.pb;
+    }
+  }
+
+  sb.pb = new ShadowPixelBuffer(pf, getUpdateBuffer());
+  sb.users = 1;
+  shadowBuffers.push_back(sb);
+
+  return sb.pb;
+}
+
+void VNCServerST::releaseShadowPixelBuffer(ShadowPixelBuffer* spb)
+{
+  std::list<ShadowBuffer>::iterator iter;
+
+  for (iter = shadowBuffers.begin();
+       iter != shadowBuffers.end(); ++iter) {
+    if (iter->pb != spb)
+      continue;
+
+    assert(iter->users > 0);
+    if (--iter->users == 0) {
+      delete iter->pb;
+      shadowBuffers.erase(iter);
+    }
+    return;
+  }
+
+  assert(false);
+}
+
 bool VNCServerST::getComparerState()
 {
   if (rfb::Server::compareFB == 0)
     return false;
-  if (rfb::Server::compareFB != 2)
+  if ((rfb::Server::compareFB != 2) && (rfb::Server::compareFB != 4))
     return true;
 
   std::list<VNCSConnectionST*>::iterator ci;
@@ -977,3 +1089,142 @@ bool VNCServerST::getComparerState()
   }
   return false;
 }
+
+void VNCServerST::setThreadedEncoding(bool enable)
+{
+  if (enable == (encodeThread != nullptr))
+    return;
+
+  finishEncode();
+
+  delete snapshot;
+  snapshot = nullptr;
+
+  if (enable) {
+    slog.debug("Encoding updates on a separate thread");
+    encodeThread = new EncodeThread();
+    if (pb != nullptr)
+      updateSnapshot();
+  } else {
+    delete encodeThread;
+    encodeThread = nullptr;
+    encodeTimer.stop();
+  }
+
+  if (pb != nullptr) {
+    for (ShadowBuffer& sb : shadowBuffers)
+      sb.pb->setSource(getUpdateBuffer());
+    renderedCursorInvalid = true;
+  }
+}
+
+const PixelBuffer* VNCServerST::getUpdateBuffer() const
+{
+  if (snapshot != nullptr)
+    return snapshot;
+  return pb;
+}
+
+bool VNCServerST::startEncode(VNCSConnectionST* client,
+                              EncodeManager* manager,
+                              const UpdateInfo& ui,
+                              const RenderedCursor* renderedCursor_)
+{
+  if (encodeThread == nullptr)
+    return false;
+
+  assert(encodingClient == nullptr);
+
+  encodeThread->start(manager, ui, snapshot, renderedCursor_);
+  encodingClient = client;
+
+  return true;
+}
+
+bool VNCServerST::isEncoding(network::Socket* sock) const
+{
+  return (encodingClient != nullptr) &&
+         (encodingClient->getSock() == sock);
+}
+
+int VNCServerST::getEncodeFd() const
+{
+  if (encodeThread == nullptr)
+    return -1;
+  return encodeThread->getNotifyFd();
+}
+
+void VNCServerST::processEncodeEvent()
+{
+  std::list<VNCSConnectionST*>::iterator ci;
+
+  // Might already have been collected by finishEncode()
+  if ((encodingClient == nullptr) || !encodeThread->isDone())
+    return;
+
+  collectEncode();
+
+  // Other clients might have been held back by that update
+  for (ci = clients.begin(); ci != clients.end(); ++ci)
+    (*ci)->writeFramebufferUpdateOrClose();
+}
+
+void VNCServerST::finishEncode()
+{
+  if (encodingClient == nullptr)
+    return;
+
+  collectEncode();
+
+  // Give the other clients a chance to send their updates
+  encodeTimer.start(0);
+}
+
+void VNCServerST::updateSnapshot()
+{
+  assert(pb != nullptr);
+
+  if ((snapshot == nullptr) || (snapshot->getRect() != pb->getRect()) ||
+      (snapshot->getPF() != pb->getPF())) {
+    delete snapshot;
+    snapshot = new ManagedPixelBuffer(pb->getPF(),
+                                      pb->width(), pb->height());
+  }
+
+  updateSnapshot(pb->getRect());
+}
+
+void VNCServerST::updateSnapshot(const core::Region& changed)
+{
+  std::vector<core::Rect> rects;
+
+  assert(!isEncoding());
+
+  changed.get_rects(&rects);
+  for (const core::Rect& rect : rects) {
+    const uint8_t* data;
+    int stride;
+
+    data = pb->getBuffer(rect, &stride);
+    snapshot->imageRect(pb->getPF(), rect, data, stride);
+  }
+}
+
+void VNCServerST::collectEncode()
+{
+  VNCSConnectionST* client;
+
+  assert(encodingClient != nullptr);
+
+  client = encodingClient;
+  encodingClient = nullptr;
+
+  try {
+    encodeThread->finish();
+  } catch (std::exception& e) {
+    client->close(e.what());
+    return;
+  }
+
+  client->encodeDoneOrClose();
+}
@@ -37,10 +37,15 @@ namespace rfb {
 
   class VNCSConnectionST;
   class ComparingUpdateTracker;
+  class ShadowPixelBuffer;
+  class EncodeManager;
+  class EncodeThread;
   class ListConnInfo;
   class PixelBuffer;
+  class ManagedPixelBuffer;
   class KeyRemapper;
   class SDesktop;
+  class UpdateInfo;
 
   class VNCServerST : public VNCServer,
                       public core::Timer::Callback {
@@ -126,6 +131,9 @@ namespace rfb {
     void handleClipboardRequest(VNCSConnectionST* client);
     void handleClipboardAnnounce(VNCSConnectionST* client, bool available);
     void handleClipboardData(VNCSConnectionST* client, const char* data);
+    // handleClipboardDataSent() is called when a client is done with
+    // a clipboard transfer that was sent in pieces
+    void handleClipboardDataSent();
 
     unsigned int setDesktopSize(VNCSConnectionST* requester,
                                 int fb_width, int fb_height,
@@ -156,6 +164,53 @@ namespace rfb {
     // side rendered cursor buffer
     const RenderedCursor* getRenderedCursor();
 
+    // acquireShadowPixelBuffer() returns a copy of the framebuffer in
+    // the given pixel format, which is shared between all clients using
+    // that format so that each change only has to be converted once.
+    // It must be returned using releaseShadowPixelBuffer().
+    ShadowPixelBuffer* acquireShadowPixelBuffer(const PixelFormat& pf);
+    void releaseShadowPixelBuffer(ShadowPixelBuffer* spb);
+
+    // setThreadedEncoding() moves the encoding of framebuffer updates
+    // to a separate thread. The framebuffer is then copied to a
+    // snapshot whenever changes are passed on to the clients, and the
+    // main thread is free to modify it whilst updates are encoded.
+    // The caller must also watch getEncodeFd() and call
+    // processEncodeEvent() whenever it is readable.
+    void setThreadedEncoding(bool enable);
+
+    // getEncodeFd() returns a file descriptor that becomes readable
+    // when the encoding thread has finished an update, or -1 if
+    // threaded encoding is disabled
+    int getEncodeFd() const;
+
+    // processEncodeEvent() completes a finished update from the
+    // encoding thread
+    void processEncodeEvent();
+
+    // getUpdateBuffer() returns what clients should send updates from,
+    // which is either the snapshot or the framebuffer itself
+    const PixelBuffer* getUpdateBuffer() const;
+
+    // startEncode() hands over an update for the client to the
+    // encoding thread, if there is one. Until it is done, the client
+    // must not touch the EncodeManager or write anything else to the
+    // connection, and no other client can start an update.
+    bool startEncode(VNCSConnectionST* client, EncodeManager* manager,
+                     const UpdateInfo& ui,
+                     const RenderedCursor* renderedCursor);
+    bool isEncoding() const { return encodingClient != nullptr; }
+    bool isEncoding(const VNCSConnectionST* client) const {
+      return encodingClient == client;
+    }
+    // isEncoding() can also be checked for a socket, in which case it
+    // should not be polled until the update is done
+    bool isEncoding(network::Socket* sock) const;
+
+    // finishEncode() waits for any update on the encoding thread to
+    // complete
+    void finishEncode();
+
   protected:
 
     // Timer callbacks
@@ -178,6 +233,10 @@ namespace rfb {
 
     bool getComparerState();
 
+    void updateSnapshot();
+    void updateSnapshot(const core::Region& changed);
+    void collectEncode();
+
   protected:
     Blacklist blacklist;
 
@@ -195,6 +254,7 @@ namespace rfb {
     VNCSConnectionST* pointerClient;
     VNCSConnectionST* clipboardClient;
     std::list<VNCSConnectionST*> clipboardRequestors;
+    std::string clipboardData;
 
     time_t pointerClientTime;
 
@@ -205,6 +265,12 @@ namespace rfb {
     RenderedCursor renderedCursor;
     bool renderedCursorInvalid;
 
+    struct ShadowBuffer {
+      ShadowPixelBuffer* pb;
+      int users;
+    };
+    std::list<ShadowBuffer> shadowBuffers;
+
     KeyRemapper* keyRemapper;
 
     core::Timer idleTimer;
@@ -213,6 +279,11 @@ namespace rfb {
 
     uint64_t msc, queuedMsc;
     core::Timer frameTimer;
+
+    EncodeThread* encodeThread;
+    VNCSConnectionST* encodingClient;
+    ManagedPixelBuffer* snapshot;
+    core::Timer encodeTimer;
   };
 
 };
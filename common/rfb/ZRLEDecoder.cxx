@@ -55,23 +55,26 @@ static inline uint32_t readOpaque24B(rdr::InStream* is)
 }
 
 template<class T>
-static inline T readPixel(rdr::ZlibInStream* zis)
+static inline T readPixel(rdr::InStream* is)
 {
   if (sizeof(T) == 1)
-    return zis->readOpaque8();
+    return is->readOpaque8();
   if (sizeof(T) == 2)
-    return zis->readOpaque16();
+    return is->readOpaque16();
   if (sizeof(T) == 4)
-    return zis->readOpaque32();
+    return is->readOpaque32();
 }
 
-static inline void zlibHasData(rdr::ZlibInStream* zis, size_t length)
+static inline void zrleHasData(rdr::InStream* is, size_t length)
 {
-  if (!zis->hasData(length))
+  if (!is->hasData(length))
     throw protocol_error(_("Failed to decode ZRLE rectangle"));
 }
 
-ZRLEDecoder::ZRLEDecoder() : Decoder(DecoderOrdered)
+// The zlib stream is shared between all rects, so only the inflating
+// is done in order. The tiles are then decoded from the uncompressed
+// data, which can be done in parallel.
+ZRLEDecoder::ZRLEDecoder() : Decoder(DecoderOrderedPrepare)
 {
 }
 
@@ -103,6 +106,44 @@ bool ZRLEDecoder::readRect(const core::Rect& /*r*/, rdr::InStream* is,
   return true;
 }
 
+void ZRLEDecoder::prepareRect(const core::Rect& r,
+                              const uint8_t* buffer, size_t buflen,
+                              const ServerParams& server,
+                              rdr::OutStream* os)
+{
+  rdr::MemInStream is(buffer, buflen);
+  size_t length, maxLength;
+  size_t tiles, bytesPerPixel;
+
+  zrleHasData(&is, 4);
+  length = is.readU32();
+  zis.setUnderlying(&is, length);
+
+  // The largest possible tile is a full palette followed by every
+  // pixel as its own run, so a valid rect can never inflate to more
+  // than this. Don't let a small rect use up all our memory.
+  tiles = ((r.width() + 63) / 64) * ((r.height() + 63) / 64);
+  bytesPerPixel = server.pf().bpp / 8;
+  maxLength = tiles * (1 + 127 * bytesPerPixel) +
+              (size_t)r.area() * (bytesPerPixel + 1);
+
+  while (zis.hasData(1)) {
+    size_t avail;
+
+    avail = zis.avail();
+    if (avail > maxLength) {
+      zis.setUnderlying(nullptr, 0);
+      throw protocol_error(_("Failed to decode ZRLE rectangle"));
+    }
+    maxLength -= avail;
+
+    os->writeBytes(zis.getptr(avail), avail);
+    zis.setptr(avail);
+  }
+
+  zis.setUnderlying(nullptr, 0);
+}
+
 void ZRLEDecoder::decodeRect(const core::Rect& r, const uint8_t* buffer,
                              size_t buflen, const ServerParams& server,
                              ModifiablePixelBuffer* pb)
@@ -121,8 +162,6 @@ void ZRLEDecoder::zrleDecode(const core::Rect& r, rdr::InStream* is,
                              const PixelFormat& pf,
                              ModifiablePixelBuffer* pb)
 {
-  int length = is->readU32();
-  zis.setUnderlying(is, length);
   core::Rect t;
   T buf[64 * 64];
 
@@ -144,24 +183,24 @@ void ZRLEDecoder::zrleDecode(const core::Rect& r, rdr::InStream* is,
 
       t.br.x = std::min(r.br.x, t.tl.x + 64);
 
-      zlibHasData(&zis, 1);
-      int mode = zis.readU8();
+      zrleHasData(is, 1);
+      int mode = is->readU8();
       bool rle = mode & 128;
       int palSize = mode & 127;
       T palette[128];
 
       if (isLowCPixel || isHighCPixel)
-        zlibHasData(&zis, 3 * palSize);
+        zrleHasData(is, 3 * palSize);
       else
-        zlibHasData(&zis, sizeof(T) * palSize);
+        zrleHasData(is, sizeof(T) * palSize);
 
       for (int i = 0; i < palSize; i++) {
         if (isLowCPixel)
-          palette[i] = readOpaque24A(&zis);
+          palette[i] = readOpaque24A(is);
         else if (isHighCPixel)
-          palette[i] = readOpaque24B(&zis);
+          palette[i] = readOpaque24B(is);
         else
-          palette[i] = readPixel<T>(&zis);
+          palette[i] = readPixel<T>(is);
       }
 
       if (palSize == 1) {
@@ -176,19 +215,19 @@ void ZRLEDecoder::zrleDecode(const core::Rect& r, rdr::InStream* is,
           // raw
 
           if (isLowCPixel || isHighCPixel)
-            zlibHasData(&zis, 3 * t.area());
+            zrleHasData(is, 3 * t.area());
           else
-            zlibHasData(&zis, sizeof(T) * t.area());
+            zrleHasData(is, sizeof(T) * t.area());
 
           if (isLowCPixel || isHighCPixel) {
             for (T* ptr = buf; ptr < buf+t.area(); ptr++) {
               if (isLowCPixel)
-                *ptr = readOpaque24A(&zis);
+                *ptr = readOpaque24A(is);
               else
-                *ptr = readOpaque24B(&zis);
+                *ptr = readOpaque24B(is);
             }
           } else {
-            zis.readBytes((uint8_t*)buf, t.area() * sizeof(T));
+            is->readBytes((uint8_t*)buf, t.area() * sizeof(T));
           }
 
         } else {
@@ -206,8 +245,8 @@ void ZRLEDecoder::zrleDecode(const core::Rect& r, rdr::InStream* is,
 
             while (ptr < eol) {
               if (nbits == 0) {
-                zlibHasData(&zis, 1);
-                byte = zis.readU8();
+                zrleHasData(is, 1);
+                byte = is->readU8();
                 nbits = 8;
               }
               nbits -= bppp;
@@ -228,20 +267,20 @@ void ZRLEDecoder::zrleDecode(const core::Rect& r, rdr::InStream* is,
           while (ptr < end) {
             T pix;
             if (isLowCPixel || isHighCPixel)
-              zlibHasData(&zis, 3);
+              zrleHasData(is, 3);
             else
-              zlibHasData(&zis, sizeof(T));
+              zrleHasData(is, sizeof(T));
             if (isLowCPixel)
-              pix = readOpaque24A(&zis);
+              pix = readOpaque24A(is);
             else if (isHighCPixel)
-              pix = readOpaque24B(&zis);
+              pix = readOpaque24B(is);
             else
-              pix = readPixel<T>(&zis);
+              pix = readPixel<T>(is);
             int len = 1;
             int b;
             do {
-              zlibHasData(&zis, 1);
-              b = zis.readU8();
+              zrleHasData(is, 1);
+              b = is->readU8();
               len += b;
             } while (b == 255);
 
@@ -259,14 +298,14 @@ void ZRLEDecoder::zrleDecode(const core::Rect& r, rdr::InStream* is,
           T* ptr = buf;
           T* end = ptr + t.area();
           while (ptr < end) {
-            zlibHasData(&zis, 1);
-            int index = zis.readU8();
+            zrleHasData(is, 1);
+            int index = is->readU8();
             int len = 1;
             if (index & 128) {
               int b;
               do {
-                zlibHasData(&zis, 1);
-                b = zis.readU8();
+                zrleHasData(is, 1);
+                b = is->readU8();
                 len += b;
               } while (b == 255);
 
@@ -287,7 +326,4 @@ void ZRLEDecoder::zrleDecode(const core::Rect& r, rdr::InStream* is,
       pb->imageRect(pf, t, buf);
     }
   }
-
-  zis.flushUnderlying();
-  zis.setUnderlying(nullptr, 0);
 }
@@ -33,6 +33,9 @@ namespace rfb {
     bool readRect(const core::Rect& r, rdr::InStream* is,
                   const ServerParams& server,
                   rdr::OutStream* os) override;
+    void prepareRect(const core::Rect& r, const uint8_t* buffer,
+                     size_t buflen, const ServerParams& server,
+                     rdr::OutStream* os) override;
     void decodeRect(const core::Rect& r, const uint8_t* buffer,
                     size_t buflen, const ServerParams& server,
                     ModifiablePixelBuffer* pb) override;
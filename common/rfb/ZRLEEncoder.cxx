@@ -42,7 +42,7 @@ core::IntParameter zlibLevel("ZlibLevel",
 
 ZRLEEncoder::ZRLEEncoder(SConnection* conn_)
   : Encoder(conn_, encodingZRLE, EncoderPlain, 127),
-  zos(nullptr, 2), mos(129*1024)
+  zos(nullptr, 2)
 {
   if (zlibLevel != -1) {
     vlog.info(_("Warning: The ZlibLevel option is deprecated and is "
@@ -67,6 +67,18 @@ void ZRLEEncoder::setCompressLevel(int level)
   zos.setCompressionLevel(level);
 }
 
+size_t ZRLEEncoder::getMemoryUsage()
+{
+  return zos.getMemoryUsage() + mos.capacity();
+}
+
+void ZRLEEncoder::releaseMemory()
+{
+  // ZRLE has no way of telling the client to start a new zlib stream,
+  // so the compression state has to stay once it has been used
+  mos.shrink();
+}
+
 void ZRLEEncoder::writeRect(const PixelBuffer* pb, const Palette& palette)
 {
   int x, y;
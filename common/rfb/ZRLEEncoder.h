@@ -34,6 +34,9 @@ namespace rfb {
 
     void setCompressLevel(int level) override;
 
+    size_t getMemoryUsage() override;
+    void releaseMemory() override;
+
     void writeRect(const PixelBuffer* pb,
                    const Palette& palette) override;
     void writeSolidRect(int width, int height, const PixelFormat& pf,
@@ -36,6 +36,13 @@ namespace rfb {
   const unsigned int clipboardNotify = 1 << 27;
   const unsigned int clipboardProvide = 1 << 28;
 
+  // Extension: A "provide" message with this flag set is followed by
+  // more messages continuing the same compressed stream. The last one
+  // is a normal "provide" message, or one without any formats if the
+  // transfer was aborted. Only sent to clients that have indicated
+  // support via pseudoEncodingClipboardStream.
+  const unsigned int clipboardStream = 1 << 29;
+
   const unsigned int clipboardActionMask = 0xff000000;
 }
 #endif
@@ -52,6 +52,7 @@ const char* rfb::encodingName(int num)
   case encodingTight:    return "Tight";
   case encodingJPEG:     return "JPEG";
   case encodingH264:     return "H.264";
+  case encodingTileCache: return "TileCache";
   default:               return _("[unknown]");
   }
 }
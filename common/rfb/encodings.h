@@ -70,6 +70,23 @@ namespace rfb {
   // UltraVNC-specific
   const int pseudoEncodingExtendedClipboard = 0xC0A1E5CE;
 
+  // TigerVNC-specific and not yet registered. These are kept in a
+  // block tagged "TGV", like the VMware ones, so they cannot clash
+  // with anything handed out from the shared ranges.
+
+  // Content addressed tile cache
+  const int encodingTileCache = 0x54475600;
+
+  // Server side scaling, where 1 means no scaling
+  const int pseudoEncodingScaleFactor1 = 0x54475610;
+  const int pseudoEncodingScaleFactor4 = 0x54475613;
+
+  // Framebuffer in shared memory, for viewers on the same machine
+  const int pseudoEncodingSharedMemory = 0x54475620;
+
+  // Large extended clipboard transfers split over several messages
+  const int pseudoEncodingClipboardStream = 0x54475630;
+
   int encodingNum(const char* name);
   const char* encodingName(int num);
 }
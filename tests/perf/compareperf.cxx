@@ -0,0 +1,203 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * This program measures how well ComparingUpdateTracker filters out
+ * damage that didn't actually change anything, using either a copy of
+ * the framebuffer or block hashes.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <core/Region.h>
+
+#include <rfb/ComparingUpdateTracker.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/UpdateTracker.h>
+
+#include "util.h"
+
+static const int fbWidth = 3840;
+static const int fbHeight = 2160;
+
+static const int iterations = 2000;
+
+// How the damage relates to what really changed
+enum Scenario {
+  // Redraws of identical content
+  scenarioUnchanged,
+  // A large area reported, but only a character or so changed
+  scenarioSmallChange,
+  // Everything that was reported changed
+  scenarioFullChange,
+};
+
+static const char* scenarioNames[] = {
+  "Unchanged", "Small change", "Full change",
+};
+
+struct Result {
+  size_t memory;
+  double rate;
+  unsigned long long damaged;
+  unsigned long long reported;
+  unsigned long long exact;
+};
+
+static void fillRect(rfb::ManagedPixelBuffer* pb, const core::Rect& r)
+{
+  uint8_t* buffer;
+  int stride;
+
+  buffer = pb->getBufferRW(r, &stride);
+  for (int y = 0; y < r.height(); y++) {
+    for (int x = 0; x < r.width() * 4; x++)
+      buffer[y * stride * 4 + x] ^= 1 + rand() % 255;
+  }
+  pb->commitBufferRW(r);
+}
+
+static core::Rect randomRect(int maxWidth, int maxHeight)
+{
+  int x, y, w, h;
+
+  w = 1 + rand() % maxWidth;
+  h = 1 + rand() % maxHeight;
+  x = rand() % (fbWidth - w);
+  y = rand() % (fbHeight - h);
+
+  return {x, y, x + w, y + h};
+}
+
+static void doTest(Scenario scenario, bool hashing, Result* result)
+{
+  rfb::PixelFormat pf(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+  rfb::ManagedPixelBuffer pb(pf, fbWidth, fbHeight);
+  rfb::ComparingUpdateTracker tracker(&pb);
+  cpucounter_t counter;
+  double cpuTime;
+
+  srand(0);
+
+  fillRect(&pb, pb.getRect());
+
+  tracker.setHashing(hashing);
+  tracker.compare();
+  tracker.clear();
+
+  result->damaged = result->reported = result->exact = 0;
+
+  counter = newCpuCounter();
+  cpuTime = 0;
+
+  for (int i = 0; i < iterations; i++) {
+    core::Rect damage;
+    rfb::UpdateInfo ui;
+    std::vector<core::Rect> rects;
+
+    damage = randomRect(512, 512);
+
+    switch (scenario) {
+    case scenarioUnchanged:
+      break;
+    case scenarioSmallChange:
+      {
+        core::Rect glyph;
+        glyph.tl.x = damage.tl.x + rand() % damage.width();
+        glyph.tl.y = damage.tl.y + rand() % damage.height();
+        glyph.br.x = std::min(damage.br.x, glyph.tl.x + 8);
+        glyph.br.y = std::min(damage.br.y, glyph.tl.y + 16);
+        fillRect(&pb, glyph);
+        result->exact += glyph.area();
+      }
+      break;
+    case scenarioFullChange:
+      fillRect(&pb, damage);
+      result->exact += damage.area();
+      break;
+    }
+
+    tracker.add_changed(damage);
+
+    startCpuCounter(counter);
+    tracker.compare();
+    endCpuCounter(counter);
+
+    cpuTime += getCpuCounter(counter);
+
+    tracker.getUpdateInfo(&ui, pb.getRect());
+    tracker.clear();
+
+    ui.changed.get_rects(&rects);
+    for (const core::Rect& r : rects)
+      result->reported += r.area();
+    result->damaged += damage.area();
+  }
+
+  result->memory = tracker.getMemoryUsage();
+  result->rate = result->damaged / (1000.0*1000.0) / cpuTime;
+
+  freeCpuCounter(counter);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+  time_t t;
+  char datebuffer[256];
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Framebuffer Comparison Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Frame buffer: %dx%d pixels\n", fbWidth, fbHeight);
+  printf("# Updates per test: %d\n", iterations);
+  printf("#\n");
+  printf("# Note: Memory is in KiB, speed is damaged Mpixels/sec, and\n");
+  printf("#       reported and excess are percentages of the damaged\n");
+  printf("#       pixels, where excess is what didn't really change\n");
+  printf("#\n");
+
+  printf("Scenario,Method,Memory,Speed,Reported,Excess\n");
+
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 2; j++) {
+      Result result;
+
+      doTest((Scenario)i, j == 1, &result);
+
+      printf("%s,%s,%d,%g,%g,%g\n", scenarioNames[i],
+             j == 1 ? "Hashes" : "Copy",
+             (int)(result.memory / 1024), result.rate,
+             100.0 * result.reported / result.damaged,
+             100.0 * (result.reported - result.exact) / result.damaged);
+    }
+  }
+
+  return 0;
+}
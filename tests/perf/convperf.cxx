@@ -26,6 +26,7 @@
 #include <time.h>
 
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 #include "util.h"
 
@@ -150,6 +151,7 @@ int main(int /*argc*/, char** /*argv*/)
   printf("#\n");
   printf("# Frame buffer: %dx%d pixels\n", fbsize, fbsize);
   printf("# Tile size: %dx%d pixels\n", tile, tile);
+  printf("# Vectorised kernels: %s\n", rfb::simd::name());
   printf("#\n");
   printf("# Note: Results are Mpixels/sec\n");
   printf("#\n");
@@ -179,6 +181,9 @@ int main(int /*argc*/, char** /*argv*/)
   srcpf.parse("rgb232");
   doTests(dstpf, srcpf);
 
+  srcpf.parse("bgr555");
+  doTests(dstpf, srcpf);
+
   /* rgb565 targets */
 
   printf("\n");
@@ -188,12 +193,27 @@ int main(int /*argc*/, char** /*argv*/)
   srcpf.parse("rgb888");
   doTests(dstpf, srcpf);
 
+  srcpf.parse("bgr888");
+  doTests(dstpf, srcpf);
+
   srcpf.parse("bgr565");
   doTests(dstpf, srcpf);
 
   srcpf.parse("rgb232");
   doTests(dstpf, srcpf);
 
+  /* rgb555 targets */
+
+  printf("\n");
+
+  dstpf.parse("rgb555");
+
+  srcpf.parse("rgb888");
+  doTests(dstpf, srcpf);
+
+  srcpf.parse("bgr888");
+  doTests(dstpf, srcpf);
+
   /* rgb232 targets */
 
   printf("\n");
@@ -37,6 +37,8 @@
 #include <math.h>
 #include <sys/time.h>
 
+#include <vector>
+
 #include <core/Configuration.h>
 
 #include <rdr/OutStream.h>
@@ -64,6 +66,10 @@ static core::BoolParameter translate("translate",
                                      "Translate 8-bit and 16-bit datasets into 24-bit",
                                      true);
 
+static core::BoolParameter tileCache("tilecache",
+                                     "Let the client cache previously seen tiles",
+                                     false);
+
 // The frame buffer (and output) is always this format
 static const rfb::PixelFormat fbPF(32, 24, false, true, 255, 255, 255, 0, 8, 16);
 
@@ -200,7 +206,12 @@ CConn::CConn(const char *filename)
 
   sc = new SConn();
   sc->client.setPF((bool)translate ? fbPF : pf);
-  ((rfb::SMsgHandler*)sc)->setEncodings(sizeof(encodings) / sizeof(*encodings), encodings);
+
+  std::vector<int32_t> encs(encodings,
+                            encodings + sizeof(encodings) / sizeof(*encodings));
+  if (tileCache)
+    encs.push_back(rfb::encodingTileCache);
+  ((rfb::SMsgHandler*)sc)->setEncodings(encs.size(), encs.data());
 }
 
 CConn::~CConn()
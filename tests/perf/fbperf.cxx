@@ -23,6 +23,8 @@
 #include <math.h>
 #include <sys/time.h>
 
+#include <vector>
+
 #include <FL/Fl.H>
 #include <FL/Fl_Window.H>
 #include <FL/fl_draw.H>
@@ -66,6 +68,16 @@ protected:
   void changefb() override;
 };
 
+class SplitTestWindow: public TestWindow {
+public:
+  void draw() override;
+
+protected:
+  void changefb() override;
+
+  core::Rect corner(int n);
+};
+
 class OverlayTestWindow: public PartialTestWindow {
 public:
   OverlayTestWindow();
@@ -155,14 +167,18 @@ void TestWindow::flush()
 
 void TestWindow::update()
 {
-  core::Rect r;
+  core::Region r;
+  std::vector<core::Rect> rects;
 
   startTimeCounter();
 
   changefb();
 
   r = fb->getDamage();
-  damage(FL_DAMAGE_USER1, r.tl.x, r.tl.y, r.width(), r.height());
+  r.get_rects(&rects);
+  for (const core::Rect& rect : rects)
+    damage(FL_DAMAGE_USER1, rect.tl.x, rect.tl.y,
+           rect.width(), rect.height());
 
 #if !defined(WIN32) && !defined(__APPLE__)
   // Make sure we measure any work we queue up
@@ -207,6 +223,64 @@ void PartialTestWindow::changefb()
   fb->fillRect(r, &pixel);
 }
 
+void SplitTestWindow::draw()
+{
+  int X, Y, W, H;
+
+  // Initial expose and similar
+  if (damage() & ~FL_DAMAGE_USER1) {
+    TestWindow::draw();
+    return;
+  }
+
+  // We cannot update the damage region from inside the draw function,
+  // so delegate this to an idle function
+  Fl::add_idle(timer, this);
+
+  // The clip box would cover everything between the corners, so
+  // handle each one separately
+  for (int i = 0; i < 2; i++) {
+    core::Rect r;
+
+    r = corner(i);
+    fl_clip_box(r.tl.x, r.tl.y, r.width(), r.height(), X, Y, W, H);
+    if ((W == 0) || (H == 0))
+      continue;
+
+    fb->draw(X, Y, X, Y, W, H);
+
+    pixels += W*H;
+  }
+
+  frames++;
+}
+
+void SplitTestWindow::changefb()
+{
+  uint32_t pixel;
+
+  pixel = rand();
+  fb->fillRect(corner(0), &pixel);
+  fb->fillRect(corner(1), &pixel);
+}
+
+core::Rect SplitTestWindow::corner(int n)
+{
+  core::Rect r;
+
+  // Top left or bottom right
+  r = fb->getRect();
+  if (n == 0) {
+    r.br.x = r.tl.x + w() / 8;
+    r.br.y = r.tl.y + h() / 8;
+  } else {
+    r.tl.x = r.br.x - w() / 8;
+    r.tl.y = r.br.y - h() / 8;
+  }
+
+  return r;
+}
+
 OverlayTestWindow::OverlayTestWindow() :
   overlay(nullptr), offscreen(nullptr)
 {
@@ -391,6 +465,12 @@ int main(int /*argc*/, char** /*argv*/)
   delete win;
   fprintf(stderr, "\n");
 
+  fprintf(stderr, "Split window update:\n\n");
+  win = new SplitTestWindow();
+  dotest(win);
+  delete win;
+  fprintf(stderr, "\n");
+
   fprintf(stderr, "Partial window update with overlay:\n\n");
   win = new OverlayTestWindow();
   dotest(win);
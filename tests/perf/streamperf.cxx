@@ -0,0 +1,590 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+/*
+ * This program measures the throughput of the rdr output streams,
+ * both on their own and chained the way they are used for a real
+ * connection. Each stream is fed the same data using different write
+ * sizes, from single writeU8() calls up to large writeBytes() calls.
+ *
+ * Streams are described as a chain of layers separated by "+", where
+ * the last layer is the sink. "Null" discards all data in memory and
+ * "Fd" writes it to a loopback TCP connection that is drained by a
+ * separate thread.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rdr/OutStream.h>
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+#include <rdr/HexOutStream.h>
+#include <rdr/ZlibOutStream.h>
+#ifdef HAVE_NETTLE
+#include <rdr/AESOutStream.h>
+#endif
+#ifdef HAVE_GNUTLS
+#include <rdr/TLSSocket.h>
+#endif
+
+#include "util.h"
+
+static const size_t totalSize = 32 * 1024 * 1024;
+static const size_t flushInterval = 256 * 1024;
+
+static const size_t writeSizes[] = { 1, 16, 256, 4096, 65536, 1048576 };
+static const size_t dataSize = 1048576;
+
+static uint8_t *data;
+
+static const char *tests[] = {
+  "Null",
+  "Fd",
+  "Hex+Null",
+  "Zlib+Null",
+  "Zlib+Fd",
+#ifdef HAVE_NETTLE
+  "AES128+Null",
+  "AES256+Null",
+  "AES128+Fd",
+  "AES256+Fd",
+  "Zlib+AES256+Fd",
+#endif
+#ifdef HAVE_GNUTLS
+  "TLS+Fd",
+  "Zlib+TLS+Fd",
+#ifdef HAVE_GNUTLS_KTLS
+  "KTLS+Fd",
+#endif
+#endif
+};
+
+class DummyOutStream : public rdr::OutStream {
+public:
+  DummyOutStream();
+
+  size_t length() override { return offset + (ptr - buf); }
+  void flush() override;
+
+private:
+  void overrun(size_t needed) override;
+
+  size_t offset;
+  uint8_t buf[131072];
+};
+
+DummyOutStream::DummyOutStream()
+{
+  offset = 0;
+  ptr = buf;
+  end = buf + sizeof(buf);
+}
+
+void DummyOutStream::flush()
+{
+  offset += ptr - buf;
+  ptr = buf;
+}
+
+void DummyOutStream::overrun(size_t needed)
+{
+  flush();
+  if (avail() < needed)
+    throw std::out_of_range("Insufficient dummy output buffer");
+}
+
+// A loopback TCP connection where the far end is read (and discarded)
+// by a separate thread, much like a client would do. It has to be TCP
+// as that is the only thing kernel TLS works with.
+class SocketSink {
+public:
+  SocketSink();
+  ~SocketSink();
+
+  rdr::FdOutStream* stream() { return &out; }
+  int peer() { return fds[1]; }
+
+  void start();
+  void drain();
+
+private:
+  static int createConnection(int fds[2]);
+  void reader();
+
+  int fds[2];
+  rdr::FdOutStream out;
+  std::thread thread;
+};
+
+SocketSink::SocketSink()
+  : out(createConnection(fds))
+{
+}
+
+SocketSink::~SocketSink()
+{
+  ::shutdown(fds[0], SHUT_WR);
+  if (thread.joinable())
+    thread.join();
+  close(fds[0]);
+  close(fds[1]);
+}
+
+int SocketSink::createConnection(int fds_[2])
+{
+  struct sockaddr_in addr;
+  socklen_t len;
+  int listener;
+
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0)
+    throw std::runtime_error("Failed to create socket");
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+
+  len = sizeof(addr);
+  if ((bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+      (listen(listener, 1) != 0) ||
+      (getsockname(listener, (struct sockaddr*)&addr, &len) != 0)) {
+    close(listener);
+    throw std::runtime_error("Failed to listen on loopback");
+  }
+
+  fds_[0] = socket(AF_INET, SOCK_STREAM, 0);
+  if ((fds_[0] < 0) ||
+      (connect(fds_[0], (struct sockaddr*)&addr, sizeof(addr)) != 0)) {
+    close(listener);
+    throw std::runtime_error("Failed to connect to loopback");
+  }
+
+  fds_[1] = accept(listener, nullptr, nullptr);
+  close(listener);
+  if (fds_[1] < 0)
+    throw std::runtime_error("Failed to accept loopback connection");
+
+  return fds_[0];
+}
+
+void SocketSink::start()
+{
+  thread = std::thread(&SocketSink::reader, this);
+}
+
+void SocketSink::drain()
+{
+  // FdOutStream never blocks, so we need to wait for the socket
+  // ourselves, just like the real event loops do
+  while (out.hasBufferedData()) {
+    struct pollfd pfd;
+
+    pfd.fd = fds[0];
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    poll(&pfd, 1, -1);
+
+    out.flush();
+  }
+}
+
+void SocketSink::reader()
+{
+  static uint8_t buf[1048576];
+
+  while (read(fds[1], buf, sizeof(buf)) > 0)
+    ;
+}
+
+#ifdef HAVE_GNUTLS
+
+// A TLS session on top of a SocketSink, with the handshake already
+// done. The client end is only used for the handshake as the sink
+// discards the encrypted data.
+class TLSPair {
+public:
+  TLSPair(SocketSink* sink, bool kernelTLS);
+  ~TLSPair();
+
+  rdr::OutStream* stream();
+  bool kernelSend() { return server->kernelSend(); }
+
+private:
+  SocketSink* sink;
+
+  gnutls_anon_server_credentials_t serverCred;
+  gnutls_anon_client_credentials_t clientCred;
+  gnutls_session_t serverSession;
+  gnutls_session_t clientSession;
+
+  rdr::FdInStream serverIn;
+  rdr::FdInStream clientIn;
+  rdr::FdOutStream clientOut;
+
+  rdr::TLSSocket* server;
+  rdr::TLSSocket* client;
+};
+
+TLSPair::TLSPair(SocketSink* sink_, bool kernelTLS)
+  : sink(sink_), serverIn(sink->stream()->getFd()),
+    clientIn(sink->peer()), clientOut(sink->peer())
+{
+  static const char prio[] = "NORMAL:+ANON-ECDH:+ANON-DH";
+
+  bool serverDone, clientDone;
+
+  gnutls_global_init();
+
+  gnutls_anon_allocate_server_credentials(&serverCred);
+  gnutls_anon_allocate_client_credentials(&clientCred);
+
+  gnutls_init(&serverSession, GNUTLS_SERVER | GNUTLS_NONBLOCK);
+  gnutls_init(&clientSession, GNUTLS_CLIENT | GNUTLS_NONBLOCK);
+
+  gnutls_priority_set_direct(serverSession, prio, nullptr);
+  gnutls_priority_set_direct(clientSession, prio, nullptr);
+
+  gnutls_credentials_set(serverSession, GNUTLS_CRD_ANON, serverCred);
+  gnutls_credentials_set(clientSession, GNUTLS_CRD_ANON, clientCred);
+
+  server = new rdr::TLSSocket(&serverIn, sink->stream(),
+                              serverSession, kernelTLS);
+  client = new rdr::TLSSocket(&clientIn, &clientOut, clientSession);
+
+  serverDone = clientDone = false;
+  while (!serverDone || !clientDone) {
+    if (!clientDone)
+      clientDone = client->handshake();
+    if (!serverDone)
+      serverDone = server->handshake();
+  }
+}
+
+TLSPair::~TLSPair()
+{
+  delete server;
+  delete client;
+
+  gnutls_deinit(serverSession);
+  gnutls_deinit(clientSession);
+
+  gnutls_anon_free_server_credentials(serverCred);
+  gnutls_anon_free_client_credentials(clientCred);
+
+  gnutls_global_deinit();
+}
+
+rdr::OutStream* TLSPair::stream()
+{
+  if (server->kernelSend())
+    return sink->stream();
+  return &server->outStream();
+}
+
+#endif
+
+// A chain of output streams built from a test description
+class Pipeline {
+public:
+  Pipeline(const char* desc);
+  ~Pipeline();
+
+  rdr::OutStream* stream() { return top; }
+
+  void flush();
+
+private:
+  void build(const char* desc);
+  void destroy();
+
+private:
+  rdr::OutStream* top;
+
+  std::vector<rdr::OutStream*> layers;
+  DummyOutStream* dummy;
+  SocketSink* sink;
+#ifdef HAVE_GNUTLS
+  TLSPair* tls;
+#endif
+};
+
+Pipeline::Pipeline(const char* desc)
+  : top(nullptr), dummy(nullptr), sink(nullptr)
+#ifdef HAVE_GNUTLS
+  , tls(nullptr)
+#endif
+{
+  try {
+    build(desc);
+  } catch (...) {
+    destroy();
+    throw;
+  }
+}
+
+Pipeline::~Pipeline()
+{
+  destroy();
+}
+
+void Pipeline::build(const char* desc)
+{
+  std::vector<std::string> names;
+  const char* sep;
+
+  while ((sep = strchr(desc, '+')) != nullptr) {
+    names.push_back(std::string(desc, sep - desc));
+    desc = sep + 1;
+  }
+  names.push_back(desc);
+
+  // Build it from the sink and upwards
+  for (auto iter = names.rbegin(); iter != names.rend(); ++iter) {
+    const std::string& name = *iter;
+
+    if (top == nullptr) {
+      if (name == "Null") {
+        dummy = new DummyOutStream();
+        top = dummy;
+      } else if (name == "Fd") {
+        sink = new SocketSink();
+        top = sink->stream();
+      } else {
+        throw std::invalid_argument("Invalid sink: " + name);
+      }
+      continue;
+    }
+
+    if (name == "Hex") {
+      layers.push_back(new rdr::HexOutStream(*top));
+    } else if (name == "Zlib") {
+      // Same compression level as ZRLE
+      layers.push_back(new rdr::ZlibOutStream(top, 2));
+#ifdef HAVE_NETTLE
+    } else if ((name == "AES128") || (name == "AES256")) {
+      static const uint8_t key[32] = {};
+      layers.push_back(new rdr::AESOutStream(top, key,
+                                             name == "AES128" ? 128 : 256));
+#endif
+#ifdef HAVE_GNUTLS
+    } else if ((name == "TLS") || (name == "KTLS")) {
+      if ((sink == nullptr) || (top != sink->stream()) || (tls != nullptr))
+        throw std::invalid_argument("TLS must be directly on top of Fd");
+      tls = new TLSPair(sink, name == "KTLS");
+      // Don't let the results claim something that didn't happen
+      if ((name == "KTLS") && !tls->kernelSend())
+        throw std::runtime_error("Kernel TLS is not available");
+      top = tls->stream();
+      continue;
+#endif
+    } else {
+      throw std::invalid_argument("Invalid stream: " + name);
+    }
+
+    top = layers.back();
+  }
+
+  if (sink != nullptr)
+    sink->start();
+}
+
+void Pipeline::destroy()
+{
+  for (auto iter = layers.rbegin(); iter != layers.rend(); ++iter)
+    delete *iter;
+#ifdef HAVE_GNUTLS
+  delete tls;
+#endif
+  delete sink;
+  delete dummy;
+}
+
+void Pipeline::flush()
+{
+  top->flush();
+  if (sink != nullptr)
+    sink->drain();
+}
+
+static void doTest(const char* desc, size_t writeSize,
+                   double* rate, double* cpb)
+{
+  size_t written;
+#ifdef HAVE_TSC
+  unsigned long long cycles;
+#endif
+
+  Pipeline pipeline(desc);
+  rdr::OutStream* os;
+
+  os = pipeline.stream();
+
+  startTimeCounter();
+#ifdef HAVE_TSC
+  cycles = __rdtsc();
+#endif
+
+  written = 0;
+  while (written < totalSize) {
+    size_t offset, chunk;
+
+    // Flush regularly, like we would after each framebuffer update
+    chunk = writeSize > flushInterval ? writeSize : flushInterval;
+    offset = written % dataSize;
+
+    if (writeSize == 1) {
+      const uint8_t* src;
+
+      src = data + offset;
+      for (size_t i = 0; i < chunk; i++)
+        os->writeU8(src[i]);
+    } else {
+      for (size_t i = 0; i < chunk; i += writeSize)
+        os->writeBytes(data + offset + i, writeSize);
+    }
+
+    pipeline.flush();
+
+    written += chunk;
+  }
+
+#ifdef HAVE_TSC
+  cycles = __rdtsc() - cycles;
+#endif
+  endTimeCounter();
+
+  *rate = written / (1000.0*1000.0) / getTimeCounter();
+#ifdef HAVE_TSC
+  *cpb = (double)cycles / written;
+#else
+  *cpb = 0;
+#endif
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+  const size_t testCount = sizeof(tests)/sizeof(tests[0]);
+  const size_t sizeCount = sizeof(writeSizes)/sizeof(writeSizes[0]);
+
+  time_t t;
+  char datebuffer[256];
+
+  size_t i, j;
+
+  double rates[testCount][sizeCount];
+  double cpbs[testCount][sizeCount];
+  bool skipped[testCount];
+
+  // Roughly pixel like data, i.e. runs of the same colour with some
+  // noise, so that the compressing streams have something to work with
+  data = new uint8_t[dataSize];
+  for (i = 0;i < dataSize;i += 4) {
+    if ((i == 0) || (rand() % 8 == 0)) {
+      for (j = 0;j < 4;j++)
+        data[i + j] = rand();
+    } else {
+      memcpy(data + i, data + i - 4, 4);
+    }
+  }
+
+  time(&t);
+  strftime(datebuffer, sizeof(datebuffer), "%Y-%m-%d %H:%M UTC", gmtime(&t));
+
+  printf("# Stream Performance Test %s\n", datebuffer);
+  printf("#\n");
+  printf("# Data per test: %d MiB\n", (int)(totalSize / 1048576));
+  printf("# Flush interval: %d KiB\n", (int)(flushInterval / 1024));
+  printf("#\n");
+  printf("# Note: Results are MB/sec (wall clock) and cycles/byte\n");
+  printf("#\n");
+
+  for (i = 0;i < testCount;i++) {
+    try {
+      Pipeline pipeline(tests[i]);
+      skipped[i] = false;
+    } catch (std::exception& e) {
+      printf("# Skipping %s: %s\n", tests[i], e.what());
+      printf("#\n");
+      skipped[i] = true;
+      continue;
+    }
+
+    for (j = 0;j < sizeCount;j++)
+      doTest(tests[i], writeSizes[j], &rates[i][j], &cpbs[i][j]);
+  }
+
+  printf("MB/sec");
+  for (j = 0;j < sizeCount;j++)
+    printf(",%d", (int)writeSizes[j]);
+  printf("\n");
+
+  for (i = 0;i < testCount;i++) {
+    if (skipped[i])
+      continue;
+    printf("%s", tests[i]);
+    for (j = 0;j < sizeCount;j++)
+      printf(",%g", rates[i][j]);
+    printf("\n");
+  }
+
+#ifdef HAVE_TSC
+  printf("\n");
+
+  printf("Cycles/byte");
+  for (j = 0;j < sizeCount;j++)
+    printf(",%d", (int)writeSizes[j]);
+  printf("\n");
+
+  for (i = 0;i < testCount;i++) {
+    if (skipped[i])
+      continue;
+    printf("%s", tests[i]);
+    for (j = 0;j < sizeCount;j++)
+      printf(",%g", cpbs[i][j]);
+    printf("\n");
+  }
+#endif
+
+  delete [] data;
+
+  return 0;
+}
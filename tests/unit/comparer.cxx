@@ -0,0 +1,135 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <core/Rect.h>
+#include <core/Region.h>
+
+#include <rfb/ComparingUpdateTracker.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/UpdateTracker.h>
+
+static const rfb::PixelFormat pf(32, 24, false, true,
+                                 255, 255, 255, 16, 8, 0);
+
+static void draw(rfb::ManagedPixelBuffer* pb, const core::Rect& r,
+                 uint32_t colour)
+{
+  pb->fillRect(r, &colour);
+}
+
+static core::Region update(rfb::ComparingUpdateTracker* tracker,
+                           const core::Region& damage)
+{
+  rfb::UpdateInfo ui;
+
+  tracker->add_changed(damage);
+  tracker->compare();
+  tracker->getUpdateInfo(&ui, core::Rect(0, 0, 1000, 1000));
+  tracker->clear();
+
+  return ui.changed;
+}
+
+class ComparingUpdateTracker : public ::testing::TestWithParam<bool> {
+};
+
+TEST_P(ComparingUpdateTracker, unchanged)
+{
+  rfb::ManagedPixelBuffer pb(pf, 300, 200);
+  rfb::ComparingUpdateTracker tracker(&pb);
+
+  draw(&pb, pb.getRect(), 0x000000);
+
+  tracker.setHashing(GetParam());
+  tracker.compare();
+  tracker.clear();
+
+  EXPECT_TRUE(update(&tracker, pb.getRect()).is_empty());
+  EXPECT_TRUE(update(&tracker, {{10, 20, 150, 70}}).is_empty());
+}
+
+TEST_P(ComparingUpdateTracker, changed)
+{
+  rfb::ManagedPixelBuffer pb(pf, 300, 200);
+  rfb::ComparingUpdateTracker tracker(&pb);
+  core::Region damage, changed;
+
+  draw(&pb, pb.getRect(), 0x000000);
+
+  tracker.setHashing(GetParam());
+  tracker.compare();
+  tracker.clear();
+
+  // Change one pixel in a block, and report more than that
+  draw(&pb, {70, 70, 71, 71}, 0xff0000);
+  damage = core::Rect(10, 10, 290, 190);
+  changed = update(&tracker, damage);
+
+  EXPECT_FALSE(changed.intersect({{70, 70, 71, 71}}).is_empty());
+  EXPECT_TRUE(changed.subtract(damage).is_empty());
+  // Never more than the block the pixel is in
+  EXPECT_TRUE(changed.subtract({{64, 64, 128, 128}}).is_empty());
+
+  // Not reported again
+  EXPECT_TRUE(update(&tracker, damage).is_empty());
+
+  // Something at the edge of the framebuffer
+  draw(&pb, {299, 199, 300, 200}, 0x00ff00);
+  changed = update(&tracker, pb.getRect());
+  EXPECT_FALSE(changed.intersect({{299, 199, 300, 200}}).is_empty());
+  EXPECT_TRUE(changed.subtract({{256, 192, 300, 200}}).is_empty());
+}
+
+TEST_P(ComparingUpdateTracker, copied)
+{
+  rfb::ManagedPixelBuffer pb(pf, 300, 200);
+  rfb::ComparingUpdateTracker tracker(&pb);
+  core::Region changed;
+
+  draw(&pb, pb.getRect(), 0x000000);
+
+  tracker.setHashing(GetParam());
+  tracker.compare();
+  tracker.clear();
+
+  // Move something on screen, and then put back what was there
+  // before the copy
+  draw(&pb, {0, 0, 64, 64}, 0x0000ff);
+  update(&tracker, {{0, 0, 64, 64}});
+
+  pb.copyRect({128, 0, 192, 64}, {128, 0});
+  tracker.add_copied({{128, 0, 192, 64}}, {128, 0});
+  tracker.compare();
+  tracker.clear();
+
+  draw(&pb, {128, 0, 192, 64}, 0x000000);
+  changed = update(&tracker, {{128, 0, 192, 64}});
+  EXPECT_FALSE(changed.is_empty());
+}
+
+INSTANTIATE_TEST_SUITE_P(, ComparingUpdateTracker,
+                         ::testing::Values(false, true),
+                         [](const ::testing::TestParamInfo<bool>& param) {
+                           return param.param ? "hashes" : "copy";
+                         });
@@ -20,13 +20,17 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <list>
 
 #include <gtest/gtest.h>
 
+#include <rfb/Cursor.h>
+#include <rfb/PixelBuffer.h>
 #include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
 
 static const uint8_t pixelRed = 0xf1;
 static const uint8_t pixelGreen = 0xc3;
@@ -270,6 +274,137 @@ TEST_P(Conv, pixelToFromRGB)
   verifyPixel(dstpf, srcpf, buffer);
 }
 
+TEST_P(Conv, accelerated)
+{
+  int i, w;
+  uint8_t bufIn[fbMalloc], bufRGB[fbMalloc];
+  uint8_t bufOut[fbMalloc], bufRef[fbMalloc];
+
+  const rfb::PixelFormat &srcpf = GetParam().first;
+  const rfb::PixelFormat &dstpf = GetParam().second;
+
+  for (i = 0;i < fbMalloc;i++)
+    bufIn[i] = rand();
+
+  // The vectorised code must give exactly the same result as the
+  // generic code, including for odd widths
+  for (w = 1;w < fbWidth;w += 7) {
+    rfb::simd::init(false);
+
+    memset(bufRef, 0, sizeof(bufRef));
+    dstpf.bufferFromBuffer(bufRef, srcpf, bufIn, w, fbHeight,
+                           fbWidth, fbWidth);
+
+    rfb::simd::init();
+
+    memset(bufOut, 0, sizeof(bufOut));
+    dstpf.bufferFromBuffer(bufOut, srcpf, bufIn, w, fbHeight,
+                           fbWidth, fbWidth);
+
+    EXPECT_EQ(memcmp(bufOut, bufRef, sizeof(bufOut)), 0)
+      << "bufferFromBuffer with width " << w << " using "
+      << rfb::simd::name();
+
+    rfb::simd::init(false);
+
+    memset(bufRef, 0, sizeof(bufRef));
+    srcpf.rgbFromBuffer(bufRef, bufIn, w, fbWidth, fbHeight);
+    memset(bufRGB, 0, sizeof(bufRGB));
+    dstpf.bufferFromRGB(bufRGB, bufRef, w, fbWidth, fbHeight);
+
+    rfb::simd::init();
+
+    memset(bufOut, 0, sizeof(bufOut));
+    srcpf.rgbFromBuffer(bufOut, bufIn, w, fbWidth, fbHeight);
+
+    EXPECT_EQ(memcmp(bufOut, bufRef, sizeof(bufOut)), 0)
+      << "rgbFromBuffer with width " << w << " using "
+      << rfb::simd::name();
+
+    memset(bufOut, 0, sizeof(bufOut));
+    dstpf.bufferFromRGB(bufOut, bufRef, w, fbWidth, fbHeight);
+
+    EXPECT_EQ(memcmp(bufOut, bufRGB, sizeof(bufOut)), 0)
+      << "bufferFromRGB with width " << w << " using "
+      << rfb::simd::name();
+
+    if (testing::Test::HasFailure())
+      return;
+  }
+}
+
+TEST(Blend, accelerated)
+{
+  int i, w;
+  uint8_t cursorData[fbWidth * 5 * 4];
+
+  const rfb::PixelFormat formats[] = {
+    rfb::PixelFormat(32, 24, false, true, 255, 255, 255, 16, 8, 0),
+    rfb::PixelFormat(32, 24, false, true, 255, 255, 255, 0, 8, 16),
+    rfb::PixelFormat(32, 24, true, true, 255, 255, 255, 16, 8, 0),
+    rfb::PixelFormat(32, 24, false, true, 255, 255, 255, 24, 16, 8),
+  };
+
+  for (const rfb::PixelFormat& pf : formats) {
+    rfb::ManagedPixelBuffer fb(pf, fbWidth, fbHeight);
+    uint8_t* buffer;
+    int stride;
+
+    buffer = fb.getBufferRW(fb.getRect(), &stride);
+    for (i = 0;i < fbHeight * stride * 4;i++)
+      buffer[i] = rand();
+    fb.commitBufferRW(fb.getRect());
+
+    // The vectorised code must give exactly the same result as the
+    // generic code, including for odd widths and for fully opaque
+    // and fully transparent pixels
+    for (w = 1;w < fbWidth - 3;w += 7) {
+      rfb::RenderedCursor ref, out;
+      const uint8_t *refBuf, *outBuf;
+      int refStride, outStride;
+
+      for (i = 0;i < w * 5;i++) {
+        cursorData[i * 4 + 0] = rand();
+        cursorData[i * 4 + 1] = rand();
+        cursorData[i * 4 + 2] = rand();
+        switch (rand() % 4) {
+        case 0:
+          cursorData[i * 4 + 3] = 0;
+          break;
+        case 1:
+          cursorData[i * 4 + 3] = 255;
+          break;
+        default:
+          cursorData[i * 4 + 3] = rand();
+        }
+      }
+
+      rfb::Cursor cursor(w, 5, {0, 0}, cursorData);
+
+      rfb::simd::init(false);
+      ref.update(&fb, &cursor, {3, 2});
+
+      rfb::simd::init();
+      out.update(&fb, &cursor, {3, 2});
+
+      ASSERT_EQ(out.getEffectiveRect(), ref.getEffectiveRect());
+
+      refBuf = ref.getBuffer(ref.getEffectiveRect(), &refStride);
+      outBuf = out.getBuffer(out.getEffectiveRect(), &outStride);
+
+      for (i = 0;i < 5;i++) {
+        EXPECT_EQ(memcmp(outBuf + i * outStride * 4,
+                         refBuf + i * refStride * 4, w * 4), 0)
+          << "blend of " << pf << " with width " << w << " using "
+          << rfb::simd::name();
+      }
+
+      if (testing::Test::HasFailure())
+        return;
+    }
+  }
+}
+
 static std::list<TestPair> paramGenerator()
 {
   std::list<TestPair> params;
@@ -291,6 +426,9 @@ static std::list<TestPair> paramGenerator()
   srcpf.parse("rgb232");
   params.push_back(std::make_pair(srcpf, dstpf));
 
+  srcpf.parse("bgr555");
+  params.push_back(std::make_pair(srcpf, dstpf));
+
   /* rgb565 targets */
 
   dstpf.parse("rgb565");
@@ -304,6 +442,16 @@ static std::list<TestPair> paramGenerator()
   srcpf.parse("rgb232");
   params.push_back(std::make_pair(srcpf, dstpf));
 
+  /* rgb555 targets */
+
+  dstpf.parse("rgb555");
+
+  srcpf.parse("rgb888");
+  params.push_back(std::make_pair(srcpf, dstpf));
+
+  srcpf.parse("bgr888");
+  params.push_back(std::make_pair(srcpf, dstpf));
+
   /* rgb232 targets */
 
   dstpf.parse("rgb232");
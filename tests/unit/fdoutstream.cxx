@@ -0,0 +1,200 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <rdr/FdOutStream.h>
+
+class FdOutStreamWriter : public ::testing::Test {
+protected:
+  void SetUp() override
+  {
+    signal(SIGPIPE, SIG_IGN);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  }
+
+  void TearDown() override
+  {
+    if (fds[0] != -1)
+      close(fds[0]);
+    if (fds[1] != -1)
+      close(fds[1]);
+  }
+
+  // Reads everything up until the given length, or until nothing has
+  // arrived for a while
+  std::vector<uint8_t> receive(size_t length)
+  {
+    std::vector<uint8_t> data;
+
+    while (data.size() < length) {
+      struct pollfd pfd;
+      uint8_t buf[65536];
+      ssize_t n;
+
+      pfd.fd = fds[1];
+      pfd.events = POLLIN;
+      if (poll(&pfd, 1, 1000) <= 0)
+        break;
+
+      n = read(fds[1], buf, sizeof(buf));
+      if (n <= 0)
+        break;
+
+      data.insert(data.end(), buf, buf + n);
+    }
+
+    return data;
+  }
+
+  int fds[2];
+};
+
+static std::vector<uint8_t> pattern(size_t length)
+{
+  std::vector<uint8_t> data(length);
+
+  for (size_t i = 0; i < length; i++)
+    data[i] = i * 7 + i / 251;
+
+  return data;
+}
+
+TEST_F(FdOutStreamWriter, order)
+{
+  rdr::FdOutStream os(fds[0]);
+  std::vector<uint8_t> data;
+
+  os.startWriter();
+
+  // Much more than the socket will take, written in various ways
+  data = pattern(4 * 1024 * 1024);
+  for (size_t i = 0; i < data.size(); ) {
+    size_t len;
+
+    len = std::min((i % 3) * 40000 + 17, data.size() - i);
+    os.writeBytes(data.data() + i, len);
+    if (i % 5 == 0)
+      os.flush();
+
+    i += len;
+  }
+  os.flush();
+
+  EXPECT_FALSE(os.hasBufferedData());
+  EXPECT_EQ(os.length(), data.size());
+
+  EXPECT_EQ(receive(data.size()), data);
+
+  // The writer thread might not have caught up with itself yet
+  for (int i = 0; (i < 1000) && (os.queuedData() > 0); i++)
+    usleep(1000);
+
+  EXPECT_EQ(os.queuedData(), 0U);
+  EXPECT_TRUE(os.stopWriter());
+}
+
+TEST_F(FdOutStreamWriter, stop)
+{
+  rdr::FdOutStream os(fds[0]);
+  std::vector<uint8_t> data;
+
+  os.startWriter();
+
+  // Nothing reads this, so it can't all get written
+  data = pattern(4 * 1024 * 1024);
+  os.writeBytes(data.data(), data.size());
+  os.flush();
+
+  EXPECT_GT(os.queuedData(), 0U);
+  EXPECT_FALSE(os.stopWriter());
+  EXPECT_EQ(os.queuedData(), 0U);
+
+  // And back to writing directly
+  receive(data.size());
+  os.writeU32(0x12345678);
+  os.flush();
+  EXPECT_FALSE(os.hasBufferedData());
+  EXPECT_EQ(receive(4).size(), 4U);
+}
+
+TEST_F(FdOutStreamWriter, drain)
+{
+  rdr::FdOutStream os(fds[0]);
+  std::vector<uint8_t> data, received;
+  std::thread reader;
+
+  os.startWriter();
+
+  data = pattern(4 * 1024 * 1024);
+  os.writeBytes(data.data(), data.size());
+  os.flush();
+
+  EXPECT_GT(os.queuedData(), 0U);
+
+  // A peer that is slow to start reading still gets everything
+  reader = std::thread([&]() {
+    usleep(100000);
+    received = receive(data.size());
+  });
+
+  EXPECT_TRUE(os.stopWriter());
+
+  reader.join();
+  EXPECT_EQ(received, data);
+}
+
+TEST_F(FdOutStreamWriter, error)
+{
+  rdr::FdOutStream os(fds[0]);
+
+  os.startWriter();
+
+  close(fds[1]);
+  fds[1] = -1;
+
+  // The writer thread will notice eventually
+  EXPECT_THROW({
+    for (int i = 0; i < 1000; i++) {
+      os.writeU32(0x12345678);
+      os.flush();
+      usleep(1000);
+    }
+  }, std::exception);
+
+  // And keeps complaining, even with nothing new to write
+  EXPECT_THROW(os.queuedData(), std::exception);
+  EXPECT_THROW(os.flush(), std::exception);
+
+  EXPECT_FALSE(os.stopWriter());
+}
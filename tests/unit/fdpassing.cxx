@@ -0,0 +1,294 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <gtest/gtest.h>
+
+#include <rdr/FdInStream.h>
+#include <rdr/FdOutStream.h>
+
+#include <rfb/Exception.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/SharedMemoryPixelBuffer.h>
+
+class FdPassing : public ::testing::Test {
+protected:
+  void SetUp() override
+  {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ASSERT_EQ(pipe(pipeFds), 0);
+  }
+
+  void TearDown() override
+  {
+    close(fds[0]);
+    close(fds[1]);
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+  }
+
+  // Waits until the given amount of data has arrived on the stream
+  bool waitData(rdr::FdInStream* is, size_t length)
+  {
+    while (!is->hasData(length)) {
+      struct pollfd pfd;
+
+      pfd.fd = fds[1];
+      pfd.events = POLLIN;
+      if (poll(&pfd, 1, 1000) <= 0)
+        return false;
+    }
+
+    return true;
+  }
+
+  // Checks that fd is the write end of our pipe by sending something
+  // through it
+  void expectPipe(int fd, uint8_t marker)
+  {
+    uint8_t buf;
+
+    ASSERT_EQ(write(fd, &marker, 1), 1);
+    ASSERT_EQ(read(pipeFds[0], &buf, 1), 1);
+    EXPECT_EQ(buf, marker);
+  }
+
+  int fds[2];
+  int pipeFds[2];
+};
+
+TEST_F(FdPassing, single)
+{
+  rdr::FdOutStream os(fds[0]);
+  rdr::FdInStream is(fds[1]);
+  int fd;
+
+  is.enableFdPassing();
+
+  os.writeU32(0x01020304);
+  os.attachFd(pipeFds[1]);
+  os.flush();
+
+  ASSERT_TRUE(waitData(&is, 4));
+  EXPECT_EQ(is.readU32(), 0x01020304U);
+
+  fd = is.takeFd();
+  ASSERT_GE(fd, 0);
+  EXPECT_NE(fd, pipeFds[1]);
+  EXPECT_NE(fcntl(fd, F_GETFD) & FD_CLOEXEC, 0);
+  expectPipe(fd, 0x42);
+  close(fd);
+
+  EXPECT_EQ(is.takeFd(), -1);
+
+  // The stream sent a copy, so ours should still work
+  expectPipe(pipeFds[1], 0x43);
+}
+
+TEST_F(FdPassing, order)
+{
+  rdr::FdOutStream os(fds[0]);
+  rdr::FdInStream is(fds[1]);
+  int pipes[3][2];
+  int fd;
+
+  is.enableFdPassing();
+
+  for (int i = 0; i < 3; i++)
+    ASSERT_EQ(pipe(pipes[i]), 0);
+
+  os.attachFd(pipes[0][1]);
+  os.writeU8(1);
+  os.flush();
+  os.attachFd(pipes[1][1]);
+  os.attachFd(pipes[2][1]);
+  os.writeU8(2);
+  os.flush();
+
+  ASSERT_TRUE(waitData(&is, 2));
+  EXPECT_EQ(is.readU8(), 1);
+  EXPECT_EQ(is.readU8(), 2);
+
+  for (int i = 0; i < 3; i++) {
+    uint8_t buf;
+
+    fd = is.takeFd();
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, "x", 1), 1);
+    EXPECT_EQ(read(pipes[i][0], &buf, 1), 1);
+    close(fd);
+  }
+
+  EXPECT_EQ(is.takeFd(), -1);
+
+  for (int i = 0; i < 3; i++) {
+    close(pipes[i][0]);
+    close(pipes[i][1]);
+  }
+}
+
+TEST_F(FdPassing, writer)
+{
+  rdr::FdOutStream os(fds[0]);
+  rdr::FdInStream is(fds[1]);
+  int fd;
+
+  is.enableFdPassing();
+
+  // Descriptors must also get through the writer thread
+  os.startWriter();
+
+  os.writeU32(0x01020304);
+  os.attachFd(pipeFds[1]);
+  os.writeU32(0x05060708);
+  os.flush();
+
+  ASSERT_TRUE(waitData(&is, 8));
+  EXPECT_EQ(is.readU32(), 0x01020304U);
+  EXPECT_EQ(is.readU32(), 0x05060708U);
+
+  fd = is.takeFd();
+  ASSERT_GE(fd, 0);
+  expectPipe(fd, 0x42);
+  close(fd);
+
+  EXPECT_TRUE(os.stopWriter());
+}
+
+TEST_F(FdPassing, disabled)
+{
+  rdr::FdOutStream os(fds[0]);
+  rdr::FdInStream is(fds[1]);
+
+  // Descriptors are dropped unless asked for
+  os.writeU32(0x01020304);
+  os.attachFd(pipeFds[1]);
+  os.flush();
+
+  ASSERT_TRUE(waitData(&is, 4));
+  EXPECT_EQ(is.readU32(), 0x01020304U);
+  EXPECT_EQ(is.takeFd(), -1);
+}
+
+TEST_F(FdPassing, limit)
+{
+  rdr::FdOutStream os(fds[0]);
+  rdr::FdInStream is(fds[1]);
+
+  is.enableFdPassing();
+
+  // Nobody is taking these, so they must not pile up
+  for (int i = 0; i < 17; i++) {
+    os.writeU8(i);
+    os.attachFd(pipeFds[1]);
+    os.flush();
+  }
+
+  EXPECT_THROW(waitData(&is, 17), std::runtime_error);
+}
+
+TEST_F(FdPassing, truncated)
+{
+  rdr::FdOutStream os(fds[0]);
+  rdr::FdInStream is(fds[1]);
+
+  is.enableFdPassing();
+
+  // More in one go than fits, so the kernel has to drop some
+  os.writeU8(0);
+  for (int i = 0; i < 64; i++)
+    os.attachFd(pipeFds[1]);
+  os.flush();
+
+  EXPECT_THROW(waitData(&is, 1), std::runtime_error);
+}
+
+#ifdef HAVE_MEMFD_CREATE
+TEST_F(FdPassing, sharedMemory)
+{
+  rfb::PixelFormat pf(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+  rdr::FdOutStream os(fds[0]);
+  rdr::FdInStream is(fds[1]);
+  uint32_t pixel;
+  const uint8_t* data;
+  int stride;
+
+  is.enableFdPassing();
+
+  rfb::SharedMemoryPixelBuffer server(pf, 16, 8);
+  pixel = 0x123456;
+  server.fillRect({0, 0, 16, 8}, &pixel);
+
+  os.writeU8(0);
+  os.attachFd(server.getFd());
+  os.flush();
+
+  ASSERT_TRUE(waitData(&is, 1));
+  is.skip(1);
+
+  rfb::SharedMemoryPixelBuffer viewer(is.takeFd(), pf, 16, 8,
+                                      server.getStride());
+
+  data = viewer.getBuffer({3, 4, 4, 5}, &stride);
+  EXPECT_EQ(*(const uint32_t*)data, 0x123456U);
+
+  // Later drawing shows up without anything more being sent
+  pixel = 0x654321;
+  server.fillRect({3, 4, 4, 5}, &pixel);
+  EXPECT_EQ(*(const uint32_t*)data, 0x654321U);
+
+  // The viewer only gets to look
+  EXPECT_DEATH({
+    int s;
+    *viewer.getBufferRW({0, 0, 1, 1}, &s) = 0;
+  }, "");
+}
+
+TEST_F(FdPassing, sharedMemoryLayout)
+{
+  rfb::PixelFormat pf(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+  rfb::SharedMemoryPixelBuffer server(pf, 16, 8);
+
+  // A layout that doesn't fit the memory must never get mapped, even
+  // if the size calculation would wrap around
+  EXPECT_THROW(rfb::SharedMemoryPixelBuffer(dup(server.getFd()), pf,
+                                            16, 9, 16),
+               rfb::protocol_error);
+  EXPECT_THROW(rfb::SharedMemoryPixelBuffer(dup(server.getFd()), pf,
+                                            16, 8, 15),
+               rfb::protocol_error);
+  EXPECT_THROW(rfb::SharedMemoryPixelBuffer(dup(server.getFd()), pf,
+                                            16, -8, 16),
+               rfb::protocol_error);
+  EXPECT_THROW(rfb::SharedMemoryPixelBuffer(dup(server.getFd()), pf,
+                                            16, INT_MAX, INT_MAX),
+               rfb::protocol_error);
+  EXPECT_THROW(rfb::SharedMemoryPixelBuffer(dup(server.getFd()), pf,
+                                            16, 0x40000000, 16),
+               rfb::protocol_error);
+}
+#endif
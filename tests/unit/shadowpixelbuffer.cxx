@@ -0,0 +1,182 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <core/Rect.h>
+#include <core/Region.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/SDesktop.h>
+#include <rfb/ShadowPixelBuffer.h>
+#include <rfb/VNCServerST.h>
+
+static const rfb::PixelFormat rgb888(32, 24, false, true,
+                                     255, 255, 255, 16, 8, 0);
+static const rfb::PixelFormat bgr888(32, 24, false, true,
+                                     255, 255, 255, 0, 8, 16);
+static const rfb::PixelFormat rgb565(16, 16, false, true,
+                                     31, 63, 31, 11, 5, 0);
+
+static void fill(rfb::ModifiablePixelBuffer* pb, const core::Rect& r,
+                 uint8_t red, uint8_t green, uint8_t blue)
+{
+  uint8_t rgb[3] = { red, green, blue };
+  uint8_t pix[4];
+
+  pb->getPF().bufferFromRGB(pix, rgb, 1);
+  pb->fillRect(r, pix);
+}
+
+static uint8_t red(const rfb::PixelBuffer* pb, int x, int y)
+{
+  const uint8_t* buffer;
+  uint8_t rgb[3];
+  int stride;
+
+  buffer = pb->getBuffer({x, y, x + 1, y + 1}, &stride);
+  pb->getPF().rgbFromBuffer(rgb, buffer, 1);
+
+  return rgb[0];
+}
+
+TEST(ShadowPixelBuffer, convert)
+{
+  rfb::ManagedPixelBuffer source(rgb888, 64, 32);
+  rfb::ShadowPixelBuffer shadow(bgr888, &source);
+
+  EXPECT_EQ(shadow.getRect(), source.getRect());
+  EXPECT_EQ(shadow.getPF(), bgr888);
+  EXPECT_EQ(shadow.getSource(), &source);
+
+  fill(&source, source.getRect(), 0x10, 0x20, 0x30);
+  fill(&shadow, shadow.getRect(), 0xff, 0xff, 0xff);
+
+  // Everything starts out of date, but only what is asked for gets
+  // converted
+  shadow.update({0, 0, 16, 16});
+  EXPECT_EQ(red(&shadow, 0, 0), 0x10);
+  EXPECT_EQ(red(&shadow, 15, 15), 0x10);
+  EXPECT_EQ(red(&shadow, 16, 0), 0xff);
+  EXPECT_EQ(red(&shadow, 0, 16), 0xff);
+
+  shadow.update(shadow.getRect());
+  EXPECT_EQ(red(&shadow, 63, 31), 0x10);
+}
+
+TEST(ShadowPixelBuffer, damage)
+{
+  rfb::ManagedPixelBuffer source(rgb888, 64, 32);
+  rfb::ShadowPixelBuffer shadow(rgb565, &source);
+
+  fill(&source, source.getRect(), 0x00, 0x00, 0x00);
+  shadow.update(shadow.getRect());
+
+  // Changes that haven't been reported are not picked up
+  fill(&source, {0, 0, 32, 32}, 0xff, 0x00, 0x00);
+  shadow.update(shadow.getRect());
+  EXPECT_EQ(red(&shadow, 0, 0), 0x00);
+
+  // Only the damaged part is converted, and only when asked for
+  shadow.damage(core::Region({0, 0, 16, 16}));
+  EXPECT_EQ(red(&shadow, 0, 0), 0x00);
+  shadow.update({8, 8, 64, 32});
+  EXPECT_EQ(red(&shadow, 0, 0), 0x00);
+  EXPECT_EQ(red(&shadow, 8, 8), 0xff);
+  EXPECT_EQ(red(&shadow, 16, 16), 0x00);
+
+  // And what was left stays out of date
+  shadow.update(shadow.getRect());
+  EXPECT_EQ(red(&shadow, 0, 0), 0xff);
+  EXPECT_EQ(red(&shadow, 16, 16), 0x00);
+
+  // Converted areas aren't converted again
+  fill(&source, {0, 0, 8, 8}, 0x00, 0x00, 0x00);
+  shadow.update(shadow.getRect());
+  EXPECT_EQ(red(&shadow, 0, 0), 0xff);
+}
+
+TEST(ShadowPixelBuffer, setSource)
+{
+  rfb::ManagedPixelBuffer first(rgb888, 64, 32);
+  rfb::ManagedPixelBuffer second(rgb888, 16, 48);
+  rfb::ShadowPixelBuffer shadow(bgr888, &first);
+
+  fill(&first, first.getRect(), 0x10, 0x00, 0x00);
+  shadow.update(shadow.getRect());
+
+  // A new source is new content everywhere
+  fill(&second, second.getRect(), 0x20, 0x00, 0x00);
+  shadow.setSource(&second);
+  EXPECT_EQ(shadow.getSource(), &second);
+  EXPECT_EQ(shadow.getRect(), second.getRect());
+
+  shadow.update(shadow.getRect());
+  EXPECT_EQ(red(&shadow, 0, 0), 0x20);
+  EXPECT_EQ(red(&shadow, 15, 47), 0x20);
+}
+
+class DummyDesktop : public rfb::SDesktop {
+public:
+  void init(rfb::VNCServer*) override {}
+  void queryConnection(network::Socket*, const char*) override {}
+  void terminate() override {}
+};
+
+TEST(ShadowPixelBuffer, sharing)
+{
+  DummyDesktop desktop;
+  rfb::VNCServerST server("test", &desktop);
+  rfb::ManagedPixelBuffer first(rgb888, 64, 32);
+  rfb::ManagedPixelBuffer second(rgb888, 32, 16);
+  rfb::ShadowPixelBuffer *a, *b, *c;
+
+  server.setPixelBuffer(&first);
+
+  // Clients with the same format share a buffer
+  a = server.acquireShadowPixelBuffer(rgb565);
+  b = server.acquireShadowPixelBuffer(rgb565);
+  c = server.acquireShadowPixelBuffer(bgr888);
+  EXPECT_EQ(a, b);
+  EXPECT_NE(a, c);
+  EXPECT_EQ(a->getPF(), rgb565);
+  EXPECT_EQ(c->getPF(), bgr888);
+  EXPECT_EQ(a->getSource(), &first);
+
+  // It stays around until the last user is done with it
+  server.releaseShadowPixelBuffer(b);
+  b = server.acquireShadowPixelBuffer(rgb565);
+  EXPECT_EQ(a, b);
+  server.releaseShadowPixelBuffer(a);
+  server.releaseShadowPixelBuffer(b);
+
+  // The buffers follow the framebuffer
+  server.setPixelBuffer(&second);
+  EXPECT_EQ(c->getSource(), &second);
+  EXPECT_EQ(c->getRect(), second.getRect());
+
+  server.setPixelBuffer(nullptr);
+  EXPECT_EQ(c->getSource(), nullptr);
+
+  server.releaseShadowPixelBuffer(c);
+}
@@ -0,0 +1,331 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <core/Rect.h>
+
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibOutStream.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/PixelFormatSIMD.h>
+#include <rfb/ServerParams.h>
+#include <rfb/TightConstants.h>
+#include <rfb/TightDecoder.h>
+
+static const rfb::PixelFormat rgb888(32, 24, false, true,
+                                     255, 255, 255, 16, 8, 0);
+static const rfb::PixelFormat bgr888(32, 24, true, true,
+                                     255, 255, 255, 0, 8, 16);
+static const rfb::PixelFormat rgb565(16, 16, false, true,
+                                     31, 63, 31, 11, 5, 0);
+
+// Wraps filtered pixel data up as a "basic" Tight rect, compressed on
+// zlib stream 0 when it is large enough to be
+static std::vector<uint8_t> basicRect(const std::vector<uint8_t>& header,
+                                      const std::vector<uint8_t>& data)
+{
+  std::vector<uint8_t> rect;
+
+  rect.push_back(((rfb::tightExplicitFilter << 4) | 0x01));
+  rect.insert(rect.end(), header.begin(), header.end());
+
+  if (data.size() < 12) {
+    rect.insert(rect.end(), data.begin(), data.end());
+    return rect;
+  }
+
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos(&mos);
+  size_t len;
+
+  zos.writeBytes(data.data(), data.size());
+  zos.flush();
+
+  len = mos.length();
+  rect.push_back(len & 0x7f);
+  if (len > 0x7f) {
+    rect.back() |= 0x80;
+    rect.push_back(len >> 7 & 0x7f);
+    if (len > 0x3fff) {
+      rect.back() |= 0x80;
+      rect.push_back(len >> 14 & 0xff);
+    }
+  }
+  rect.insert(rect.end(), (const uint8_t*)mos.data(),
+              (const uint8_t*)mos.data() + len);
+
+  return rect;
+}
+
+static void decode(const std::vector<uint8_t>& rect,
+                   const rfb::PixelFormat& pf, rfb::PixelBuffer* pb)
+{
+  rfb::TightDecoder decoder;
+  rfb::ServerParams server;
+  rdr::MemInStream is(rect.data(), rect.size());
+  rdr::MemOutStream os;
+
+  server.setPF(pf);
+
+  ASSERT_TRUE(decoder.readRect(pb->getRect(), &is, server, &os));
+  EXPECT_EQ(is.avail(), 0U);
+
+  decoder.decodeRect(pb->getRect(), os.data(), os.length(), server,
+                     (rfb::ModifiablePixelBuffer*)pb);
+}
+
+static void gradient(const rfb::PixelFormat& pf, int width, int height)
+{
+  std::vector<uint8_t> expected, data;
+  rfb::ManagedPixelBuffer pb(pf, width, height);
+  const uint8_t* buffer;
+  int stride;
+
+  // A smooth ramp with some noise on top, so both the prediction and
+  // the clamping get exercised
+  expected.resize(width * height * 3);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint8_t* pix = &expected[(y * width + x) * 3];
+      pix[0] = x * 255 / width;
+      pix[1] = y * 255 / height;
+      pix[2] = (x * y) & 0xff;
+      if ((rand() % 4) == 0)
+        pix[rand() % 3] = rand();
+    }
+  }
+
+  // Filtered data is the difference from the predicted value
+  data.resize(expected.size());
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        int left, above, aboveLeft, est;
+
+        left = x > 0 ? expected[(y * width + x - 1) * 3 + c] : 0;
+        above = y > 0 ? expected[((y - 1) * width + x) * 3 + c] : 0;
+        aboveLeft = (x > 0 && y > 0) ?
+                    expected[((y - 1) * width + x - 1) * 3 + c] : 0;
+
+        est = left + above - aboveLeft;
+        if (est > 255)
+          est = 255;
+        else if (est < 0)
+          est = 0;
+
+        data[(y * width + x) * 3 + c] =
+          expected[(y * width + x) * 3 + c] - est;
+      }
+    }
+  }
+
+  decode(basicRect({rfb::tightFilterGradient}, data), pf, &pb);
+
+  buffer = pb.getBuffer(pb.getRect(), &stride);
+  for (int y = 0; y < height; y++) {
+    std::vector<uint8_t> row(width * 3);
+    pf.rgbFromBuffer(row.data(), buffer + y * stride * pf.bpp/8, width);
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        ASSERT_EQ(row[x * 3 + c], expected[(y * width + x) * 3 + c])
+          << "at " << x << "," << y << " channel " << c;
+      }
+    }
+  }
+}
+
+// Formats other than 888 have their differences unpacked to 8 bit
+// channels before they are added to the prediction, so random data is
+// as good as any and the result is worked out the same way
+static void gradientGeneric(const rfb::PixelFormat& pf,
+                            int width, int height)
+{
+  std::vector<uint8_t> data, expected, prevRow, thisRow;
+  rfb::ManagedPixelBuffer pb(pf, width, height);
+  const uint8_t* buffer;
+  int stride, bpp;
+
+  bpp = pf.bpp/8;
+
+  data.resize(width * height * bpp);
+  for (uint8_t& b : data)
+    b = rand();
+
+  expected.resize(data.size());
+  prevRow.assign(width * 3, 0);
+  thisRow.resize(width * 3);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint8_t diff[3];
+
+      pf.rgbFromBuffer(diff, &data[(y * width + x) * bpp], 1);
+
+      for (int c = 0; c < 3; c++) {
+        int left, above, aboveLeft, est;
+
+        left = x > 0 ? thisRow[(x - 1) * 3 + c] : 0;
+        above = prevRow[x * 3 + c];
+        aboveLeft = x > 0 ? prevRow[(x - 1) * 3 + c] : 0;
+
+        est = left + above - aboveLeft;
+        if (est > 255)
+          est = 255;
+        else if (est < 0)
+          est = 0;
+
+        thisRow[x * 3 + c] = diff[c] + est;
+      }
+
+      pf.bufferFromRGB(&expected[(y * width + x) * bpp],
+                       &thisRow[x * 3], 1);
+    }
+
+    prevRow = thisRow;
+  }
+
+  decode(basicRect({rfb::tightFilterGradient}, data), pf, &pb);
+
+  buffer = pb.getBuffer(pb.getRect(), &stride);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      ASSERT_EQ(memcmp(buffer + (y * stride + x) * bpp,
+                       &expected[(y * width + x) * bpp], bpp), 0)
+        << "at " << x << "," << y;
+    }
+  }
+}
+
+static void mono(const rfb::PixelFormat& pf, int width, int height)
+{
+  std::vector<uint8_t> bits;
+  rfb::ManagedPixelBuffer pb(pf, width, height);
+  const uint8_t* buffer;
+  int stride, rowBytes;
+  uint8_t palette[2][3] = { { 0x12, 0x34, 0x56 },
+                            { 0xfe, 0xdc, 0xba } };
+  uint8_t colours[2][4];
+  std::vector<uint8_t> header;
+
+  // Each row starts on a new byte, most significant bit first
+  rowBytes = (width + 7) / 8;
+  bits.resize(rowBytes * height);
+  for (uint8_t& b : bits)
+    b = rand();
+
+  header.push_back(rfb::tightFilterPalette);
+  header.push_back(2 - 1);
+  if (pf.is888()) {
+    header.insert(header.end(), palette[0], palette[0] + 3);
+    header.insert(header.end(), palette[1], palette[1] + 3);
+  } else {
+    uint8_t pix[4];
+    for (int i = 0; i < 2; i++) {
+      pf.bufferFromRGB(pix, palette[i], 1);
+      header.insert(header.end(), pix, pix + pf.bpp/8);
+    }
+  }
+
+  decode(basicRect(header, bits), pf, &pb);
+
+  for (int i = 0; i < 2; i++)
+    pf.bufferFromRGB(colours[i], palette[i], 1);
+
+  buffer = pb.getBuffer(pb.getRect(), &stride);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      int index = bits[y * rowBytes + x / 8] >> (7 - x % 8) & 1;
+      const uint8_t* pix = buffer + (y * stride + x) * pf.bpp/8;
+      ASSERT_EQ(memcmp(pix, colours[index], pf.bpp/8), 0)
+        << "at " << x << "," << y;
+    }
+  }
+}
+
+TEST(TightDecoder, gradient)
+{
+  gradient(rgb888, 64, 32);
+  gradient(bgr888, 64, 32);
+}
+
+TEST(TightDecoder, gradientOdd)
+{
+  gradient(rgb888, 37, 19);
+  gradient(rgb888, 1, 5);
+  gradient(rgb888, 2048, 2);
+}
+
+TEST(TightDecoder, gradient16)
+{
+  gradientGeneric(rgb565, 64, 32);
+  gradientGeneric(rgb565, 37, 19);
+  gradientGeneric(rgb565, 1, 5);
+}
+
+TEST(TightDecoder, gradientSIMD)
+{
+  // Rows are decoded in blocks, so every combination of a partial
+  // block and a short row needs to be covered
+  for (int enable = 0; enable < 2; enable++) {
+    rfb::simd::init(enable);
+    SCOPED_TRACE(rfb::simd::name());
+
+    for (int width = 1; width <= 9; width++) {
+      for (int height = 1; height <= 9; height++) {
+        gradient(rgb888, width, height);
+        gradientGeneric(rgb565, width, height);
+      }
+    }
+
+    gradient(bgr888, 2048, 9);
+    gradientGeneric(rgb565, 2048, 9);
+  }
+}
+
+TEST(TightDecoder, gradientUncompressed)
+{
+  // Below the compression threshold
+  gradient(rgb888, 3, 1);
+}
+
+TEST(TightDecoder, mono)
+{
+  mono(rgb888, 64, 32);
+  mono(bgr888, 64, 32);
+  mono(rgb565, 64, 32);
+}
+
+TEST(TightDecoder, monoOdd)
+{
+  for (int width = 1; width <= 17; width++) {
+    mono(rgb888, width, 7);
+    mono(rgb565, width, 7);
+  }
+}
@@ -0,0 +1,150 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+
+#include <rfb/Palette.h>
+#include <rfb/PixelBuffer.h>
+#include <rfb/PixelFormat.h>
+#include <rfb/SConnection.h>
+#include <rfb/ServerParams.h>
+#include <rfb/TightDecoder.h>
+#include <rfb/TightEncoder.h>
+
+static const rfb::PixelFormat rgb888(32, 24, false, true,
+                                     255, 255, 255, 16, 8, 0);
+
+// The encoder only needs somewhere to write its rects
+class SConn : public rfb::SConnection {
+public:
+  SConn() : SConnection(rfb::AccessDefault) {
+    setStreams(nullptr, &out);
+  }
+
+  void setDesktopSize(int, int, const rfb::ScreenSet&) override {}
+  void keyEvent(uint32_t, uint32_t, bool) override {}
+  void pointerEvent(const core::Point&, uint16_t) override {}
+
+  rdr::MemOutStream out;
+};
+
+// Encodes a rect and decodes it again, and returns the compression
+// control byte that the encoder used
+static uint8_t roundTrip(SConn* conn, rfb::TightEncoder* encoder,
+                         rfb::TightDecoder* decoder,
+                         const rfb::PixelBuffer* pb,
+                         const rfb::Palette& palette)
+{
+  rfb::ServerParams server;
+  rfb::ManagedPixelBuffer out(pb->getPF(), pb->width(), pb->height());
+  rdr::MemOutStream buf;
+  const uint8_t *expected, *actual;
+  int expectedStride, actualStride;
+  uint8_t control;
+
+  server.setPF(pb->getPF());
+
+  conn->out.clear();
+  encoder->writeRect(pb, palette);
+
+  control = *(const uint8_t*)conn->out.data();
+
+  rdr::MemInStream is(conn->out.data(), conn->out.length());
+  EXPECT_TRUE(decoder->readRect(pb->getRect(), &is, server, &buf));
+  EXPECT_EQ(is.avail(), 0U);
+
+  decoder->decodeRect(pb->getRect(), buf.data(), buf.length(), server,
+                      &out);
+
+  expected = pb->getBuffer(pb->getRect(), &expectedStride);
+  actual = out.getBuffer(out.getRect(), &actualStride);
+  for (int y = 0; y < pb->height(); y++) {
+    EXPECT_EQ(memcmp(actual + y * actualStride * 4,
+                     expected + y * expectedStride * 4,
+                     pb->width() * 4), 0)
+      << "at row " << y;
+  }
+
+  return control;
+}
+
+TEST(TightEncoder, releaseMemory)
+{
+  SConn conn;
+  rfb::TightEncoder encoder(&conn);
+  rfb::TightDecoder decoder;
+  rfb::ManagedPixelBuffer noise(rgb888, 64, 16);
+  rfb::ManagedPixelBuffer mono(rgb888, 64, 16);
+  rfb::Palette noColours, twoColours;
+  uint32_t* buffer;
+  int stride;
+
+  // Full colour rects use zlib stream 0
+  buffer = (uint32_t*)noise.getBufferRW(noise.getRect(), &stride);
+  for (int y = 0; y < 16; y++) {
+    for (int x = 0; x < 64; x++)
+      buffer[y * stride + x] = rand() & 0xffffff;
+  }
+  noise.commitBufferRW(noise.getRect());
+
+  // Two colour rects use zlib stream 1
+  buffer = (uint32_t*)mono.getBufferRW(mono.getRect(), &stride);
+  for (int y = 0; y < 16; y++) {
+    for (int x = 0; x < 64; x++)
+      buffer[y * stride + x] = (rand() % 2) ? 0x123456 : 0xfedcba;
+  }
+  mono.commitBufferRW(mono.getRect());
+  twoColours.insert(0x123456, 1);
+  twoColours.insert(0xfedcba, 1);
+
+  EXPECT_EQ(roundTrip(&conn, &encoder, &decoder, &noise, noColours),
+            0x00);
+  EXPECT_EQ(roundTrip(&conn, &encoder, &decoder, &mono, twoColours),
+            0x50);
+
+  // Both streams are reset, and the client is told so with the very
+  // next rect, but only that one
+  encoder.releaseMemory();
+
+  EXPECT_EQ(roundTrip(&conn, &encoder, &decoder, &noise, noColours),
+            0x03);
+  EXPECT_EQ(roundTrip(&conn, &encoder, &decoder, &mono, twoColours),
+            0x50);
+  EXPECT_EQ(roundTrip(&conn, &encoder, &decoder, &noise, noColours),
+            0x00);
+
+  // Only streams that have been used since need resetting
+  encoder.releaseMemory();
+  EXPECT_EQ(roundTrip(&conn, &encoder, &decoder, &mono, twoColours),
+            0x53);
+  encoder.releaseMemory();
+  EXPECT_EQ(roundTrip(&conn, &encoder, &decoder, &noise, noColours),
+            0x02);
+  EXPECT_EQ(roundTrip(&conn, &encoder, &decoder, &mono, twoColours),
+            0x50);
+}
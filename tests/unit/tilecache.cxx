@@ -0,0 +1,145 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <core/Rect.h>
+
+#include <rfb/PixelBuffer.h>
+#include <rfb/TileCache.h>
+
+// Tiles that fill exactly a quarter of the cache
+static const int quarter = 1024;
+static_assert(quarter * quarter * 2 * 4 == rfb::TileCache::maxPixels,
+              "Test assumes a specific cache size");
+
+TEST(TileCache, lookup)
+{
+  rfb::TileCache cache;
+
+  EXPECT_EQ(cache.lookup(1), nullptr);
+
+  cache.insert(1, 16, 16);
+  cache.insert(2, 32, 32);
+
+  ASSERT_NE(cache.lookup(1), nullptr);
+  EXPECT_EQ(cache.lookup(1)->width, 16);
+  ASSERT_NE(cache.lookup(2), nullptr);
+  EXPECT_EQ(cache.lookup(2)->height, 32);
+  EXPECT_EQ(cache.lookup(3), nullptr);
+
+  EXPECT_EQ(cache.numTiles(), 2U);
+  EXPECT_EQ(cache.numPixels(), 16U * 16 + 32 * 32);
+}
+
+TEST(TileCache, replace)
+{
+  rfb::TileCache cache;
+
+  cache.insert(1, 16, 16)->lossy = true;
+  cache.insert(1, 8, 8);
+
+  ASSERT_NE(cache.lookup(1), nullptr);
+  EXPECT_EQ(cache.lookup(1)->width, 8);
+  EXPECT_FALSE(cache.lookup(1)->lossy);
+
+  EXPECT_EQ(cache.numTiles(), 1U);
+  EXPECT_EQ(cache.numPixels(), 8U * 8);
+}
+
+TEST(TileCache, evict)
+{
+  rfb::TileCache cache;
+
+  for (int i = 0; i < 4; i++)
+    cache.insert(i, quarter * 2, quarter);
+
+  cache.insert(4, 1, 1);
+
+  EXPECT_EQ(cache.peek(0), nullptr);
+  EXPECT_NE(cache.peek(1), nullptr);
+  EXPECT_NE(cache.peek(4), nullptr);
+}
+
+TEST(TileCache, evictUsed)
+{
+  rfb::TileCache cache;
+
+  for (int i = 0; i < 4; i++)
+    cache.insert(i, quarter * 2, quarter);
+
+  cache.lookup(0);
+  cache.insert(4, 1, 1);
+
+  EXPECT_NE(cache.peek(0), nullptr);
+  EXPECT_EQ(cache.peek(1), nullptr);
+}
+
+TEST(TileCache, peek)
+{
+  rfb::TileCache cache;
+
+  for (int i = 0; i < 4; i++)
+    cache.insert(i, quarter * 2, quarter);
+
+  cache.peek(0);
+  cache.insert(4, 1, 1);
+
+  EXPECT_EQ(cache.peek(0), nullptr);
+}
+
+TEST(TileCache, clear)
+{
+  rfb::TileCache cache;
+
+  cache.insert(1, 16, 16);
+  cache.clear();
+
+  EXPECT_EQ(cache.lookup(1), nullptr);
+  EXPECT_EQ(cache.numTiles(), 0U);
+  EXPECT_EQ(cache.numPixels(), 0U);
+}
+
+TEST(TileCache, hash)
+{
+  rfb::PixelFormat pf(32, 24, false, true, 255, 255, 255, 16, 8, 0);
+  rfb::ManagedPixelBuffer pb(pf, 64, 64);
+  const uint8_t black[4] = { 0, 0, 0, 0 };
+  const uint8_t white[4] = { 0xff, 0xff, 0xff, 0 };
+  uint64_t a, b;
+
+  pb.fillRect(pb.getRect(), black);
+
+  // Same contents in different places
+  a = rfb::TileCache::hashRect(&pb, {0, 0, 16, 16});
+  b = rfb::TileCache::hashRect(&pb, {16, 32, 32, 48});
+  EXPECT_EQ(a, b);
+
+  // Same number of pixels, but different shape
+  b = rfb::TileCache::hashRect(&pb, {0, 0, 32, 8});
+  EXPECT_NE(a, b);
+
+  // A single pixel difference
+  pb.fillRect({15, 15, 16, 16}, white);
+  b = rfb::TileCache::hashRect(&pb, {0, 0, 16, 16});
+  EXPECT_NE(a, b);
+}
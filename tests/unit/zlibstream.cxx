@@ -0,0 +1,121 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <rdr/MemInStream.h>
+#include <rdr/MemOutStream.h>
+#include <rdr/ZlibInStream.h>
+#include <rdr/ZlibOutStream.h>
+
+static std::vector<uint8_t> inflate(rdr::ZlibInStream* zis,
+                                    rdr::InStream* is, size_t bytesIn,
+                                    size_t length)
+{
+  std::vector<uint8_t> data(length);
+
+  zis->setUnderlying(is, bytesIn);
+  for (size_t i = 0; i < length; i += 1000) {
+    size_t len;
+
+    len = std::min(length - i, (size_t)1000);
+    if (!zis->hasData(len))
+      break;
+    zis->readBytes(data.data() + i, len);
+  }
+  zis->flushUnderlying();
+
+  return data;
+}
+
+TEST(ZlibOutStream, lazy)
+{
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos(&mos, 2);
+
+  EXPECT_EQ(zos.getMemoryUsage(), 0U);
+
+  zos.writeU32(0x12345678);
+  zos.flush();
+
+  EXPECT_GT(zos.getMemoryUsage(), 0U);
+}
+
+TEST(ZlibOutStream, reset)
+{
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos(&mos, 2);
+  std::vector<uint8_t> first, second;
+  size_t firstLen;
+
+  // Something that compresses well, followed by something that
+  // doesn't, so the dictionary from the first part would be no help
+  for (int i = 0; i < 5000; i++) {
+    char line[64];
+
+    snprintf(line, sizeof(line), "Line %d of the first part\n", i);
+    first.insert(first.end(), line, line + strlen(line));
+  }
+
+  second.resize(100000);
+  for (uint8_t& b : second)
+    b = rand();
+
+  zos.writeBytes(first.data(), first.size());
+  zos.flush();
+  firstLen = mos.length();
+
+  zos.reset();
+  EXPECT_EQ(zos.getMemoryUsage(), 0U);
+
+  zos.writeBytes(second.data(), second.size());
+  zos.flush();
+
+  rdr::MemInStream mis(mos.data(), mos.length());
+  rdr::ZlibInStream zis;
+
+  EXPECT_EQ(inflate(&zis, &mis, firstLen, first.size()), first);
+
+  // The second part is a new stream, so this has to start over
+  zis.reset();
+  EXPECT_EQ(inflate(&zis, &mis, mos.length() - firstLen,
+                    second.size()), second);
+}
+
+TEST(ZlibOutStream, resetBuffered)
+{
+  rdr::MemOutStream mos;
+  rdr::ZlibOutStream zos(&mos, 2);
+
+  zos.writeU32(0x12345678);
+  EXPECT_THROW(zos.reset(), std::logic_error);
+
+  zos.flush();
+  EXPECT_NO_THROW(zos.reset());
+}
@@ -73,6 +73,11 @@ core::IntParameter
                         "connection' dialog before rejecting the "
                         "connection"),
                       10, 0, INT_MAX);
+core::BoolParameter
+  threadedEncoding("ThreadedEncoding",
+                   _("Encode framebuffer updates on a separate thread, "
+                     "so that the X server can keep running meanwhile"),
+                   false);
 
 
 XserverDesktop::XserverDesktop(int screenIndex_,
@@ -88,6 +93,9 @@ XserverDesktop::XserverDesktop(int screenIndex_,
   format = pf;
 
   server = new rfb::VNCServerST(name, this);
+  server->setThreadedEncoding(threadedEncoding);
+  if (server->getEncodeFd() != -1)
+    vncSetNotifyFd(server->getEncodeFd(), screenIndex, true, false);
   setFramebuffer(width, height, fbptr, stride_);
 
   for (network::SocketListener* listener : listeners)
@@ -101,6 +109,8 @@ XserverDesktop::~XserverDesktop()
     delete listeners.back();
     listeners.pop_back();
   }
+  if (server->getEncodeFd() != -1)
+    vncRemoveNotifyFd(server->getEncodeFd());
   if (shadowFramebuffer)
     delete [] shadowFramebuffer;
   delete server;
@@ -314,6 +324,11 @@ void XserverDesktop::handleSocketEvent(int fd, bool read, bool write)
     if (read) {
       if (handleListenerEvent(fd))
         return;
+
+      if (fd == server->getEncodeFd()) {
+        server->processEncodeEvent();
+        return;
+      }
     }
 
     if (handleSocketReadWrite(fd, read, write))
@@ -394,9 +409,6 @@ void XserverDesktop::blockHandler(int* timeout)
         delete (*i);
         continue;
       }
-
-      /* Update existing NotifyFD to listen for write (or not) */
-      vncSetNotifyFd(fd, screenIndex, true, (*i)->outStream().hasBufferedData());
     }
 
     // We are responsible for propagating mouse movement between clients
@@ -410,10 +422,31 @@ void XserverDesktop::blockHandler(int* timeout)
       server->setCursorPos(oldCursorPos, false);
     }
 
+    // Make sure the server knows about all drawing before any of the
+    // timers might send an update
+    vncHooksFlushChanges(screenIndex);
+
     // Trigger timers and check when the next will expire
     int nextTimeout = core::Timer::checkTimeouts();
     if (nextTimeout >= 0 && (*timeout == -1 || nextTimeout < *timeout))
       *timeout = nextTimeout;
+
+    // Update existing NotifyFDs to listen for write (or not). This is
+    // done after the timers as they might have started an update.
+    sockets.clear();
+    server->getSockets(&sockets);
+    for (i = sockets.begin(); i != sockets.end(); i++) {
+      int fd = (*i)->getFd();
+
+      // The socket belongs to the encoding thread until the update
+      // is done, and any events would just make us wait for it
+      if (server->isEncoding(*i)) {
+        vncSetNotifyFd(fd, screenIndex, false, false);
+        continue;
+      }
+
+      vncSetNotifyFd(fd, screenIndex, true, (*i)->outStream().hasBufferedData());
+    }
   } catch (std::exception& e) {
     vlog.error("XserverDesktop::blockHandler: %s", e.what());
   }
@@ -507,6 +540,8 @@ void XserverDesktop::frameTick(uint64_t msc)
 {
   std::map<uint64_t, uint64_t>::iterator iter, next;
 
+  // Present does any pending copies for this frame from within the
+  // event, so they are done before the server looks for changes
   for (iter = pendingMsc.begin(); iter != pendingMsc.end();) {
     next = iter; next++;
 
@@ -517,6 +552,8 @@ void XserverDesktop::frameTick(uint64_t msc)
 
     iter = next;
   }
+
+  vncHooksFlushChanges(screenIndex);
 }
 
 void XserverDesktop::handleClipboardRequest()
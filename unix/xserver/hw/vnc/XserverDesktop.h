@@ -119,7 +119,7 @@ protected:
 private:
 
   int screenIndex;
-  rfb::VNCServer* server;
+  rfb::VNCServerST* server;
   std::list<network::SocketListener*> listeners;
   uint8_t* shadowFramebuffer;
 
@@ -427,10 +427,16 @@ void vncSetLEDState(unsigned long leds)
 void vncAddChanged(int scrIdx, int nRects,
                    const struct UpdateRect *rects)
 {
+  core::Region changed;
+
+  // Collect everything first, so that the server only has to update
+  // its tracking once
   for (int i = 0;i < nRects;i++) {
-    desktop[scrIdx]->add_changed({{rects[i].x1, rects[i].y1,
-                                   rects[i].x2, rects[i].y2}});
+    changed.assign_union({{rects[i].x1, rects[i].y1,
+                           rects[i].x2, rects[i].y2}});
   }
+
+  desktop[scrIdx]->add_changed(changed);
 }
 
 void vncAddCopied(int scrIdx, int nRects,
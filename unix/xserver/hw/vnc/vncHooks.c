@@ -21,7 +21,10 @@
 #include <dix-config.h>
 #endif
 
+#include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "vncHooks.h"
 #include "vncExtInit.h"
@@ -49,6 +52,13 @@
 // fix it here.
 #define MAX_RECTS_PER_OP 5
 
+// Damage from the drawing operations is collected and passed on once
+// per block handler, as handling lots of tiny areas one at a time is
+// expensive further up. Up to MAX_PENDING_RECTS separate areas are
+// kept, and anything beyond that is tracked as coarse tiles instead.
+#define MAX_PENDING_RECTS 32
+#define PENDING_TILE_SIZE 64
+
 // vncHooksScreenRec and vncHooksGCRec contain pointers to the original
 // functions which we "wrap" in order to hook the screen changes.  The screen
 // functions are each wrapped individually, while the GC "funcs" and "ops" are
@@ -57,6 +67,13 @@
 typedef struct _vncHooksScreenRec {
   int                          ignoreHooks;
 
+  int                          numPendingRects;
+  BoxRec                       pendingRects[MAX_PENDING_RECTS];
+  unsigned char               *pendingTiles;
+  BoxRec                      *pendingTileRects;
+  int                          tilesWidth, tilesHeight;
+  Bool                         havePendingTiles;
+
   CloseScreenProcPtr           CloseScreen;
   CreateGCProcPtr              CreateGC;
   CopyWindowProcPtr            CopyWindow;
@@ -286,6 +303,13 @@ int vncHooksInit(int scrIdx)
 
   vncHooksScreen->ignoreHooks = 0;
 
+  vncHooksScreen->numPendingRects = 0;
+  vncHooksScreen->pendingTiles = NULL;
+  vncHooksScreen->pendingTileRects = NULL;
+  vncHooksScreen->tilesWidth = 0;
+  vncHooksScreen->tilesHeight = 0;
+  vncHooksScreen->havePendingTiles = FALSE;
+
   wrap(vncHooksScreen, pScreen, CloseScreen, vncHooksCloseScreen);
   wrap(vncHooksScreen, pScreen, CreateGC, vncHooksCreateGC);
   wrap(vncHooksScreen, pScreen, CopyWindow, vncHooksCopyWindow);
@@ -357,16 +381,170 @@ void vncGetScreenImage(int scrIdx, int x, int y, int width, int height,
 // Helper functions
 //
 
+static void flush_changed(ScreenPtr pScreen)
+{
+  vncHooksScreenPtr vncHooksScreen = vncHooksScreenPrivate(pScreen);
+
+  if (vncHooksScreen->numPendingRects > 0) {
+    vncAddChanged(pScreen->myNum, vncHooksScreen->numPendingRects,
+                  (const struct UpdateRect*)vncHooksScreen->pendingRects);
+    vncHooksScreen->numPendingRects = 0;
+  }
+
+  if (vncHooksScreen->havePendingTiles) {
+    // Each run of tiles on a row becomes one rect
+    for (int ty = 0; ty < vncHooksScreen->tilesHeight; ty++) {
+      unsigned char *row;
+      int count;
+
+      row = vncHooksScreen->pendingTiles + ty * vncHooksScreen->tilesWidth;
+
+      count = 0;
+      for (int tx = 0; tx < vncHooksScreen->tilesWidth; tx++) {
+        BoxRec *box;
+
+        if (!row[tx])
+          continue;
+
+        box = &vncHooksScreen->pendingTileRects[count++];
+        box->x1 = tx * PENDING_TILE_SIZE;
+        box->y1 = ty * PENDING_TILE_SIZE;
+
+        while ((tx < vncHooksScreen->tilesWidth) && row[tx]) {
+          row[tx] = 0;
+          tx++;
+        }
+
+        box->x2 = min(tx * PENDING_TILE_SIZE, pScreen->width);
+        box->y2 = min((ty + 1) * PENDING_TILE_SIZE, pScreen->height);
+      }
+
+      if (count > 0) {
+        vncAddChanged(pScreen->myNum, count,
+                      (const struct UpdateRect*)vncHooksScreen->pendingTileRects);
+      }
+    }
+
+    vncHooksScreen->havePendingTiles = FALSE;
+  }
+}
+
+static void add_changed_tiles(ScreenPtr pScreen, const BoxRec *box)
+{
+  vncHooksScreenPtr vncHooksScreen = vncHooksScreenPrivate(pScreen);
+  int tilesWidth, tilesHeight;
+
+  tilesWidth = (pScreen->width + PENDING_TILE_SIZE - 1) / PENDING_TILE_SIZE;
+  tilesHeight = (pScreen->height + PENDING_TILE_SIZE - 1) / PENDING_TILE_SIZE;
+
+  // The screen size might have changed since we set up the tiles
+  if ((tilesWidth != vncHooksScreen->tilesWidth) ||
+      (tilesHeight != vncHooksScreen->tilesHeight)) {
+    assert(!vncHooksScreen->havePendingTiles);
+
+    free(vncHooksScreen->pendingTiles);
+    free(vncHooksScreen->pendingTileRects);
+
+    vncHooksScreen->pendingTiles = calloc(tilesWidth * tilesHeight, 1);
+    vncHooksScreen->pendingTileRects = malloc(tilesWidth * sizeof(BoxRec));
+    if ((vncHooksScreen->pendingTiles == NULL) ||
+        (vncHooksScreen->pendingTileRects == NULL)) {
+      free(vncHooksScreen->pendingTiles);
+      free(vncHooksScreen->pendingTileRects);
+      vncHooksScreen->pendingTiles = NULL;
+      vncHooksScreen->pendingTileRects = NULL;
+      vncHooksScreen->tilesWidth = 0;
+      vncHooksScreen->tilesHeight = 0;
+
+      // Better slow than wrong
+      vncAddChanged(pScreen->myNum, 1, (const struct UpdateRect*)box);
+      return;
+    }
+
+    vncHooksScreen->tilesWidth = tilesWidth;
+    vncHooksScreen->tilesHeight = tilesHeight;
+  }
+
+  for (int ty = box->y1 / PENDING_TILE_SIZE;
+       ty <= (box->y2 - 1) / PENDING_TILE_SIZE; ty++) {
+    memset(vncHooksScreen->pendingTiles + ty * tilesWidth +
+             box->x1 / PENDING_TILE_SIZE,
+           1,
+           (box->x2 - 1) / PENDING_TILE_SIZE - box->x1 / PENDING_TILE_SIZE + 1);
+  }
+
+  vncHooksScreen->havePendingTiles = TRUE;
+}
+
+static void add_changed_box(ScreenPtr pScreen, const BoxRec *box_)
+{
+  vncHooksScreenPtr vncHooksScreen = vncHooksScreenPrivate(pScreen);
+  BoxRec box;
+  long area;
+
+  box.x1 = max(box_->x1, 0);
+  box.y1 = max(box_->y1, 0);
+  box.x2 = min(box_->x2, pScreen->width);
+  box.y2 = min(box_->y2, pScreen->height);
+  if ((box.x1 >= box.x2) || (box.y1 >= box.y2))
+    return;
+
+  area = (long)(box.x2 - box.x1) * (box.y2 - box.y1);
+
+  // Drawing is usually local, so try to grow one of the recent areas
+  // as long as that doesn't include too much that hasn't changed
+  for (int i = vncHooksScreen->numPendingRects - 1; i >= 0; i--) {
+    BoxPtr pending;
+    BoxRec merged;
+    long pendingArea, mergedArea, overlap;
+
+    pending = &vncHooksScreen->pendingRects[i];
+
+    merged.x1 = min(pending->x1, box.x1);
+    merged.y1 = min(pending->y1, box.y1);
+    merged.x2 = max(pending->x2, box.x2);
+    merged.y2 = max(pending->y2, box.y2);
+
+    pendingArea = (long)(pending->x2 - pending->x1) *
+                  (pending->y2 - pending->y1);
+    mergedArea = (long)(merged.x2 - merged.x1) * (merged.y2 - merged.y1);
+
+    if (mergedArea == pendingArea)
+      return;
+
+    overlap = (long)max(min(pending->x2, box.x2) - max(pending->x1, box.x1), 0) *
+              max(min(pending->y2, box.y2) - max(pending->y1, box.y1), 0);
+
+    if (mergedArea - (pendingArea + area - overlap) <=
+        (pendingArea + area) / 8 + PENDING_TILE_SIZE) {
+      *pending = merged;
+      return;
+    }
+  }
+
+  if (vncHooksScreen->numPendingRects < MAX_PENDING_RECTS) {
+    vncHooksScreen->pendingRects[vncHooksScreen->numPendingRects++] = box;
+    return;
+  }
+
+  add_changed_tiles(pScreen, &box);
+}
+
 static inline void add_changed(ScreenPtr pScreen, RegionPtr reg)
 {
   vncHooksScreenPtr vncHooksScreen = vncHooksScreenPrivate(pScreen);
+  BoxPtr rects;
+  int nRects;
+
   if (vncHooksScreen->ignoreHooks)
     return;
   if (RegionNil(reg))
     return;
-  vncAddChanged(pScreen->myNum,
-                RegionNumRects(reg),
-                (const struct UpdateRect*)RegionRects(reg));
+
+  rects = RegionRects(reg);
+  nRects = RegionNumRects(reg);
+  for (int i = 0; i < nRects; i++)
+    add_changed_box(pScreen, &rects[i]);
 }
 
 static inline void add_copied(ScreenPtr pScreen, RegionPtr dst,
@@ -377,11 +555,18 @@ static inline void add_copied(ScreenPtr pScreen, RegionPtr dst,
     return;
   if (RegionNil(dst))
     return;
+  // Earlier changes need to be known before they can be moved
+  flush_changed(pScreen);
   vncAddCopied(pScreen->myNum,
                RegionNumRects(dst),
                (const struct UpdateRect*)RegionRects(dst), dx, dy);
 }
 
+void vncHooksFlushChanges(int scrIdx)
+{
+  flush_changed(screenInfo.screens[scrIdx]);
+}
+
 static inline Bool is_visible(DrawablePtr drawable)
 {
   PixmapPtr scrPixmap;
@@ -438,6 +623,15 @@ static Bool vncHooksCloseScreen(ScreenPtr pScreen_)
 
   SCREEN_PROLOGUE(pScreen_, CloseScreen);
 
+  free(vncHooksScreen->pendingTiles);
+  free(vncHooksScreen->pendingTileRects);
+  vncHooksScreen->pendingTiles = NULL;
+  vncHooksScreen->pendingTileRects = NULL;
+  vncHooksScreen->tilesWidth = 0;
+  vncHooksScreen->tilesHeight = 0;
+  vncHooksScreen->numPendingRects = 0;
+  vncHooksScreen->havePendingTiles = FALSE;
+
   unwrap(vncHooksScreen, pScreen, CreateGC);
   unwrap(vncHooksScreen, pScreen, CopyWindow);
   unwrap(vncHooksScreen, pScreen, ClearToBackground);
@@ -1060,6 +1254,7 @@ static Bool vncHooksRandRSetConfig(ScreenPtr pScreen, Rotation rotation,
 
   RANDR_PROLOGUE(SetConfig);
 
+  flush_changed(pScreen);
   vncPreScreenResize(pScreen->myNum);
   ret = (*rp->rrSetConfig)(pScreen, rotation, rate, pSize);
   vncPostScreenResize(pScreen->myNum, ret, pScreen->width, pScreen->height);
@@ -1080,6 +1275,7 @@ static Bool vncHooksRandRScreenSetSize(ScreenPtr pScreen,
 
   RANDR_PROLOGUE(ScreenSetSize);
 
+  flush_changed(pScreen);
   vncPreScreenResize(pScreen->myNum);
   ret = (*rp->rrScreenSetSize)(pScreen, width, height, mmWidth, mmHeight);
   vncPostScreenResize(pScreen->myNum, ret, pScreen->width, pScreen->height);
@@ -28,6 +28,10 @@ int vncHooksInit(int scrIdx);
 void vncGetScreenImage(int scrIdx, int x, int y, int width, int height,
                        char *buffer, int strideBytes);
 
+// vncHooksFlushChanges() passes on all changes to the screen that have
+// been collected since the last call
+void vncHooksFlushChanges(int scrIdx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -108,6 +108,7 @@ CConn::CConn()
     setCompressLevel(::compressLevel);
 
   setQualityLevel(::qualityLevel);
+  setPreferredScaleFactor(::serverScale);
 
   OptionsDialog::addCallback(handleOptions, this);
 }
@@ -190,12 +191,33 @@ void CConn::connect(const char* vncServerName, network::Socket* socket)
 
   Fl::add_fd(sock->getFd(), FL_READ | FL_EXCEPT, socketEvent, this);
 
+#ifndef WIN32
+  // A server on the same machine can give us the framebuffer directly
+  if (dynamic_cast<network::UnixSocket*>(sock) != nullptr) {
+    sock->inStream().enableFdPassing();
+    supportsSharedMemory = true;
+  }
+#endif
+
   setServerName(serverHost.c_str());
   setStreams(&sock->inStream(), &sock->outStream());
 
   initialiseProtocol();
 }
 
+int CConn::receiveFd()
+{
+#ifndef WIN32
+  network::UnixSocket* unixSock;
+
+  unixSock = dynamic_cast<network::UnixSocket*>(sock);
+  if (unixSock != nullptr)
+    return unixSock->inStream().takeFd();
+#endif
+
+  return -1;
+}
+
 std::string CConn::connectionInfo()
 {
   std::string infoText;
@@ -422,7 +444,9 @@ void CConn::initDone()
   if (server.beforeVersion(3, 8) && autoSelect)
     fullColour.setParam(true);
 
-  desktop = new DesktopWindow(server.width(), server.height(), this);
+  desktop = new DesktopWindow(server.width() * server.scaleFactor,
+                              server.height() * server.scaleFactor,
+                              this);
   fullColourPF = desktop->getPreferredPF();
 
   // Force a switch to the format and encoding we'd like
@@ -898,7 +922,8 @@ void CConn::setCursor(int width, int height, const core::Point& hotspot,
 
 void CConn::setCursorPos(const core::Point& pos)
 {
-  desktop->setCursorPos(pos);
+  desktop->setCursorPos({pos.x * server.scaleFactor,
+                         pos.y * server.scaleFactor});
 }
 
 void CConn::setLEDState(unsigned int state)
@@ -928,7 +953,8 @@ void CConn::handleClipboardData(const char* data)
 
 void CConn::resizeFramebuffer()
 {
-  desktop->resizeFramebuffer(server.width(), server.height());
+  desktop->resizeFramebuffer(server.width() * server.scaleFactor,
+                             server.height() * server.scaleFactor);
 }
 
 void CConn::updateEncoding()
@@ -89,6 +89,8 @@ private:
 
   void resizeFramebuffer() override;
 
+  int receiveFd() override;
+
   void updateEncoding();
   void updateCompressLevel();
   void updateQualityLevel();
@@ -362,8 +362,12 @@ void DesktopWindow::resizeFramebuffer(int new_w, int new_h)
 {
   bool maximized;
 
-  if ((new_w == viewport->w()) && (new_h == viewport->h()))
+  // Only the server side scaling might have changed, which the
+  // viewport still needs to know about
+  if ((new_w == viewport->w()) && (new_h == viewport->h())) {
+    viewport->size(new_w, new_h);
     return;
+  }
 
   maximized = false;
 
@@ -1327,10 +1331,15 @@ void DesktopWindow::remoteResize()
     sentDesktopSize = true;
   }
 
-  if (!fullscreen_active() || (width > w()) || (height > h())) {
+  if (!fullscreen_active() || (width > w()) || (height > h()) ||
+      (cc->server.scaleFactor > 1)) {
     // In windowed mode (or the framebuffer is so large that we need
     // to scroll) we just report a single virtual screen that covers
-    // the entire framebuffer.
+    // the entire framebuffer. The same goes if the server is scaling,
+    // as our screens don't map cleanly to its framebuffer then.
+
+    width /= cc->server.scaleFactor;
+    height /= cc->server.scaleFactor;
 
     layout = cc->server.screenLayout();
 
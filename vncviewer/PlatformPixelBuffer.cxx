@@ -28,7 +28,9 @@
 #include <sys/shm.h>
 #endif
 
+#include <list>
 #include <stdexcept>
+#include <vector>
 
 #include <FL/Fl.H>
 #include <FL/x.H>
@@ -39,13 +41,18 @@
 
 static core::LogWriter vlog("PlatformPixelBuffer");
 
+#if !defined(WIN32) && !defined(__APPLE__)
+// Buffers that are waiting for XShm completion events
+static std::list<PlatformPixelBuffer*> shmBuffers;
+#endif
+
 PlatformPixelBuffer::PlatformPixelBuffer(int width, int height) :
   FullFramePixelBuffer(rfb::PixelFormat(32, 24, false, true,
                                         255, 255, 255, 16, 8, 0),
                        0, 0, nullptr, 0),
   Surface(width, height)
 #if !defined(WIN32) && !defined(__APPLE__)
-  , shminfo(nullptr), xim(nullptr)
+  , shminfo(nullptr), xim(nullptr), shmBusy(false)
 #endif
 {
 #if !defined(WIN32) && !defined(__APPLE__)
@@ -60,6 +67,10 @@ PlatformPixelBuffer::PlatformPixelBuffer(int width, int height) :
       throw std::bad_alloc();
 
     vlog.debug("Using standard XImage");
+  } else {
+    if (shmBuffers.empty())
+      Fl::add_system_handler(handleSystemEvent, nullptr);
+    shmBuffers.push_back(this);
   }
 
   setBuffer(width, height, (uint8_t*)xim->data,
@@ -77,6 +88,10 @@ PlatformPixelBuffer::~PlatformPixelBuffer()
 #if !defined(WIN32) && !defined(__APPLE__)
   if (shminfo) {
     vlog.debug("Freeing shared memory XImage");
+    shmBuffers.remove(this);
+    if (shmBuffers.empty())
+      Fl::remove_system_handler(handleSystemEvent);
+    waitShm();
     XShmDetach(fl_display, shminfo);
     shmdt(shminfo->shmaddr);
     shmctl(shminfo->shmid, IPC_RMID, nullptr);
@@ -99,32 +114,52 @@ void PlatformPixelBuffer::commitBufferRW(const core::Rect& r)
   mutex.unlock();
 }
 
-core::Rect PlatformPixelBuffer::getDamage(void)
+core::Region PlatformPixelBuffer::getDamage(void)
 {
-  core::Rect r;
+  core::Region r;
 
   mutex.lock();
-  r = damage.get_bounding_rect();
+  r = damage;
   damage.clear();
   mutex.unlock();
 
 #if !defined(WIN32) && !defined(__APPLE__)
-  if (r.width() == 0 || r.height() == 0)
+  if (r.is_empty())
     return r;
 
+  std::vector<core::Rect> rects;
+
+  // Lots of tiny rects cost more in overhead than they save
+  r.get_rects(&rects);
+  if (rects.size() > 64) {
+    rects.clear();
+    rects.push_back(r.get_bounding_rect());
+  }
+
   GC gc;
 
   gc = XCreateGC(fl_display, pixmap, 0, nullptr);
   if (shminfo) {
-    XShmPutImage(fl_display, pixmap, gc, xim,
-                 r.tl.x, r.tl.y, r.tl.x, r.tl.y,
-                 r.width(), r.height(), False);
-    // Need to make sure the X server has finished reading the
-    // shared memory before we return
-    XSync(fl_display, False);
+    // Don't queue up more than one update at a time
+    waitShm();
+
+    for (size_t i = 0; i < rects.size(); i++) {
+      const core::Rect& rect = rects[i];
+      // The requests are handled in order, so we only need to know
+      // when the last one has been completed
+      XShmPutImage(fl_display, pixmap, gc, xim,
+                   rect.tl.x, rect.tl.y, rect.tl.x, rect.tl.y,
+                   rect.width(), rect.height(), i == rects.size() - 1);
+    }
+
+    shmBusy = true;
+    XFlush(fl_display);
   } else {
-    XPutImage(fl_display, pixmap, gc, xim,
-              r.tl.x, r.tl.y, r.tl.x, r.tl.y, r.width(), r.height());
+    for (const core::Rect& rect : rects) {
+      XPutImage(fl_display, pixmap, gc, xim,
+                rect.tl.x, rect.tl.y, rect.tl.x, rect.tl.y,
+                rect.width(), rect.height());
+    }
   }
   XFreeGC(fl_display, gc);
 #endif
@@ -134,6 +169,44 @@ core::Rect PlatformPixelBuffer::getDamage(void)
 
 #if !defined(WIN32) && !defined(__APPLE__)
 
+void PlatformPixelBuffer::waitShm()
+{
+  XEvent event;
+
+  if (!shmBusy)
+    return;
+
+  // The completion event hasn't been dispatched yet, so we have to
+  // wait for the X server and then fish it out of the queue ourselves
+  XSync(fl_display, False);
+  while (XCheckTypedEvent(fl_display,
+                          XShmGetEventBase(fl_display) + ShmCompletion,
+                          &event))
+    ;
+
+  shmBusy = false;
+}
+
+int PlatformPixelBuffer::handleSystemEvent(void* event, void* /*data*/)
+{
+  XEvent* xevent;
+  XShmCompletionEvent* completion;
+
+  xevent = (XEvent*)event;
+
+  if (xevent->type != XShmGetEventBase(fl_display) + ShmCompletion)
+    return 0;
+
+  completion = (XShmCompletionEvent*)xevent;
+
+  for (PlatformPixelBuffer* buffer : shmBuffers) {
+    if (completion->shmseg == buffer->shminfo->shmseg)
+      buffer->shmBusy = false;
+  }
+
+  return 1;
+}
+
 static bool caughtError;
 
 static int XShmAttachErrorHandler(Display* /*dpy*/,
@@ -42,7 +42,9 @@ public:
 
   void commitBufferRW(const core::Rect& r) override;
 
-  core::Rect getDamage(void);
+  // getDamage() uploads everything that has changed since the last
+  // call to the Surface, and returns what needs to be redrawn
+  core::Region getDamage(void);
 
   using rfb::FullFramePixelBuffer::width;
   using rfb::FullFramePixelBuffer::height;
@@ -54,10 +56,15 @@ protected:
 #if !defined(WIN32) && !defined(__APPLE__)
 protected:
   bool setupShm(int width, int height);
+  void waitShm();
+
+  static int handleSystemEvent(void* event, void* data);
 
 protected:
   XShmSegmentInfo *shminfo;
   XImage *xim;
+  // The X server might still be reading the shared memory
+  bool shmBusy;
 #endif
 };
 
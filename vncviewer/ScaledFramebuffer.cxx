@@ -0,0 +1,126 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+
+#include <vector>
+
+#include <rfb/ScaledPixelBuffer.h>
+
+#include "ScaledFramebuffer.h"
+
+ScaledFramebuffer::ScaledFramebuffer(rfb::ModifiablePixelBuffer* target_,
+                                     int scale_)
+  : ManagedPixelBuffer(target_->getPF(),
+                       (target_->width() + scale_ - 1) / scale_,
+                       (target_->height() + scale_ - 1) / scale_),
+    target(target_), scale(scale_)
+{
+  assert(scale >= 1);
+}
+
+ScaledFramebuffer::~ScaledFramebuffer()
+{
+  delete target;
+}
+
+void ScaledFramebuffer::commitBufferRW(const core::Rect& r)
+{
+  ManagedPixelBuffer::commitBufferRW(r);
+  mutex.lock();
+  damage.assign_union(r);
+  mutex.unlock();
+}
+
+void ScaledFramebuffer::scaleUp()
+{
+  core::Region r;
+  std::vector<core::Rect> rects;
+
+  mutex.lock();
+  r = damage;
+  damage.clear();
+  mutex.unlock();
+
+  r.get_rects(&rects);
+  for (const core::Rect& rect : rects) {
+    switch (format.bpp) {
+    case 8:
+      scaleUpRect<uint8_t>(rect);
+      break;
+    case 16:
+      scaleUpRect<uint16_t>(rect);
+      break;
+    case 32:
+      scaleUpRect<uint32_t>(rect);
+      break;
+    }
+  }
+}
+
+template<class T>
+void ScaledFramebuffer::scaleUpRect(const core::Rect& r)
+{
+  core::Rect dr;
+  const T* src;
+  int srcStride;
+  T* dst;
+  int dstStride;
+
+  dr = rfb::ScaledPixelBuffer::unscaleRect(r, scale);
+  dr = dr.intersect(target->getRect());
+  if (dr.is_empty())
+    return;
+
+  src = (const T*)getBuffer(r, &srcStride);
+  dst = (T*)target->getBufferRW(dr, &dstStride);
+
+  // Each source row is enlarged once, and then simply copied for the
+  // remaining rows of the block
+  for (int y = dr.tl.y; y < dr.br.y; y++) {
+    if ((y != dr.tl.y) && (y % scale != 0)) {
+      memcpy(dst, dst - dstStride, dr.width() * sizeof(T));
+    } else {
+      const T* in;
+      int x;
+
+      in = src + (y / scale - r.tl.y) * srcStride;
+      x = dr.tl.x;
+      while (x < dr.br.x) {
+        T pix;
+        int end;
+
+        pix = *in++;
+        end = (x / scale + 1) * scale;
+        if (end > dr.br.x)
+          end = dr.br.x;
+        for (; x < end; x++)
+          dst[x - dr.tl.x] = pix;
+      }
+    }
+
+    dst += dstStride;
+  }
+
+  target->commitBufferRW(dr);
+}
@@ -0,0 +1,57 @@
+/* Copyright 2026 Pierre Ossman <ossman@cendio.se> for Cendio AB
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef __SCALEDFRAMEBUFFER_H__
+#define __SCALEDFRAMEBUFFER_H__
+
+#include <mutex>
+
+#include <core/Region.h>
+
+#include <rfb/PixelBuffer.h>
+
+// ScaledFramebuffer receives the scaled down framebuffer from the
+// server and enlarges it on to the real frame buffer that is shown
+// on screen. It takes ownership of that frame buffer.
+
+class ScaledFramebuffer: public rfb::ManagedPixelBuffer {
+public:
+  ScaledFramebuffer(rfb::ModifiablePixelBuffer* target, int scale);
+  ~ScaledFramebuffer();
+
+  int getScale() const { return scale; }
+
+  void commitBufferRW(const core::Rect& r) override;
+
+  // scaleUp() copies everything that has changed since the last call
+  // on to the target frame buffer
+  void scaleUp();
+
+protected:
+  template<class T>
+  void scaleUpRect(const core::Rect& r);
+
+protected:
+  rfb::ModifiablePixelBuffer* target;
+  int scale;
+
+  std::mutex mutex;
+  core::Region damage;
+};
+
+#endif
@@ -26,10 +26,12 @@
 #include <string.h>
 
 #include <stdexcept>
+#include <vector>
 
 #include <core/LogWriter.h>
 #include <core/i18n.h>
 #include <core/string.h>
+#include <core/time.h>
 
 #include <rfb/CMsgWriter.h>
 #include <rfb/Cursor.h>
@@ -57,6 +59,7 @@
 #include "vncviewer.h"
 
 #include "PlatformPixelBuffer.h"
+#include "ScaledFramebuffer.h"
 
 #include <FL/fl_draw.H>
 #include <FL/fl_ask.H>
@@ -65,6 +68,10 @@
 #include <FL/Fl_Menu_Button.H>
 #include <FL/x.H>
 
+#if !defined(WIN32) && !defined(__APPLE__) && defined(HAVE_XRANDR)
+#include <X11/extensions/Xrandr.h>
+#endif
+
 #if defined(WIN32)
 #include "KeyboardWin32.h"
 #elif defined(__APPLE__)
@@ -93,13 +100,85 @@ static const int FAKE_DEL_KEY_CODE = 0x10003;
 // Used for fake key presses for lock key sync
 static const int FAKE_KEY_CODE = 0xffff;
 
+// Used if we cannot figure out the actual display refresh rate
+static const unsigned DEFAULT_REFRESH_RATE = 60;
+
+// Returns the refresh interval in milliseconds of the fastest active
+// display, rounded down so that we never miss a refresh
+static unsigned getRefreshInterval()
+{
+  double rate;
+
+  rate = 0;
+
+#if defined(WIN32)
+  DEVMODE dm;
+
+  memset(&dm, 0, sizeof(dm));
+  dm.dmSize = sizeof(dm);
+  // 0 and 1 mean "hardware default" according to the documentation
+  if (EnumDisplaySettings(nullptr, ENUM_CURRENT_SETTINGS, &dm) &&
+      (dm.dmDisplayFrequency > 1))
+    rate = dm.dmDisplayFrequency;
+#elif !defined(__APPLE__) && defined(HAVE_XRANDR)
+  int ev, err;
+
+  fl_open_display();
+
+  if (XRRQueryExtension(fl_display, &ev, &err)) {
+    XRRScreenResources* res;
+
+    res = XRRGetScreenResourcesCurrent(fl_display,
+                                       RootWindow(fl_display, fl_screen));
+    if (res != nullptr) {
+      for (int i = 0; i < res->ncrtc; i++) {
+        XRRCrtcInfo* crtc;
+
+        crtc = XRRGetCrtcInfo(fl_display, res, res->crtcs[i]);
+        if (crtc == nullptr)
+          continue;
+
+        for (int j = 0; j < res->nmode; j++) {
+          const XRRModeInfo* mode;
+          double modeRate;
+
+          mode = &res->modes[j];
+          if (mode->id != crtc->mode)
+            continue;
+          if ((mode->hTotal == 0) || (mode->vTotal == 0))
+            continue;
+
+          modeRate = (double)mode->dotClock /
+                     ((double)mode->hTotal * mode->vTotal);
+          if (modeRate > rate)
+            rate = modeRate;
+        }
+
+        XRRFreeCrtcInfo(crtc);
+      }
+
+      XRRFreeScreenResources(res);
+    }
+  }
+#endif
+
+  if (rate < 1)
+    rate = DEFAULT_REFRESH_RATE;
+
+  vlog.debug("Display refresh rate is %.2f Hz", rate);
+
+  return (unsigned)(1000 / rate);
+}
+
 Viewport::Viewport(int w, int h, CConn* cc_)
   : Fl_Widget(0, 0, w, h), cc(cc_), frameBuffer(nullptr),
+    scaledBuffer(nullptr),
     lastPointerPos(0, 0), lastButtonMask(0),
     keyboard(nullptr), shortcutBypass(false), shortcutActive(false),
     firstLEDState(true), pendingClientClipboard(false),
     menuCtrlKey(false), menuAltKey(false), cursor(nullptr),
-    cursorIsBlank(false)
+    cursorIsBlank(false), pendingPresent(false),
+    presentCount(0), presentDelay(0)
 {
 #if defined(WIN32)
   keyboard = new KeyboardWin32(this);
@@ -120,9 +199,10 @@ Viewport::Viewport(int w, int h, CConn* cc_)
   //        layouts we don't support
   Fl::disable_im();
 
-  frameBuffer = new PlatformPixelBuffer(w, h);
-  assert(frameBuffer);
-  cc->setFramebuffer(frameBuffer);
+  refreshInterval = getRefreshInterval();
+  gettimeofday(&lastPresent, nullptr);
+
+  createFramebuffer(w, h);
 
   contextMenu = new Fl_Menu_Button(0, 0, 0, 0);
   // Setting box type to FL_NO_BOX prevents it from trying to draw the
@@ -153,6 +233,12 @@ Viewport::~Viewport()
   // Unregister all timeouts in case they get a change tro trigger
   // again later when this object is already gone.
   Fl::remove_timeout(handlePointerTimeout, this);
+  Fl::remove_timeout(handlePresentTimeout, this);
+
+  if (presentCount > 0) {
+    vlog.debug("Presented %u frames, average delay %g ms",
+               presentCount, (double)presentDelay / presentCount);
+  }
 
   Fl::remove_system_handler(handleSystemEvent);
 
@@ -185,10 +271,59 @@ const rfb::PixelFormat &Viewport::getPreferredPF()
 
 void Viewport::updateWindow()
 {
-  core::Rect r;
+  unsigned elapsed;
+
+  if (!pendingPresent) {
+    gettimeofday(&firstDamage, nullptr);
+    pendingPresent = true;
+  }
+
+  // Already scheduled? Then the damage will be picked up by that
+  if (Fl::has_timeout(handlePresentTimeout, this))
+    return;
+
+  // Present right away if we've been idle, otherwise wait for the
+  // next refresh so that rapid updates get merged in to one frame
+  elapsed = core::msSince(&lastPresent);
+  if (elapsed >= refreshInterval) {
+    presentWindow();
+    return;
+  }
+
+  Fl::add_timeout((double)(refreshInterval - elapsed) / 1000,
+                  handlePresentTimeout, this);
+}
+
+void Viewport::presentWindow()
+{
+  core::Region r;
+  std::vector<core::Rect> rects;
+
+  if (scaledBuffer)
+    scaledBuffer->scaleUp();
 
   r = frameBuffer->getDamage();
-  damage(FL_DAMAGE_USER1, r.tl.x + x(), r.tl.y + y(), r.width(), r.height());
+  r.get_rects(&rects);
+
+  for (const core::Rect& rect : rects) {
+    damage(FL_DAMAGE_USER1, rect.tl.x + x(), rect.tl.y + y(),
+           rect.width(), rect.height());
+  }
+
+  gettimeofday(&lastPresent, nullptr);
+
+  if (pendingPresent) {
+    presentCount++;
+    presentDelay += core::msBetween(&firstDamage, &lastPresent);
+    pendingPresent = false;
+  }
+}
+
+void Viewport::handlePresentTimeout(void *data)
+{
+  Viewport *self = (Viewport *)data;
+
+  self->presentWindow();
 }
 
 static const char * dotcursor_xpm[] = {
@@ -411,19 +546,42 @@ void Viewport::draw()
 
 void Viewport::resize(int x, int y, int w, int h)
 {
-  if ((w != frameBuffer->width()) || (h != frameBuffer->height())) {
+  int scale;
+
+  scale = scaledBuffer ? scaledBuffer->getScale() : 1;
+
+  if ((w != frameBuffer->width()) || (h != frameBuffer->height()) ||
+      (scale != cc->server.scaleFactor)) {
     vlog.debug("Resizing framebuffer from %dx%d to %dx%d",
                frameBuffer->width(), frameBuffer->height(), w, h);
 
-    frameBuffer = new PlatformPixelBuffer(w, h);
-    assert(frameBuffer);
-    cc->setFramebuffer(frameBuffer);
+    createFramebuffer(w, h);
   }
 
   Fl_Widget::resize(x, y, w, h);
 }
 
 
+void Viewport::createFramebuffer(int w, int h)
+{
+  int scale;
+
+  frameBuffer = new PlatformPixelBuffer(w, h);
+  assert(frameBuffer);
+
+  // The server sends a smaller framebuffer when it is scaling, which
+  // we then enlarge on to the real one
+  scale = cc->server.scaleFactor;
+  if (scale > 1) {
+    scaledBuffer = new ScaledFramebuffer(frameBuffer, scale);
+    cc->setFramebuffer(scaledBuffer);
+  } else {
+    scaledBuffer = nullptr;
+    cc->setFramebuffer(frameBuffer);
+  }
+}
+
+
 int Viewport::handle(int event)
 {
   std::string filtered;
@@ -548,12 +706,18 @@ int Viewport::handle(int event)
 void Viewport::sendPointerEvent(const core::Point& pos,
                                 uint16_t buttonMask)
 {
+  core::Point scaledPos;
+
   if (viewOnly)
       return;
 
+  // The server expects coordinates in its scaled down framebuffer
+  scaledPos.x = pos.x / cc->server.scaleFactor;
+  scaledPos.y = pos.y / cc->server.scaleFactor;
+
   if ((pointerEventInterval == 0) || (buttonMask != lastButtonMask)) {
     try {
-      cc->writer()->writePointerEvent(pos, buttonMask);
+      cc->writer()->writePointerEvent(scaledPos, buttonMask);
     } catch (std::exception& e) {
       vlog.error("%s", e.what());
       abort_connection_with_unexpected_error(e);
@@ -563,7 +727,7 @@ void Viewport::sendPointerEvent(const core::Point& pos,
       Fl::add_timeout((double)pointerEventInterval/1000.0,
                       handlePointerTimeout, this);
   }
-  lastPointerPos = pos;
+  lastPointerPos = scaledPos;
   lastButtonMask = buttonMask;
 }
 
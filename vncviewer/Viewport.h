@@ -20,6 +20,8 @@
 #ifndef __VIEWPORT_H__
 #define __VIEWPORT_H__
 
+#include <sys/time.h>
+
 #include <core/Rect.h>
 
 #include <FL/Fl_Widget.H>
@@ -34,6 +36,7 @@ class Fl_RGB_Image;
 class CConn;
 class Keyboard;
 class PlatformPixelBuffer;
+class ScaledFramebuffer;
 class Surface;
 
 class Viewport : public Fl_Widget, protected EmulateMB,
@@ -77,6 +80,11 @@ protected:
 private:
   bool hasFocus();
 
+  void createFramebuffer(int w, int h);
+
+  void presentWindow();
+  static void handlePresentTimeout(void *data);
+
   // Show the currently set (or system) cursor
   void showCursor();
 
@@ -109,6 +117,16 @@ private:
   CConn* cc;
 
   PlatformPixelBuffer* frameBuffer;
+  ScaledFramebuffer* scaledBuffer;
+
+  // Presentation is limited to once per display refresh, with any
+  // damage in between coalesced into the next frame
+  unsigned refreshInterval;
+  bool pendingPresent;
+  struct timeval lastPresent;
+  struct timeval firstDamage;
+  unsigned presentCount;
+  unsigned long long presentDelay;
 
   core::Point lastPointerPos;
   uint16_t lastButtonMask;
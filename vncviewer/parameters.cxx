@@ -142,6 +142,11 @@ core::IntParameter
   qualityLevel("QualityLevel",
                _("JPEG quality level, 0 = Low, 9 = High"),
                8, 0, 9);
+core::IntParameter
+  serverScale("ServerScale",
+              _("Ask the server to scale down the framebuffer by this "
+                "factor to save bandwidth, 1 = No scaling"),
+              1, 1, 4);
 
 core::BoolParameter
   maximize("Maximize", _("Maximize viewer window"), false);
@@ -274,6 +279,7 @@ static core::VoidParameter* parameterArray[] = {
   &compressLevel,
   &rfb::CConnection::noJpeg,
   &qualityLevel,
+  &serverScale,
   /* Display */
   &fullScreen,
   &fullScreenMode,
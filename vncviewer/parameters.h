@@ -49,6 +49,7 @@ extern core::EnumParameter preferredEncoding;
 extern core::BoolParameter customCompressLevel;
 extern core::IntParameter compressLevel;
 extern core::IntParameter qualityLevel;
+extern core::IntParameter serverScale;
 
 extern core::BoolParameter maximize;
 extern core::BoolParameter fullScreen;